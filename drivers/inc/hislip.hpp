@@ -0,0 +1,231 @@
+/*
+ * hislip.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef DRIVERS_INC_HISLIP_HPP_
+#define DRIVERS_INC_HISLIP_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+#include "commandinterface.hpp"
+
+using namespace std;
+
+/*
+ * High-Speed LAN Instrument Protocol (IVI-6.1)
+ *
+ * A HiSLIP session is made of two TCP connections to the same port: the
+ * synchronous channel carries program messages (Data/DataEND) and their
+ * responses, the asynchronous channel carries locking, device clear, status
+ * queries and service requests.  Every message starts with a 16 byte header:
+ *
+ *		"HS" | type (1) | control code (1) | parameter (4) | payload length (8)
+ *
+ * All multi-byte fields are big-endian.
+ *
+ * Only overlapped mode is offered: Initialize and the device clear
+ * acknowledgements always report it, whatever the client prefers, so the
+ * synchronized mode's Interrupted messages and RMT-delivered handshake are
+ * not implemented.
+ */
+namespace HiSlip
+{
+	constexpr uint16_t PORT = 4880;
+	constexpr uint16_t PROTOCOL_VERSION = 0x0100;			// 1.0
+	constexpr uint16_t VENDOR_ID = ('A' << 8) | 'V';
+	constexpr uint64_t MAX_MESSAGE_SIZE = 1024 * 1024;
+	constexpr size_t MAX_SESSIONS = 8;
+	constexpr size_t HEADER_LENGTH = 16;
+	constexpr size_t RECEIVE_CHUNK_SIZE = 16 * 1024;
+	constexpr int POLL_TIMEOUT_MS = 100;
+
+	constexpr uint8_t OVERLAPPED_BIT = (1 << 0);
+
+	enum MessageType : uint8_t
+	{
+		MSG_INITIALIZE = 0,
+		MSG_INITIALIZE_RESPONSE,
+		MSG_FATAL_ERROR,
+		MSG_ERROR,
+		MSG_ASYNC_LOCK,
+		MSG_ASYNC_LOCK_RESPONSE,
+		MSG_DATA,
+		MSG_DATA_END,
+		MSG_DEVICE_CLEAR_COMPLETE,
+		MSG_DEVICE_CLEAR_ACKNOWLEDGE,
+		MSG_ASYNC_REMOTE_LOCAL_CONTROL,
+		MSG_ASYNC_REMOTE_LOCAL_RESPONSE,
+		MSG_TRIGGER,
+		MSG_INTERRUPTED,
+		MSG_ASYNC_INTERRUPTED,
+		MSG_ASYNC_MAXIMUM_MESSAGE_SIZE,
+		MSG_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE,
+		MSG_ASYNC_INITIALIZE,
+		MSG_ASYNC_INITIALIZE_RESPONSE,
+		MSG_ASYNC_DEVICE_CLEAR,
+		MSG_ASYNC_SERVICE_REQUEST,
+		MSG_ASYNC_STATUS_QUERY,
+		MSG_ASYNC_STATUS_RESPONSE,
+		MSG_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE,
+		MSG_ASYNC_LOCK_INFO,
+		MSG_ASYNC_LOCK_INFO_RESPONSE,
+		MSG_VENDOR_SPECIFIC_FIRST = 128,
+	};
+
+	enum FatalErrorCode : uint8_t
+	{
+		FATAL_UNIDENTIFIED = 0,
+		FATAL_POORLY_FORMED_HEADER,
+		FATAL_CHANNELS_INACTIVE,
+		FATAL_INVALID_INITIALIZATION,
+		FATAL_MAXIMUM_CLIENTS,
+	};
+
+	enum ErrorCode : uint8_t
+	{
+		ERROR_UNIDENTIFIED = 0,
+		ERROR_UNRECOGNIZED_MESSAGE_TYPE,
+		ERROR_UNRECOGNIZED_CONTROL_CODE,
+		ERROR_UNRECOGNIZED_VENDOR_MESSAGE,
+		ERROR_MESSAGE_TOO_LARGE,
+	};
+
+	enum LockResponse : uint8_t
+	{
+		LOCK_FAILURE = 0,
+		LOCK_SUCCESS_EXCLUSIVE,
+		LOCK_SUCCESS_SHARED,
+		LOCK_ERROR,
+	};
+
+	struct Header
+	{
+		uint8_t mType;
+		uint8_t mControlCode;
+		uint32_t mParameter;
+		uint64_t mPayloadLength;
+	};
+
+	class Session;
+
+	/*
+	 * One accepted TCP connection. Until the client sends Initialize or
+	 * AsyncInitialize a connection is not bound to a session.
+	 */
+	struct Connection
+	{
+		int mSocket;
+		bool mAsync;
+		Session *mSession;
+		string mReceiveBuffer;
+		uint64_t mDiscard;			// payload bytes left to skip from an oversized message
+		string mOutput;				// encoded messages not yet written to the socket
+		size_t mOutputOffset;		// bytes of mOutput already written
+
+		inline bool HasOutput(void) const { return mOutputOffset < mOutput.size(); }
+	};
+
+	class Session : public CommandInterface
+	{
+		friend class Server;
+
+	public:
+		Session(uint16_t lSessionId, Connection *lSynchronous);
+		~Session();
+		Session(Session &) = delete;
+		Session &operator=(Session &) = delete;
+
+		inline uint16_t GetSessionId(void) const { return mSessionId; }
+		inline int GetEventDescriptor(void) const { return mEventDescriptor; }
+		inline bool IsEstablished(void) const { return mSynchronous && mAsynchronous; }
+
+		void DiscardResponses(void);
+
+	private:
+		uint16_t mSessionId;
+		int mEventDescriptor;
+		Connection *mSynchronous;
+		Connection *mAsynchronous;
+		bool mClearing;
+		bool mClosed;
+		uint64_t mClientMaxMessageSize;
+		string mMessage;
+	};
+
+	class Server
+	{
+	public:
+		explicit Server(uint16_t lPort);
+		~Server();
+		Server(Server &) = delete;
+		Server &operator=(Server &) = delete;
+
+		inline int GetServerSocket(void) const { return mServerSocket; }
+
+		void Poll(void);
+
+	private:
+		struct LockRequest
+		{
+			Session *mSession;
+			bool mShared;
+			string mName;
+			chrono::steady_clock::time_point mDeadline;
+		};
+
+		int mServerSocket;
+		uint16_t mNextSessionId;
+		bool mOverlapped;
+		uint8_t mLastStatusByte;
+		list<Connection *> mConnections;
+		list<Session *> mSessions;
+
+		Session *mExclusiveOwner;
+		list<Session *> mSharedOwners;
+		string mSharedLockName;
+		list<LockRequest> mLockRequests;
+
+		vector<pollfd> mPollFds;
+		vector<Connection *> mPollConnections;
+		vector<Session *> mPollSessions;
+
+		void Accept(void);
+		bool Service(Connection *lConnection);
+		bool Dispatch(Connection *lConnection, const Header &lHeader, const char *lPayload);
+		bool DispatchSynchronous(Connection *lConnection, const Header &lHeader, const char *lPayload);
+		bool DispatchAsynchronous(Connection *lConnection, const Header &lHeader, const char *lPayload);
+		bool Initialize(Connection *lConnection, const Header &lHeader);
+		bool AsyncInitialize(Connection *lConnection, const Header &lHeader);
+		void DeliverResponses(Session *lSession);
+		void Flush(Connection *lConnection);
+		void CheckServiceRequest(void);
+
+		void Lock(Session *lSession, const Header &lHeader, const char *lPayload);
+		void Unlock(Session *lSession);
+		bool TryLock(Session *lSession, bool lShared, const string &lName);
+		void ServiceLockRequests(void);
+		bool IsBlockedByLock(Session *lSession) const;
+		int GetPollTimeout(void) const;
+
+		void Close(Connection *lConnection);
+		void CloseSession(Session *lSession);
+
+		bool SendMessage(Connection *lConnection, uint8_t lType, uint8_t lControlCode, uint32_t lParameter,
+						 const char *lPayload = nullptr, uint64_t lLength = 0);
+		void SendFatalError(Connection *lConnection, FatalErrorCode lCode, const char *lMessage);
+		void SendError(Connection *lConnection, ErrorCode lCode, const char *lMessage);
+	};
+}
+
+
+#endif /* DRIVERS_INC_HISLIP_HPP_ */
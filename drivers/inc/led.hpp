@@ -14,11 +14,6 @@ const char LED_BRIGHTNESS_PATH[] = "/sys/class/leds/am62-sk:green:debug/brightne
 
 void LedInstall(lua_State *lState);
 
-enum LedFunctions {
-	FUNC_GET = 0,
-	FUNC_SET
-};
-
 class Led
 {
 public:
@@ -33,19 +28,18 @@ public:
 
 	void On(void);
 	void Off(void);
+	void Set(bool lOn);
 	void Toggle(void);
 
-	static int On(lua_State *lState);
-	static int Off(lua_State *lState);
-	static int Toggle(lua_State *lState);
-	static int HandleMsg(lua_State *lState);
-
 private:
-	int mFileDescriptor;
+	int mFileDescriptor;			// -1 until first used
 	State mState;
 
+	void Open(void);
+
 public:
 	State GetState(void) { return mState; }
+	bool IsOn(void) const { return mState == ON; }
 };
 
 
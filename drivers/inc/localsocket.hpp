@@ -0,0 +1,118 @@
+/*
+ * localsocket.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef DRIVERS_INC_LOCALSOCKET_HPP_
+#define DRIVERS_INC_LOCALSOCKET_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+#include "commandinterface.hpp"
+
+using namespace std;
+
+/*
+ * Unix-domain control socket for tools running on the instrument itself
+ *
+ * The socket is SOCK_SEQPACKET, so every datagram is exactly one program
+ * message or one response and no terminators are needed. Each datagram
+ * starts with a Header. Small payloads follow the header inline. Large ones
+ * travel in a sealed memfd passed with SCM_RIGHTS, and the header then only
+ * carries the length.
+ *
+ * A memfd sent by a client must carry at least F_SEAL_SHRINK and F_SEAL_WRITE
+ * so it cannot change (or fault) while the server reads it. Response memfds
+ * are sealed against shrinking, growing, writing and further sealing.
+ */
+namespace LocalSocket
+{
+	constexpr char DEFAULT_SOCKET_PATH[] = "/run/aardvark.sock";
+	constexpr size_t MAX_CONNECTIONS = 16;
+	constexpr size_t MAX_INLINE_LENGTH = 64 * 1024;		// largest inline payload accepted
+	constexpr size_t MEMFD_THRESHOLD = 16 * 1024;		// responses larger than this go out as a memfd
+	constexpr size_t MAX_MESSAGE_LENGTH = 64 * 1024 * 1024;
+	constexpr int POLL_TIMEOUT_MS = 100;
+	constexpr int BACKLOG_RETRY_MS = 1;
+
+	constexpr uint32_t FLAG_MEMFD = (1 << 0);			// payload is in the attached file descriptor
+	constexpr uint32_t FLAG_ERROR = (1 << 1);			// payload is an interface error, not a response
+
+	struct Header
+	{
+		uint32_t mFlags;
+		uint32_t mReserved;
+		uint64_t mLength;
+	};
+
+	class Connection : public CommandInterface
+	{
+		friend class Server;
+
+	public:
+		explicit Connection(int lSocket);
+		~Connection();
+		Connection(Connection &) = delete;
+		Connection &operator=(Connection &) = delete;
+
+		inline int GetSocket(void) const { return mSocket; }
+		inline int GetEventDescriptor(void) const { return mEventDescriptor; }
+		inline bool HasBacklog(void) const { return !mInput.empty(); }
+		inline bool HasOutput(void) const { return !mOutput.empty(); }
+
+	private:
+		int mSocket;
+		int mEventDescriptor;
+		bool mClosed;
+
+		deque<CommandMessage *> mInput;		// messages the script processor could not take yet
+		deque<CommandMessage *> mOutput;	// responses not yet sent
+
+		void SubmitBacklog(void);
+	};
+
+	class Server
+	{
+	public:
+		explicit Server(const char *lPath = DEFAULT_SOCKET_PATH);
+		~Server();
+		Server(Server &) = delete;
+		Server &operator=(Server &) = delete;
+
+		inline int GetServerSocket(void) const { return mServerSocket; }
+
+		void Poll(void);
+
+	private:
+		int mServerSocket;
+		string mPath;
+		list<Connection *> mConnections;
+		vector<char> mReceiveBuffer;
+
+		vector<pollfd> mPollFds;
+		vector<Connection *> mPollConnections;
+
+		void Accept(void);
+		void Receive(Connection *lConnection);
+		void Submit(Connection *lConnection, const char *lData, size_t lLength);
+		void Collect(Connection *lConnection);
+		void Flush(Connection *lConnection);
+		bool SendInline(Connection *lConnection, uint32_t lFlags, const char *lData, size_t lLength);
+		bool SendMemfd(Connection *lConnection, const char *lData, size_t lLength);
+		void SendError(Connection *lConnection, const char *lMessage);
+		void Close(Connection *lConnection);
+		int GetPollTimeout(void) const;
+	};
+}
+
+
+#endif /* DRIVERS_INC_LOCALSOCKET_HPP_ */
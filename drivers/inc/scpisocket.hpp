@@ -0,0 +1,96 @@
+/*
+ * scpisocket.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef DRIVERS_INC_SCPISOCKET_HPP_
+#define DRIVERS_INC_SCPISOCKET_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+#include "streaminterface.hpp"
+
+using namespace std;
+
+/*
+ * Raw SCPI socket server (the de-facto port 5025 "SOCKETS" interface)
+ *
+ * Every program message is terminated by one of the input terminator
+ * characters. A client may pipeline any number of messages in one segment;
+ * each one is forwarded to the script processor in order and the responses
+ * are written back, terminated, in the same order.
+ */
+namespace ScpiSocket
+{
+	constexpr uint16_t PORT = 5025;
+	constexpr size_t MAX_CONNECTIONS = 16;
+	constexpr size_t RECEIVE_CHUNK_SIZE = 16 * 1024;
+	constexpr size_t MAX_MESSAGE_LENGTH = 1024 * 1024;
+	constexpr int POLL_TIMEOUT_MS = 100;
+	constexpr int BACKLOG_RETRY_MS = 1;
+
+	constexpr char DEFAULT_INPUT_TERMINATORS[] = "\n";
+	constexpr char DEFAULT_OUTPUT_TERMINATOR[] = "\n";
+
+	class Connection : public StreamInterface
+	{
+		friend class Server;
+
+	public:
+		Connection(int lSocket, const char *lInputTerminators, const char *lOutputTerminator);
+		~Connection();
+		Connection(Connection &) = delete;
+		Connection &operator=(Connection &) = delete;
+
+		inline int GetSocket(void) const { return mSocket; }
+
+	protected:
+		ssize_t Read(void *lBuffer, size_t lLength) override;
+		ssize_t Write(const struct iovec *lVector, int lCount) override;
+
+	private:
+		int mSocket;
+		bool mClosed;
+	};
+
+	class Server
+	{
+	public:
+		explicit Server(uint16_t lPort,
+						const char *lInputTerminators = DEFAULT_INPUT_TERMINATORS,
+						const char *lOutputTerminator = DEFAULT_OUTPUT_TERMINATOR);
+		~Server();
+		Server(Server &) = delete;
+		Server &operator=(Server &) = delete;
+
+		inline int GetServerSocket(void) const { return mServerSocket; }
+
+		void Poll(void);
+
+	private:
+		int mServerSocket;
+		string mInputTerminators;
+		string mOutputTerminator;
+		list<Connection *> mConnections;
+
+		vector<pollfd> mPollFds;
+		vector<Connection *> mPollConnections;
+
+		void Accept(void);
+		void Receive(Connection *lConnection);
+		void Flush(Connection *lConnection);
+		void Close(Connection *lConnection);
+		int GetPollTimeout(void) const;
+	};
+}
+
+
+#endif /* DRIVERS_INC_SCPISOCKET_HPP_ */
@@ -0,0 +1,100 @@
+/*
+ * serial.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef DRIVERS_INC_SERIAL_HPP_
+#define DRIVERS_INC_SERIAL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <termios.h>
+
+#include "streaminterface.hpp"
+
+using namespace std;
+
+/*
+ * RS-232 / USB-CDC command interface
+ *
+ * The tty is put in raw mode. Program messages end with one of the input
+ * terminator characters, and every response is written back followed by the
+ * output terminator.
+ *
+ * Reads go through a blocking descriptor whose VMIN/VTIME make a single read()
+ * wait for a burst to finish (see Settings) rather than return a byte or two
+ * per syscall. Writes go through a
+ * second, non-blocking descriptor fed from a drain queue, so a stalled peer
+ * (XOFF or CTS deasserted) never blocks the interface.
+ */
+namespace Serial
+{
+	constexpr char DEFAULT_DEVICE_PATH[] = "/dev/ttyGS0";
+	constexpr uint32_t DEFAULT_BAUD_RATE = 115200;
+	constexpr size_t READ_CHUNK_SIZE = 4096;
+	constexpr size_t MAX_MESSAGE_LENGTH = 1024 * 1024;
+	constexpr int POLL_TIMEOUT_MS = 100;
+	constexpr int BACKLOG_RETRY_MS = 1;
+	constexpr uint8_t DEFAULT_READ_MINIMUM = 255;		// VMIN, bytes
+	constexpr uint8_t DEFAULT_READ_TIMEOUT = 1;			// VTIME, deciseconds
+
+	constexpr char DEFAULT_INPUT_TERMINATORS[] = "\n";
+	constexpr char DEFAULT_OUTPUT_TERMINATOR[] = "\n";
+
+	enum FlowControl
+	{
+		FLOW_NONE = 0,
+		FLOW_XON_XOFF,
+		FLOW_RTS_CTS,
+	};
+
+	struct Settings
+	{
+		uint32_t mBaudRate = DEFAULT_BAUD_RATE;
+		FlowControl mFlowControl = FLOW_NONE;
+		const char *mInputTerminators = DEFAULT_INPUT_TERMINATORS;
+		const char *mOutputTerminator = DEFAULT_OUTPUT_TERMINATOR;
+		/*
+		 * In raw mode poll() waits for VMIN bytes when VTIME is 0, so VMIN = 1
+		 * wakes the loop for nearly every byte at high baud rates. With VTIME
+		 * set, poll() wakes on the first byte and the read then collects the
+		 * burst: it returns once VMIN bytes are in or the line has been quiet
+		 * for VTIME deciseconds. The price is latency: a message that ends
+		 * short of VMIN bytes is only read VTIME (0.1 s by default) after its
+		 * last byte. VMIN = 1 with VTIME = 0 gives the lowest latency instead.
+		 */
+		uint8_t mReadMinimum = DEFAULT_READ_MINIMUM;
+		uint8_t mReadTimeout = DEFAULT_READ_TIMEOUT;
+	};
+
+	class Port : public StreamInterface
+	{
+	public:
+		explicit Port(const char *lPath = DEFAULT_DEVICE_PATH, const Settings &lSettings = Settings());
+		~Port();
+		Port(Port &) = delete;
+		Port &operator=(Port &) = delete;
+
+		inline bool IsOpen(void) const { return mReadDescriptor >= 0 && mWriteDescriptor >= 0; }
+
+		void Poll(void);
+
+	protected:
+		ssize_t Read(void *lBuffer, size_t lLength) override;
+		ssize_t Write(const struct iovec *lVector, int lCount) override;
+
+	private:
+		int mReadDescriptor;
+		int mWriteDescriptor;
+		struct termios mSavedAttributes;
+
+		bool Configure(const Settings &lSettings);
+		void Close(void);
+	};
+}
+
+
+#endif /* DRIVERS_INC_SERIAL_HPP_ */
@@ -0,0 +1,89 @@
+/*
+ * streaminterface.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef DRIVERS_INC_STREAMINTERFACE_HPP_
+#define DRIVERS_INC_STREAMINTERFACE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "commandinterface.hpp"
+#include "programmessage.hpp"
+
+using namespace std;
+
+constexpr size_t STREAM_MAX_IOVECS = 64;
+
+/*
+ * Command interface over a byte stream (a TCP socket, a tty)
+ *
+ * Program messages end with one of the input terminator characters, except
+ * inside arbitrary block data. Complete messages are sent to the script
+ * processor straight from the receive buffer; the ones it cannot take yet are
+ * kept in a backlog and the stream stops being read until it has drained.
+ * Responses are queued as they arrive and written out, each followed by the
+ * output terminator unless it already ends with it, in gathered writes that
+ * pick up where a short write left off.
+ *
+ * A derived interface supplies the read and write primitives and runs the
+ * poll() loop: Receive() when the stream is readable and has no backlog,
+ * Collect() when the event descriptor is, SubmitBacklog() every time round,
+ * and Drain() while there is output.
+ */
+class StreamInterface : public CommandInterface
+{
+public:
+	StreamInterface(const char *lName, const char *lInputTerminators, const char *lOutputTerminator,
+					size_t lMaxMessageLength);
+	~StreamInterface();
+	StreamInterface(StreamInterface &) = delete;
+	StreamInterface &operator=(StreamInterface &) = delete;
+
+	inline int GetEventDescriptor(void) const { return mEventDescriptor; }
+	inline bool HasBacklog(void) const { return !mInput.empty(); }
+	inline bool HasOutput(void) const { return !mOutput.empty(); }
+
+	/*
+	 * Receive() reads up to lChunkSize bytes and submits the messages they
+	 * complete; it returns what Read() did, so 0 is end of stream and -1 an
+	 * error in errno. Drain() returns -1 with errno set when the stream fails,
+	 * and 0 when it is done or would block.
+	 */
+	ssize_t Receive(size_t lChunkSize);
+	void SubmitBacklog(void);
+	void Collect(void);
+	int Drain(void);
+	void DiscardOutput(void);
+
+protected:
+	virtual ssize_t Read(void *lBuffer, size_t lLength) = 0;
+	virtual ssize_t Write(const struct iovec *lVector, int lCount) = 0;
+
+private:
+	string mName;						// for diagnostics
+	int mEventDescriptor;
+	string mInputTerminators;
+	string mOutputTerminator;
+	size_t mMaxMessageLength;
+
+	string mReceiveBuffer;				// partial program message
+	ProgramMessage::Scanner mScanner;	// how far into it the terminator search got
+	deque<string> mInput;				// complete messages the script processor could not take yet
+	deque<CommandMessage *> mOutput;	// responses not yet written
+	size_t mOutputOffset;				// bytes of mOutput.front() (and its terminator) already written
+
+	void Split(void);
+	bool Submit(const char *lData, size_t lLength);
+	bool IsTerminated(const CommandMessage *lMessage) const;
+};
+
+#endif /* DRIVERS_INC_STREAMINTERFACE_HPP_ */
@@ -0,0 +1,891 @@
+/*
+ * hislip.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "hislip.hpp"
+#include "scriptprocessor.hpp"
+#include "status.hpp"
+
+using namespace HiSlip;
+
+static void DecodeHeader(const char *lBuffer, Header *lHeader)
+{
+	uint32_t lParameter;
+	uint64_t lLength;
+
+	memcpy(&lParameter, lBuffer + 4, sizeof(lParameter));
+	memcpy(&lLength, lBuffer + 8, sizeof(lLength));
+
+	lHeader->mType = static_cast<uint8_t>(lBuffer[2]);
+	lHeader->mControlCode = static_cast<uint8_t>(lBuffer[3]);
+	lHeader->mParameter = be32toh(lParameter);
+	lHeader->mPayloadLength = be64toh(lLength);
+}
+
+Session::Session(uint16_t lSessionId, Connection *lSynchronous)
+: CommandInterface(64, "hislip")
+, mSessionId{lSessionId}
+, mSynchronous{lSynchronous}
+, mAsynchronous{nullptr}
+, mClearing{false}
+, mClosed{false}
+, mClientMaxMessageSize{MAX_MESSAGE_SIZE}
+{
+	mEventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (mEventDescriptor < 0)
+	{
+		perror("could not create HiSLIP session eventfd");
+		exit(EXIT_FAILURE);
+	}
+
+	SetNotifyDescriptor(mEventDescriptor);
+}
+
+Session::~Session()
+{
+	Shutdown();
+	SetNotifyDescriptor(-1);
+	close(mEventDescriptor);
+}
+
+void Session::DiscardResponses(void)
+{
+	CommandMessage *lMessage;
+	while ((lMessage = TryReceive()))
+	{
+		delete lMessage;
+	}
+}
+
+Server::Server(uint16_t lPort)
+: mNextSessionId{1}
+, mOverlapped{true}
+, mLastStatusByte{0}
+, mExclusiveOwner{nullptr}
+{
+	mServerSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (mServerSocket < 0)
+	{
+		perror("HiSLIP socket");
+		exit(EXIT_FAILURE);
+	}
+
+	int lOpt = 1;
+	if (setsockopt(mServerSocket, SOL_SOCKET, SO_REUSEADDR, &lOpt, sizeof(lOpt)))
+	{
+		perror("setsockopt (SO_REUSEADDR)");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+
+	struct sockaddr_in lServerSockAddr;
+	memset(&lServerSockAddr, 0, sizeof(lServerSockAddr));
+	lServerSockAddr.sin_family = AF_INET;
+	lServerSockAddr.sin_port = htons(lPort);
+	lServerSockAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (bind(mServerSocket, reinterpret_cast<struct sockaddr *>(&lServerSockAddr), sizeof(lServerSockAddr)))
+	{
+		perror("HiSLIP bind");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(mServerSocket, 2 * MAX_SESSIONS))
+	{
+		perror("HiSLIP listen");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+}
+
+Server::~Server()
+{
+	for (Session *lSession : mSessions)
+	{
+		delete lSession;
+	}
+
+	for (Connection *lConnection : mConnections)
+	{
+		if (lConnection->mSocket >= 0)
+		{
+			close(lConnection->mSocket);
+		}
+		delete lConnection;
+	}
+
+	close(mServerSocket);
+}
+
+void Server::Poll(void)
+{
+	mPollFds.clear();
+	mPollConnections.clear();
+	mPollSessions.clear();
+
+	mPollFds.push_back({mServerSocket, POLLIN, 0});
+	mPollConnections.push_back(nullptr);
+	mPollSessions.push_back(nullptr);
+
+	for (Connection *lConnection : mConnections)
+	{
+		/*
+		 * While another client holds the lock, leave its program messages in the
+		 * socket; TCP flow control then holds the client off until it is released.
+		 */
+		bool lBlocked = !lConnection->mAsync && lConnection->mSession && IsBlockedByLock(lConnection->mSession);
+		short lEvents = (lBlocked ? 0 : POLLIN) | (lConnection->HasOutput() ? POLLOUT : 0);
+		mPollFds.push_back({lConnection->mSocket, lEvents, 0});
+		mPollConnections.push_back(lConnection);
+		mPollSessions.push_back(nullptr);
+	}
+
+	/*
+	 * Responses are only taken from a session while its synchronous channel has
+	 * nothing left to write; once the backlog drains the flush delivers them.
+	 */
+	for (Session *lSession : mSessions)
+	{
+		if (lSession->mSynchronous && lSession->mSynchronous->HasOutput())
+		{
+			continue;
+		}
+
+		mPollFds.push_back({lSession->GetEventDescriptor(), POLLIN, 0});
+		mPollConnections.push_back(nullptr);
+		mPollSessions.push_back(lSession);
+	}
+
+	int lReady = poll(mPollFds.data(), mPollFds.size(), GetPollTimeout());
+	if (lReady < 0)
+	{
+		if (errno != EINTR)
+		{
+			perror("HiSLIP poll");
+		}
+		return;
+	}
+
+	for (size_t lIndex = 0; lReady > 0 && lIndex < mPollFds.size(); lIndex++)
+	{
+		if (!mPollFds[lIndex].revents)
+		{
+			continue;
+		}
+
+		Connection *lConnection = mPollConnections[lIndex];
+		Session *lSession = mPollSessions[lIndex];
+
+		if (lIndex == 0)
+		{
+			Accept();
+		}
+		else if (lConnection)
+		{
+			short lEvents = mPollFds[lIndex].revents;
+
+			if (lConnection->mSocket >= 0 && (lEvents & POLLOUT))
+			{
+				Flush(lConnection);
+				if (lConnection->mSocket >= 0 && !lConnection->mAsync && lConnection->mSession && !lConnection->HasOutput())
+				{
+					DeliverResponses(lConnection->mSession);
+				}
+			}
+
+			if (lConnection->mSocket >= 0 && (lEvents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				Service(lConnection);
+			}
+		}
+		else if (lSession && !lSession->mClosed)
+		{
+			DeliverResponses(lSession);
+		}
+	}
+
+	ServiceLockRequests();
+	CheckServiceRequest();
+
+	/*
+	 * Reap anything closed during this pass. Connections are marked rather than
+	 * deleted in place because the poll table above still references them.
+	 */
+	for (auto lIterator = mConnections.begin(); lIterator != mConnections.end();)
+	{
+		if ((*lIterator)->mSocket < 0)
+		{
+			delete *lIterator;
+			lIterator = mConnections.erase(lIterator);
+		}
+		else
+		{
+			++lIterator;
+		}
+	}
+
+	for (auto lIterator = mSessions.begin(); lIterator != mSessions.end();)
+	{
+		if ((*lIterator)->mClosed)
+		{
+			delete *lIterator;
+			lIterator = mSessions.erase(lIterator);
+		}
+		else
+		{
+			++lIterator;
+		}
+	}
+}
+
+void Server::Accept(void)
+{
+	struct sockaddr_in lClientAddr;
+	socklen_t lLength = sizeof(lClientAddr);
+
+	int lSocket = accept4(mServerSocket, reinterpret_cast<struct sockaddr *>(&lClientAddr), &lLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (lSocket < 0)
+	{
+		perror("HiSLIP accept");
+		return;
+	}
+
+	int lOpt = 1;
+	if (setsockopt(lSocket, IPPROTO_TCP, TCP_NODELAY, &lOpt, sizeof(lOpt)))
+	{
+		perror("setsockopt (TCP_NODELAY)");
+	}
+
+	Connection *lConnection = new Connection{lSocket, false, nullptr, string(), 0, string(), 0};
+	mConnections.push_back(lConnection);
+}
+
+bool Server::Service(Connection *lConnection)
+{
+	string &lBuffer = lConnection->mReceiveBuffer;
+	size_t lOffset = lBuffer.size();
+
+	lBuffer.resize(lOffset + RECEIVE_CHUNK_SIZE);
+	ssize_t lBytesRead = recv(lConnection->mSocket, &lBuffer[lOffset], RECEIVE_CHUNK_SIZE, 0);
+	if (lBytesRead <= 0)
+	{
+		if (lBytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		{
+			lBuffer.resize(lOffset);
+			return true;
+		}
+
+		lBuffer.resize(lOffset);
+		Close(lConnection);
+		return false;
+	}
+	lBuffer.resize(lOffset + lBytesRead);
+
+	size_t lConsumed = 0;
+	while (lConnection->mSocket >= 0)
+	{
+		if (lConnection->mDiscard)
+		{
+			uint64_t lSkip = min<uint64_t>(lConnection->mDiscard, lBuffer.size() - lConsumed);
+			lConsumed += lSkip;
+			lConnection->mDiscard -= lSkip;
+			if (lConnection->mDiscard)
+			{
+				break;
+			}
+		}
+
+		if (lBuffer.size() - lConsumed < HEADER_LENGTH)
+		{
+			break;
+		}
+
+		const char *lMessage = lBuffer.data() + lConsumed;
+		if (lMessage[0] != 'H' || lMessage[1] != 'S')
+		{
+			SendFatalError(lConnection, FATAL_POORLY_FORMED_HEADER, "bad prologue");
+			Close(lConnection);
+			return false;
+		}
+
+		Header lHeader;
+		DecodeHeader(lMessage, &lHeader);
+
+		if (lHeader.mPayloadLength > MAX_MESSAGE_SIZE)
+		{
+			SendError(lConnection, ERROR_MESSAGE_TOO_LARGE, "message exceeds maximum message size");
+			lConsumed += HEADER_LENGTH;
+			lConnection->mDiscard = lHeader.mPayloadLength;
+			continue;
+		}
+
+		if (lBuffer.size() - lConsumed < HEADER_LENGTH + lHeader.mPayloadLength)
+		{
+			break;
+		}
+
+		Dispatch(lConnection, lHeader, lMessage + HEADER_LENGTH);
+		lConsumed += HEADER_LENGTH + lHeader.mPayloadLength;
+	}
+
+	if (lConnection->mSocket < 0)
+	{
+		return false;
+	}
+
+	lBuffer.erase(0, lConsumed);
+	return true;
+}
+
+bool Server::Dispatch(Connection *lConnection, const Header &lHeader, const char *lPayload)
+{
+	if (!lConnection->mSession)
+	{
+		switch (lHeader.mType)
+		{
+			case MSG_INITIALIZE:
+				return Initialize(lConnection, lHeader);
+			case MSG_ASYNC_INITIALIZE:
+				return AsyncInitialize(lConnection, lHeader);
+			default:
+				SendFatalError(lConnection, FATAL_INVALID_INITIALIZATION, "connection is not initialized");
+				Close(lConnection);
+				return false;
+		}
+	}
+
+	if (!lConnection->mSession->IsEstablished())
+	{
+		SendFatalError(lConnection, FATAL_CHANNELS_INACTIVE, "both channels must be established");
+		Close(lConnection);
+		return false;
+	}
+
+	if (lConnection->mAsync)
+	{
+		return DispatchAsynchronous(lConnection, lHeader, lPayload);
+	}
+
+	return DispatchSynchronous(lConnection, lHeader, lPayload);
+}
+
+bool Server::DispatchSynchronous(Connection *lConnection, const Header &lHeader, const char *lPayload)
+{
+	Session *lSession = lConnection->mSession;
+
+	switch (lHeader.mType)
+	{
+		case MSG_DATA:
+		case MSG_DATA_END:
+		{
+			if (lSession->mClearing)
+			{
+				break;
+			}
+
+			if (lSession->mMessage.size() + lHeader.mPayloadLength > MAX_MESSAGE_SIZE)
+			{
+				lSession->mMessage.clear();
+				SendError(lConnection, ERROR_MESSAGE_TOO_LARGE, "message exceeds maximum message size");
+				break;
+			}
+
+			lSession->mMessage.append(lPayload, lHeader.mPayloadLength);
+
+			if (lHeader.mType == MSG_DATA_END)
+			{
+				CommandMessage *lDataMessage = lSession->BuildMessage(lSession->mMessage, gScriptProcessor);
+				lDataMessage->SetTag(lHeader.mParameter);
+				if (lSession->Send(lDataMessage))
+				{
+					delete lDataMessage;
+					SendError(lConnection, ERROR_UNIDENTIFIED, "command queue is full");
+				}
+				lSession->mMessage.clear();
+			}
+			break;
+		}
+
+		case MSG_DEVICE_CLEAR_COMPLETE:
+		{
+			// The client's preferred mode is ignored, see hislip.hpp
+			lSession->mMessage.clear();
+			lSession->DiscardResponses();
+			lSession->mClearing = false;
+			return SendMessage(lConnection, MSG_DEVICE_CLEAR_ACKNOWLEDGE, mOverlapped ? OVERLAPPED_BIT : 0, 0);
+		}
+
+		case MSG_TRIGGER:
+			// There is no trigger model yet
+			break;
+
+		default:
+			if (lHeader.mType >= MSG_VENDOR_SPECIFIC_FIRST)
+			{
+				SendError(lConnection, ERROR_UNRECOGNIZED_VENDOR_MESSAGE, "unrecognized vendor defined message");
+			}
+			else
+			{
+				SendError(lConnection, ERROR_UNRECOGNIZED_MESSAGE_TYPE, "unrecognized message type");
+			}
+			break;
+	}
+
+	return true;
+}
+
+bool Server::DispatchAsynchronous(Connection *lConnection, const Header &lHeader, const char *lPayload)
+{
+	Session *lSession = lConnection->mSession;
+
+	switch (lHeader.mType)
+	{
+		case MSG_ASYNC_LOCK:
+			Lock(lSession, lHeader, lPayload);
+			break;
+
+		case MSG_ASYNC_LOCK_INFO:
+		{
+			uint32_t lHolders = mSharedOwners.size() + (mExclusiveOwner ? 1 : 0);
+			return SendMessage(lConnection, MSG_ASYNC_LOCK_INFO_RESPONSE, mExclusiveOwner ? 1 : 0, lHolders);
+		}
+
+		case MSG_ASYNC_REMOTE_LOCAL_CONTROL:
+			/*
+			 * Remote/local state is not modelled: there is no front panel to
+			 * lock out, and the USBTMC one lives in the gadget driver. Valid
+			 * requests (0 to 6) are acknowledged and otherwise ignored.
+			 */
+			if (lHeader.mControlCode > 6)
+			{
+				SendError(lConnection, ERROR_UNRECOGNIZED_CONTROL_CODE, "unrecognized remote/local request");
+				break;
+			}
+			return SendMessage(lConnection, MSG_ASYNC_REMOTE_LOCAL_RESPONSE, 0, 0);
+
+		case MSG_ASYNC_MAXIMUM_MESSAGE_SIZE:
+		{
+			if (lHeader.mPayloadLength != sizeof(uint64_t))
+			{
+				SendError(lConnection, ERROR_UNIDENTIFIED, "maximum message size payload must be 8 bytes");
+				break;
+			}
+
+			uint64_t lSize;
+			memcpy(&lSize, lPayload, sizeof(lSize));
+			lSession->mClientMaxMessageSize = be64toh(lSize);
+
+			lSize = htobe64(MAX_MESSAGE_SIZE);
+			return SendMessage(lConnection, MSG_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE, 0, 0,
+							   reinterpret_cast<const char *>(&lSize), sizeof(lSize));
+		}
+
+		case MSG_ASYNC_DEVICE_CLEAR:
+			lSession->mClearing = true;
+			lSession->mMessage.clear();
+			gSessionManager.Clear(&lSession->GetSession());
+			lSession->DiscardResponses();
+			return SendMessage(lConnection, MSG_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE, mOverlapped ? OVERLAPPED_BIT : 0, 0);
+
+		case MSG_ASYNC_STATUS_QUERY:
+			return SendMessage(lConnection, MSG_ASYNC_STATUS_RESPONSE, StatusModelApi::GetStatusByte(gPlatformStatus), 0);
+
+		default:
+			if (lHeader.mType >= MSG_VENDOR_SPECIFIC_FIRST)
+			{
+				SendError(lConnection, ERROR_UNRECOGNIZED_VENDOR_MESSAGE, "unrecognized vendor defined message");
+			}
+			else
+			{
+				SendError(lConnection, ERROR_UNRECOGNIZED_MESSAGE_TYPE, "unrecognized message type");
+			}
+			break;
+	}
+
+	return true;
+}
+
+bool Server::Initialize(Connection *lConnection, const Header &lHeader)
+{
+	if (mSessions.size() >= MAX_SESSIONS)
+	{
+		SendFatalError(lConnection, FATAL_MAXIMUM_CLIENTS, "maximum number of clients exceeded");
+		Close(lConnection);
+		return false;
+	}
+
+	uint16_t lClientVersion = lHeader.mParameter >> 16;
+	uint16_t lVersion = min(lClientVersion, PROTOCOL_VERSION);
+
+	uint16_t lSessionId = mNextSessionId++;
+	if (!mNextSessionId)
+	{
+		mNextSessionId = 1;
+	}
+
+	Session *lSession = new Session(lSessionId, lConnection);
+	mSessions.push_back(lSession);
+
+	lConnection->mSession = lSession;
+	lConnection->mAsync = false;
+
+	uint32_t lParameter = (static_cast<uint32_t>(lVersion) << 16) | lSessionId;
+	return SendMessage(lConnection, MSG_INITIALIZE_RESPONSE, mOverlapped ? OVERLAPPED_BIT : 0, lParameter);
+}
+
+bool Server::AsyncInitialize(Connection *lConnection, const Header &lHeader)
+{
+	uint16_t lSessionId = lHeader.mParameter & 0xffff;
+
+	for (Session *lSession : mSessions)
+	{
+		if (lSession->GetSessionId() == lSessionId && !lSession->mAsynchronous && !lSession->mClosed)
+		{
+			lSession->mAsynchronous = lConnection;
+			lConnection->mSession = lSession;
+			lConnection->mAsync = true;
+			return SendMessage(lConnection, MSG_ASYNC_INITIALIZE_RESPONSE, 0, VENDOR_ID);
+		}
+	}
+
+	SendFatalError(lConnection, FATAL_INVALID_INITIALIZATION, "unknown session id");
+	Close(lConnection);
+	return false;
+}
+
+void Server::DeliverResponses(Session *lSession)
+{
+	uint64_t lCount;
+	if (read(lSession->GetEventDescriptor(), &lCount, sizeof(lCount)) < 0 && errno != EAGAIN)
+	{
+		perror("HiSLIP eventfd read");
+	}
+
+	CommandMessage *lMessage;
+	while ((!lSession->mSynchronous || !lSession->mSynchronous->HasOutput()) && (lMessage = lSession->TryReceive()))
+	{
+		if (!lSession->mClearing && lSession->mSynchronous)
+		{
+			// A response carries the MessageID of the DataEND that produced it
+			uint32_t lMessageId = static_cast<uint32_t>(lMessage->GetTag());
+			const char *lData = lMessage->GetData();
+			uint64_t lRemaining = lMessage->GetLength();
+			uint64_t lChunk = min(lSession->mClientMaxMessageSize, MAX_MESSAGE_SIZE);
+			if (!lChunk)
+			{
+				lChunk = MAX_MESSAGE_SIZE;
+			}
+
+			while (lRemaining > lChunk)
+			{
+				SendMessage(lSession->mSynchronous, MSG_DATA, 0, lMessageId, lData, lChunk);
+				lData += lChunk;
+				lRemaining -= lChunk;
+			}
+			SendMessage(lSession->mSynchronous, MSG_DATA_END, 0, lMessageId, lData, lRemaining);
+		}
+
+		delete lMessage;
+	}
+}
+
+void Server::CheckServiceRequest(void)
+{
+	uint8_t lStatusByte = StatusModelApi::GetStatusByte(gPlatformStatus);
+
+	if ((lStatusByte & (1 << RQS_BIT)) && !(mLastStatusByte & (1 << RQS_BIT)))
+	{
+		for (Session *lSession : mSessions)
+		{
+			if (lSession->IsEstablished() && !lSession->mClosed)
+			{
+				SendMessage(lSession->mAsynchronous, MSG_ASYNC_SERVICE_REQUEST, lStatusByte, 0);
+			}
+		}
+	}
+
+	mLastStatusByte = lStatusByte;
+}
+
+void Server::Lock(Session *lSession, const Header &lHeader, const char *lPayload)
+{
+	Connection *lConnection = lSession->mAsynchronous;
+
+	if (lHeader.mControlCode == 0)
+	{
+		uint8_t lResponse = LOCK_ERROR;
+		if (mExclusiveOwner == lSession)
+		{
+			mExclusiveOwner = nullptr;
+			lResponse = LOCK_SUCCESS_EXCLUSIVE;
+		}
+		else if (find(mSharedOwners.begin(), mSharedOwners.end(), lSession) != mSharedOwners.end())
+		{
+			mSharedOwners.remove(lSession);
+			lResponse = LOCK_SUCCESS_SHARED;
+		}
+
+		if (mSharedOwners.empty())
+		{
+			mSharedLockName.clear();
+		}
+
+		SendMessage(lConnection, MSG_ASYNC_LOCK_RESPONSE, lResponse, 0);
+		ServiceLockRequests();
+		return;
+	}
+
+	if (lHeader.mControlCode != 1)
+	{
+		SendError(lConnection, ERROR_UNRECOGNIZED_CONTROL_CODE, "unrecognized lock request");
+		return;
+	}
+
+	string lName(lPayload, lHeader.mPayloadLength);
+	bool lShared = !lName.empty();
+
+	if (TryLock(lSession, lShared, lName))
+	{
+		SendMessage(lConnection, MSG_ASYNC_LOCK_RESPONSE, LOCK_SUCCESS_EXCLUSIVE, 0);
+	}
+	else if (lHeader.mParameter == 0)
+	{
+		SendMessage(lConnection, MSG_ASYNC_LOCK_RESPONSE, LOCK_FAILURE, 0);
+	}
+	else
+	{
+		chrono::steady_clock::time_point lDeadline = chrono::steady_clock::now() + chrono::milliseconds(lHeader.mParameter);
+		mLockRequests.push_back({lSession, lShared, lName, lDeadline});
+	}
+}
+
+void Server::Unlock(Session *lSession)
+{
+	if (mExclusiveOwner == lSession)
+	{
+		mExclusiveOwner = nullptr;
+	}
+
+	mSharedOwners.remove(lSession);
+	if (mSharedOwners.empty())
+	{
+		mSharedLockName.clear();
+	}
+
+	mLockRequests.remove_if([lSession](const LockRequest &lRequest) { return lRequest.mSession == lSession; });
+}
+
+bool Server::TryLock(Session *lSession, bool lShared, const string &lName)
+{
+	if (mExclusiveOwner && mExclusiveOwner != lSession)
+	{
+		return false;
+	}
+
+	if (!lShared)
+	{
+		for (Session *lOwner : mSharedOwners)
+		{
+			if (lOwner != lSession)
+			{
+				return false;
+			}
+		}
+
+		mExclusiveOwner = lSession;
+		return true;
+	}
+
+	if (!mSharedOwners.empty() && lName != mSharedLockName)
+	{
+		return false;
+	}
+
+	if (find(mSharedOwners.begin(), mSharedOwners.end(), lSession) == mSharedOwners.end())
+	{
+		mSharedOwners.push_back(lSession);
+	}
+	mSharedLockName = lName;
+
+	return true;
+}
+
+void Server::ServiceLockRequests(void)
+{
+	chrono::steady_clock::time_point lNow = chrono::steady_clock::now();
+
+	for (auto lIterator = mLockRequests.begin(); lIterator != mLockRequests.end();)
+	{
+		Session *lSession = lIterator->mSession;
+
+		if (TryLock(lSession, lIterator->mShared, lIterator->mName))
+		{
+			SendMessage(lSession->mAsynchronous, MSG_ASYNC_LOCK_RESPONSE, LOCK_SUCCESS_EXCLUSIVE, 0);
+			lIterator = mLockRequests.erase(lIterator);
+		}
+		else if (lNow >= lIterator->mDeadline)
+		{
+			SendMessage(lSession->mAsynchronous, MSG_ASYNC_LOCK_RESPONSE, LOCK_FAILURE, 0);
+			lIterator = mLockRequests.erase(lIterator);
+		}
+		else
+		{
+			++lIterator;
+		}
+	}
+}
+
+bool Server::IsBlockedByLock(Session *lSession) const
+{
+	if (mExclusiveOwner)
+	{
+		return mExclusiveOwner != lSession;
+	}
+
+	if (!mSharedOwners.empty())
+	{
+		return find(mSharedOwners.begin(), mSharedOwners.end(), lSession) == mSharedOwners.end();
+	}
+
+	return false;
+}
+
+int Server::GetPollTimeout(void) const
+{
+	int lTimeout = POLL_TIMEOUT_MS;
+	chrono::steady_clock::time_point lNow = chrono::steady_clock::now();
+
+	for (const LockRequest &lRequest : mLockRequests)
+	{
+		auto lRemaining = chrono::duration_cast<chrono::milliseconds>(lRequest.mDeadline - lNow).count();
+		lTimeout = min<int>(lTimeout, max<decltype(lRemaining)>(lRemaining, 0));
+	}
+
+	return lTimeout;
+}
+
+void Server::Close(Connection *lConnection)
+{
+	if (lConnection->mSession)
+	{
+		CloseSession(lConnection->mSession);
+		return;
+	}
+
+	if (lConnection->mSocket >= 0)
+	{
+		close(lConnection->mSocket);
+		lConnection->mSocket = -1;
+	}
+}
+
+void Server::CloseSession(Session *lSession)
+{
+	if (lSession->mClosed)
+	{
+		return;
+	}
+
+	Unlock(lSession);
+
+	for (Connection *lConnection : {lSession->mSynchronous, lSession->mAsynchronous})
+	{
+		if (lConnection && lConnection->mSocket >= 0)
+		{
+			close(lConnection->mSocket);
+			lConnection->mSocket = -1;
+		}
+	}
+
+	lSession->mSynchronous = nullptr;
+	lSession->mAsynchronous = nullptr;
+	lSession->mClosed = true;
+}
+
+bool Server::SendMessage(Connection *lConnection, uint8_t lType, uint8_t lControlCode, uint32_t lParameter,
+						 const char *lPayload, uint64_t lLength)
+{
+	if (!lConnection || lConnection->mSocket < 0)
+	{
+		return false;
+	}
+
+	char lHeader[HEADER_LENGTH];
+	uint32_t lNetParameter = htobe32(lParameter);
+	uint64_t lNetLength = htobe64(lLength);
+
+	lHeader[0] = 'H';
+	lHeader[1] = 'S';
+	lHeader[2] = static_cast<char>(lType);
+	lHeader[3] = static_cast<char>(lControlCode);
+	memcpy(lHeader + 4, &lNetParameter, sizeof(lNetParameter));
+	memcpy(lHeader + 8, &lNetLength, sizeof(lNetLength));
+
+	lConnection->mOutput.append(lHeader, HEADER_LENGTH);
+	if (lLength)
+	{
+		lConnection->mOutput.append(lPayload, lLength);
+	}
+
+	Flush(lConnection);
+	return lConnection->mSocket >= 0;
+}
+
+/*
+ * Write as much of the connection's queued output as the socket will take;
+ * POLLOUT resumes the rest.
+ */
+void Server::Flush(Connection *lConnection)
+{
+	while (lConnection->HasOutput())
+	{
+		ssize_t lWritten = send(lConnection->mSocket, lConnection->mOutput.data() + lConnection->mOutputOffset,
+								lConnection->mOutput.size() - lConnection->mOutputOffset, MSG_NOSIGNAL);
+		if (lWritten < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				perror("HiSLIP send");
+				Close(lConnection);
+			}
+			return;
+		}
+
+		lConnection->mOutputOffset += lWritten;
+	}
+
+	lConnection->mOutput.clear();
+	lConnection->mOutputOffset = 0;
+}
+
+void Server::SendFatalError(Connection *lConnection, FatalErrorCode lCode, const char *lMessage)
+{
+	SendMessage(lConnection, MSG_FATAL_ERROR, lCode, 0, lMessage, strlen(lMessage));
+}
+
+void Server::SendError(Connection *lConnection, ErrorCode lCode, const char *lMessage)
+{
+	SendMessage(lConnection, MSG_ERROR, lCode, 0, lMessage, strlen(lMessage));
+}
@@ -6,6 +6,7 @@
  */
 
 
+#include "binding.hpp"
 #include "lua.hpp"
 #include "led.hpp"
 
@@ -19,153 +20,33 @@
 
 Led gLed;
 
+static constexpr auto sLedBinding = Bind<Led>()
+	.Property<&Led::IsOn, &Led::Set>("state")
+	.Method<&Led::Toggle>("toggle");
+
 void LedInstall(lua_State *lState) {
 	Lua lLua(lState);
 
-	// MakeTable
-	lLua.NewTable();
-	lLua.MakeTableReadOnly();
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led DeviceTable
-	 */
-
-	// AddGetter
-	lLua.PushString("state");
-	lLua.PushLightUserData(&gLed);
-	lLua.PushInteger(FUNC_GET);
-	lLua.PushCClosure(Led::HandleMsg, 2);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * HandleMsg "state" led DeviceTable
-	 */
-
-	// AddRotMetaObject
-	lLua.GetMetaTable(-3);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable HandleMsg "state" led DeviceTable
-	 */
-	lLua.PushString("Getters");
-	lLua.GetTable(-2);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable.Getters led.__metatable HandleMsg "state" led DeviceTable
-	 */
-	lLua.Insert(-4);
-	lLua.Pop(1);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * HandleMsg "state" led.__metatable.Getters led DeviceTable
-	 */
-	lLua.SetTable(-3);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable.Getters led DeviceTable
-	 */
-	lLua.Pop(1);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led DeviceTable
-	 */
-
-	// AddSetter
-	lLua.PushString("state");
-	lLua.PushLightUserData(&gLed);
-	lLua.PushInteger(FUNC_SET);
-	lLua.PushCClosure(Led::HandleMsg, 2);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * HandleMsg "state" led DeviceTable
-	 */
-
-	// AddRotMetaObject
-	lLua.GetMetaTable(-3);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable HandleMsg "state" led DeviceTable
-	 */
-	lLua.PushString("Setters");
-	lLua.GetTable(-2);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable.Setters led.__metatable HandleMsg "state" led DeviceTable
-	 */
-	lLua.Insert(-4);
-	lLua.Pop(1);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * HandleMsg "state" led.__metatable.Setters led DeviceTable
-	 */
-	lLua.SetTable(-3);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable.Getters led DeviceTable
-	 */
-	lLua.Pop(1);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led DeviceTable
-	 */
-	lLua.PushString("toggle");
-	lLua.PushLightUserData(&gLed);
-	lLua.PushCClosure(Led::Toggle, 1);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * Toggle "toggle" led DeviceTable
-	 */
-	lLua.GetMetaTable(-3);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable Toggle "toggle" led DeviceTable
-	 */
-	lLua.PushString("Objects");
-	lLua.GetTable(-2);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable.Objects led.__metatable Toggle "toggle" led DeviceTable
-	 */
-	lLua.Insert(-4);
-	lLua.Pop(1);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * Toggle "toggle" led.__metatable.Objects led DeviceTable
-	 */
-	lLua.SetTable(-3);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * led.__metatable.Objects led DeviceTable
-	 */
-	lLua.Pop(1);
+	PushBound<sLedBinding>(lLua, &gLed);
 
 	lLua.SetGlobal("led");
+}
 
-	/*
-	 * Stack: (top down)
-	 * 		: * DeviceTable
-	 */
+
+/*
+ * The brightness node is opened on first use rather than at static
+ * construction, so a start that never touches the LED does not wait on sysfs.
+ */
+Led::Led(void) : mFileDescriptor(-1), mState(OFF) {
 }
 
+Led::~Led(void) {
+	if(mFileDescriptor >= 0) {
+		close(mFileDescriptor);
+	}
+}
 
-Led::Led(void) : mState(OFF) {
+void Led::Open(void) {
 	mFileDescriptor = open(LED_BRIGHTNESS_PATH, O_RDWR);
 	if(mFileDescriptor < 0)
 	{
@@ -180,12 +61,12 @@ Led::Led(void) : mState(OFF) {
 	}
 }
 
-Led::~Led(void) {
-	close(mFileDescriptor);
-}
-
 void Led::On(void) {
 
+	if(mFileDescriptor < 0) {
+		Open();
+	}
+
 	mState = ON;
 
 	int lError = write(mFileDescriptor, "1", 1);
@@ -199,6 +80,10 @@ void Led::On(void) {
 
 void Led::Off(void) {
 
+	if(mFileDescriptor < 0) {
+		Open();
+	}
+
 	mState = OFF;
 
 	int lError = write(mFileDescriptor, "0", 1);
@@ -210,6 +95,15 @@ void Led::Off(void) {
 	fsync(mFileDescriptor);
 }
 
+void Led::Set(bool lOn) {
+	if(lOn) {
+		On();
+	}
+	else {
+		Off();
+	}
+}
+
 void Led::Toggle(void) {
 	if(ON == mState) {
 		Off();
@@ -219,73 +113,6 @@ void Led::Toggle(void) {
 	}
 }
 
-int Led::On(lua_State *lState) {
-	Lua lLua(lState);
-
-	Led *lLed = static_cast<Led *>(lLua.ToUserData(lLua.UpValueIndex(1)));
-
-	lLed->On();
-
-	return 0;
-}
-
-int Led::Off(lua_State *lState) {
-	Lua lLua(lState);
-
-	Led *lLed = static_cast<Led *>(lLua.ToUserData(lLua.UpValueIndex(1)));
-
-	lLed->Off();
-
-	return 0;
-}
-
-int Led::Toggle(lua_State *lState) {
-	Lua lLua(lState);
-
-	Led *lLed = static_cast<Led *>(lLua.ToUserData(lLua.UpValueIndex(1)));
-
-	lLed->Toggle();
-
-	return 0;
-}
-
-int Led::HandleMsg(lua_State *lState) {
-
-	int lRet = 0;
-
-	Lua lLua(lState);
-
-	Led *lLed = static_cast<Led *>(lLua.ToUserData(lLua.UpValueIndex(1)));
-
-	LedFunctions lFunc = static_cast<LedFunctions>(lLua.ToInteger(lLua.UpValueIndex(2)));
-
-	switch(lFunc) {
-	case FUNC_GET:
-		lLua.PushBoolean(lLed->GetState());
-		lRet = 1;
-		break;
-	case FUNC_SET:
-		if(lLua.IsBoolean(1)) {
-			int lArgCount = lLua.GetTop();
-			if(lArgCount == 1) {
-				bool lNewLedState = lLua.ToBoolean(1);
-				switch(lNewLedState) {
-				case true:
-					lLed->On();
-					break;
-				case false:
-					lLed->Off();
-					break;
-				}
-			}
-		}
-		break;
-	}
-
-	return lRet;
-}
-
-
 #ifdef RUN_LED_TEST
 
 #ifdef __cplusplus
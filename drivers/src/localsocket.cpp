@@ -0,0 +1,525 @@
+/*
+ * localsocket.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "localsocket.hpp"
+#include "scriptprocessor.hpp"
+
+using namespace LocalSocket;
+
+constexpr int REQUIRED_INPUT_SEALS = F_SEAL_SHRINK | F_SEAL_WRITE;
+constexpr int RESPONSE_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL;
+
+Connection::Connection(int lSocket)
+: CommandInterface(64, "local")
+, mSocket{lSocket}
+, mClosed{false}
+{
+	mEventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (mEventDescriptor < 0)
+	{
+		perror("could not create local socket eventfd");
+		exit(EXIT_FAILURE);
+	}
+
+	SetNotifyDescriptor(mEventDescriptor);
+
+	AdmissionLimits lLimits = GetAdmissionLimits();
+	lLimits.mFlowControlled = true;
+	SetAdmissionLimits(lLimits);
+}
+
+Connection::~Connection()
+{
+	Shutdown();
+	SetNotifyDescriptor(-1);
+
+	for (CommandMessage *lPending : mInput)
+	{
+		delete lPending;
+	}
+
+	for (CommandMessage *lPending : mOutput)
+	{
+		delete lPending;
+	}
+
+	close(mEventDescriptor);
+	if (mSocket >= 0)
+	{
+		close(mSocket);
+	}
+}
+
+void Connection::SubmitBacklog(void)
+{
+	while (!mInput.empty())
+	{
+		if (Send(mInput.front()))
+		{
+			break;
+		}
+		mInput.pop_front();
+	}
+}
+
+Server::Server(const char *lPath)
+: mPath{lPath}
+, mReceiveBuffer(sizeof(Header) + MAX_INLINE_LENGTH)
+{
+	mServerSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (mServerSocket < 0)
+	{
+		perror("local socket");
+		exit(EXIT_FAILURE);
+	}
+
+	struct sockaddr_un lServerSockAddr;
+	memset(&lServerSockAddr, 0, sizeof(lServerSockAddr));
+	lServerSockAddr.sun_family = AF_UNIX;
+	if (mPath.length() >= sizeof(lServerSockAddr.sun_path))
+	{
+		fprintf(stderr, "local socket path too long: %s\n", lPath);
+		exit(EXIT_FAILURE);
+	}
+	strncpy(lServerSockAddr.sun_path, lPath, sizeof(lServerSockAddr.sun_path) - 1);
+
+	// A stale socket left by a previous run would make bind() fail
+	unlink(lPath);
+
+	if (bind(mServerSocket, reinterpret_cast<struct sockaddr *>(&lServerSockAddr), sizeof(lServerSockAddr)))
+	{
+		perror("local socket bind");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(mServerSocket, MAX_CONNECTIONS))
+	{
+		perror("local socket listen");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+}
+
+Server::~Server()
+{
+	for (Connection *lConnection : mConnections)
+	{
+		delete lConnection;
+	}
+
+	close(mServerSocket);
+	unlink(mPath.c_str());
+}
+
+void Server::Poll(void)
+{
+	mPollFds.clear();
+	mPollConnections.clear();
+
+	mPollFds.push_back({mServerSocket, static_cast<short>(mConnections.size() < MAX_CONNECTIONS ? POLLIN : 0), 0});
+	mPollConnections.push_back(nullptr);
+
+	// Socket first, then the eventfd signalled when a response is queued
+	for (Connection *lConnection : mConnections)
+	{
+		short lEvents = (lConnection->HasBacklog() ? 0 : POLLIN) | (lConnection->HasOutput() ? POLLOUT : 0);
+		mPollFds.push_back({lConnection->GetSocket(), lEvents, 0});
+		mPollFds.push_back({lConnection->GetEventDescriptor(), POLLIN, 0});
+		mPollConnections.push_back(lConnection);
+		mPollConnections.push_back(lConnection);
+	}
+
+	int lReady = poll(mPollFds.data(), mPollFds.size(), GetPollTimeout());
+	if (lReady < 0)
+	{
+		if (errno != EINTR)
+		{
+			perror("local socket poll");
+		}
+		return;
+	}
+
+	if (mPollFds[0].revents & POLLIN)
+	{
+		Accept();
+	}
+
+	for (size_t lIndex = 1; lIndex + 1 < mPollFds.size(); lIndex += 2)
+	{
+		Connection *lConnection = mPollConnections[lIndex];
+
+		if (mPollFds[lIndex + 1].revents & POLLIN)
+		{
+			Collect(lConnection);
+		}
+
+		if (mPollFds[lIndex].revents & (POLLIN | POLLHUP | POLLERR))
+		{
+			Receive(lConnection);
+		}
+
+		if (lConnection->mClosed)
+		{
+			continue;
+		}
+
+		lConnection->SubmitBacklog();
+
+		if (lConnection->HasOutput())
+		{
+			Flush(lConnection);
+		}
+	}
+
+	for (auto lIterator = mConnections.begin(); lIterator != mConnections.end();)
+	{
+		if ((*lIterator)->mClosed)
+		{
+			delete *lIterator;
+			lIterator = mConnections.erase(lIterator);
+		}
+		else
+		{
+			++lIterator;
+		}
+	}
+}
+
+void Server::Accept(void)
+{
+	int lSocket = accept4(mServerSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (lSocket < 0)
+	{
+		perror("local socket accept");
+		return;
+	}
+
+	mConnections.push_back(new Connection(lSocket));
+}
+
+void Server::Receive(Connection *lConnection)
+{
+	union
+	{
+		char mBuffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr mAlign;
+	} lControl;
+
+	struct iovec lVector = { mReceiveBuffer.data(), mReceiveBuffer.size() };
+	struct msghdr lHeader;
+	memset(&lHeader, 0, sizeof(lHeader));
+	lHeader.msg_iov = &lVector;
+	lHeader.msg_iovlen = 1;
+	lHeader.msg_control = lControl.mBuffer;
+	lHeader.msg_controllen = sizeof(lControl.mBuffer);
+
+	ssize_t lBytesRead = recvmsg(lConnection->GetSocket(), &lHeader, MSG_CMSG_CLOEXEC);
+	if (lBytesRead < 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			Close(lConnection);
+		}
+		return;
+	}
+	else if (lBytesRead == 0)
+	{
+		Close(lConnection);
+		return;
+	}
+
+	// Only the first descriptor is used, any others the peer passed are closed
+	int lFileDescriptor = -1;
+	for (struct cmsghdr *lCmsg = CMSG_FIRSTHDR(&lHeader); lCmsg; lCmsg = CMSG_NXTHDR(&lHeader, lCmsg))
+	{
+		if (lCmsg->cmsg_level != SOL_SOCKET || lCmsg->cmsg_type != SCM_RIGHTS)
+		{
+			continue;
+		}
+
+		size_t lCount = (lCmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t lIndex = 0; lIndex < lCount; lIndex++)
+		{
+			int lReceived;
+			memcpy(&lReceived, CMSG_DATA(lCmsg) + lIndex * sizeof(int), sizeof(lReceived));
+			if (lFileDescriptor < 0)
+			{
+				lFileDescriptor = lReceived;
+			}
+			else
+			{
+				close(lReceived);
+			}
+		}
+	}
+
+	Header lMessageHeader;
+	if (static_cast<size_t>(lBytesRead) < sizeof(lMessageHeader) || (lHeader.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+	{
+		SendError(lConnection, "malformed message");
+	}
+	else
+	{
+		memcpy(&lMessageHeader, mReceiveBuffer.data(), sizeof(lMessageHeader));
+		size_t lInlineLength = lBytesRead - sizeof(lMessageHeader);
+
+		if (!(lMessageHeader.mFlags & FLAG_MEMFD))
+		{
+			if (lMessageHeader.mLength != lInlineLength || lFileDescriptor >= 0)
+			{
+				SendError(lConnection, "inline length mismatch");
+			}
+			else
+			{
+				Submit(lConnection, mReceiveBuffer.data() + sizeof(lMessageHeader), lInlineLength);
+			}
+		}
+		else if (lFileDescriptor < 0)
+		{
+			SendError(lConnection, "memfd flag without a file descriptor");
+		}
+		else
+		{
+			struct stat lStat;
+			int lSeals = fcntl(lFileDescriptor, F_GET_SEALS);
+
+			if (lSeals < 0 || (lSeals & REQUIRED_INPUT_SEALS) != REQUIRED_INPUT_SEALS)
+			{
+				SendError(lConnection, "memfd is not sealed");
+			}
+			else if (fstat(lFileDescriptor, &lStat) || static_cast<uint64_t>(lStat.st_size) < lMessageHeader.mLength)
+			{
+				SendError(lConnection, "memfd is shorter than the message");
+			}
+			else if (lMessageHeader.mLength > MAX_MESSAGE_LENGTH)
+			{
+				SendError(lConnection, "message too large");
+			}
+			else if (lMessageHeader.mLength == 0)
+			{
+				Submit(lConnection, "", 0);
+			}
+			else
+			{
+				void *lMapping = mmap(nullptr, lMessageHeader.mLength, PROT_READ, MAP_SHARED, lFileDescriptor, 0);
+				if (lMapping == MAP_FAILED)
+				{
+					perror("local socket mmap");
+					SendError(lConnection, "could not map memfd");
+				}
+				else
+				{
+					Submit(lConnection, static_cast<const char *>(lMapping), lMessageHeader.mLength);
+					munmap(lMapping, lMessageHeader.mLength);
+				}
+			}
+		}
+	}
+
+	if (lFileDescriptor >= 0)
+	{
+		close(lFileDescriptor);
+	}
+}
+
+void Server::Submit(Connection *lConnection, const char *lData, size_t lLength)
+{
+	CommandMessage *lMessage = lConnection->BuildMessage(lData, lLength, gScriptProcessor);
+	if (lConnection->HasBacklog() || lConnection->Send(lMessage))
+	{
+		lConnection->mInput.push_back(lMessage);
+	}
+}
+
+void Server::Collect(Connection *lConnection)
+{
+	uint64_t lCount;
+	if (read(lConnection->GetEventDescriptor(), &lCount, sizeof(lCount)) < 0 && errno != EAGAIN)
+	{
+		perror("local socket eventfd read");
+	}
+
+	CommandMessage *lMessage;
+	while ((lMessage = lConnection->TryReceive()))
+	{
+		lConnection->mOutput.push_back(lMessage);
+	}
+}
+
+void Server::Flush(Connection *lConnection)
+{
+	while (lConnection->HasOutput() && !lConnection->mClosed)
+	{
+		CommandMessage *lMessage = lConnection->mOutput.front();
+		bool lSent;
+
+		if (lMessage->GetLength() > MEMFD_THRESHOLD)
+		{
+			lSent = SendMemfd(lConnection, lMessage->GetData(), lMessage->GetLength());
+		}
+		else
+		{
+			lSent = SendInline(lConnection, 0, lMessage->GetData(), lMessage->GetLength());
+		}
+
+		if (!lSent)
+		{
+			return;
+		}
+
+		lConnection->mOutput.pop_front();
+		delete lMessage;
+	}
+}
+
+/*
+ * Returns false when the socket is full (the message stays queued) or has
+ * failed (the connection is closed).
+ */
+bool Server::SendInline(Connection *lConnection, uint32_t lFlags, const char *lData, size_t lLength)
+{
+	Header lHeader = { lFlags, 0, lLength };
+	struct iovec lVector[2] = {
+		{ &lHeader, sizeof(lHeader) },
+		{ const_cast<char *>(lData), lLength },
+	};
+
+	struct msghdr lMessage;
+	memset(&lMessage, 0, sizeof(lMessage));
+	lMessage.msg_iov = lVector;
+	lMessage.msg_iovlen = lLength ? 2 : 1;
+
+	if (sendmsg(lConnection->GetSocket(), &lMessage, MSG_NOSIGNAL) < 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			Close(lConnection);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+bool Server::SendMemfd(Connection *lConnection, const char *lData, size_t lLength)
+{
+	int lFileDescriptor = memfd_create("aardvark-response", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (lFileDescriptor < 0)
+	{
+		perror("memfd_create");
+		return SendInline(lConnection, 0, lData, lLength);
+	}
+
+	if (ftruncate(lFileDescriptor, lLength))
+	{
+		perror("memfd ftruncate");
+		close(lFileDescriptor);
+		return SendInline(lConnection, 0, lData, lLength);
+	}
+
+	void *lMapping = mmap(nullptr, lLength, PROT_WRITE, MAP_SHARED, lFileDescriptor, 0);
+	if (lMapping == MAP_FAILED)
+	{
+		perror("memfd mmap");
+		close(lFileDescriptor);
+		return SendInline(lConnection, 0, lData, lLength);
+	}
+
+	memcpy(lMapping, lData, lLength);
+	// F_SEAL_WRITE is refused while a writable shared mapping exists
+	munmap(lMapping, lLength);
+
+	if (fcntl(lFileDescriptor, F_ADD_SEALS, RESPONSE_SEALS))
+	{
+		perror("memfd seal");
+		close(lFileDescriptor);
+		return SendInline(lConnection, 0, lData, lLength);
+	}
+
+	union
+	{
+		char mBuffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr mAlign;
+	} lControl;
+	memset(&lControl, 0, sizeof(lControl));
+
+	Header lHeader = { FLAG_MEMFD, 0, lLength };
+	struct iovec lVector = { &lHeader, sizeof(lHeader) };
+
+	struct msghdr lMessage;
+	memset(&lMessage, 0, sizeof(lMessage));
+	lMessage.msg_iov = &lVector;
+	lMessage.msg_iovlen = 1;
+	lMessage.msg_control = lControl.mBuffer;
+	lMessage.msg_controllen = sizeof(lControl.mBuffer);
+
+	struct cmsghdr *lCmsg = CMSG_FIRSTHDR(&lMessage);
+	lCmsg->cmsg_level = SOL_SOCKET;
+	lCmsg->cmsg_type = SCM_RIGHTS;
+	lCmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(lCmsg), &lFileDescriptor, sizeof(lFileDescriptor));
+
+	ssize_t lResult = sendmsg(lConnection->GetSocket(), &lMessage, MSG_NOSIGNAL);
+	int lError = errno;
+
+	// The receiver holds its own reference once the message is queued
+	close(lFileDescriptor);
+
+	if (lResult < 0)
+	{
+		if (lError != EAGAIN && lError != EWOULDBLOCK && lError != EINTR)
+		{
+			Close(lConnection);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+void Server::SendError(Connection *lConnection, const char *lMessage)
+{
+	SendInline(lConnection, FLAG_ERROR, lMessage, strlen(lMessage));
+}
+
+void Server::Close(Connection *lConnection)
+{
+	if (lConnection->mSocket >= 0)
+	{
+		close(lConnection->mSocket);
+		lConnection->mSocket = -1;
+	}
+
+	lConnection->mClosed = true;
+}
+
+int Server::GetPollTimeout(void) const
+{
+	for (const Connection *lConnection : mConnections)
+	{
+		if (lConnection->HasBacklog())
+		{
+			return BACKLOG_RETRY_MS;
+		}
+	}
+
+	return POLL_TIMEOUT_MS;
+}
@@ -0,0 +1,241 @@
+/*
+ * scpisocket.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "scpisocket.hpp"
+
+using namespace ScpiSocket;
+
+Connection::Connection(int lSocket, const char *lInputTerminators, const char *lOutputTerminator)
+: StreamInterface("socket", lInputTerminators, lOutputTerminator, MAX_MESSAGE_LENGTH)
+, mSocket{lSocket}
+, mClosed{false}
+{
+}
+
+Connection::~Connection()
+{
+	if (mSocket >= 0)
+	{
+		close(mSocket);
+	}
+}
+
+ssize_t Connection::Read(void *lBuffer, size_t lLength)
+{
+	return recv(mSocket, lBuffer, lLength, 0);
+}
+
+ssize_t Connection::Write(const struct iovec *lVector, int lCount)
+{
+	struct msghdr lHeader;
+	memset(&lHeader, 0, sizeof(lHeader));
+	lHeader.msg_iov = const_cast<struct iovec *>(lVector);
+	lHeader.msg_iovlen = lCount;
+
+	return sendmsg(mSocket, &lHeader, MSG_NOSIGNAL);
+}
+
+Server::Server(uint16_t lPort, const char *lInputTerminators, const char *lOutputTerminator)
+: mInputTerminators{lInputTerminators}
+, mOutputTerminator{lOutputTerminator}
+{
+	mServerSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (mServerSocket < 0)
+	{
+		perror("SCPI socket");
+		exit(EXIT_FAILURE);
+	}
+
+	int lOpt = 1;
+	if (setsockopt(mServerSocket, SOL_SOCKET, SO_REUSEADDR, &lOpt, sizeof(lOpt)))
+	{
+		perror("setsockopt (SO_REUSEADDR)");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+
+	struct sockaddr_in lServerSockAddr;
+	memset(&lServerSockAddr, 0, sizeof(lServerSockAddr));
+	lServerSockAddr.sin_family = AF_INET;
+	lServerSockAddr.sin_port = htons(lPort);
+	lServerSockAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (bind(mServerSocket, reinterpret_cast<struct sockaddr *>(&lServerSockAddr), sizeof(lServerSockAddr)))
+	{
+		perror("SCPI bind");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(mServerSocket, MAX_CONNECTIONS))
+	{
+		perror("SCPI listen");
+		close(mServerSocket);
+		exit(EXIT_FAILURE);
+	}
+}
+
+Server::~Server()
+{
+	for (Connection *lConnection : mConnections)
+	{
+		delete lConnection;
+	}
+
+	close(mServerSocket);
+}
+
+void Server::Poll(void)
+{
+	mPollFds.clear();
+	mPollConnections.clear();
+
+	mPollFds.push_back({mServerSocket, static_cast<short>(mConnections.size() < MAX_CONNECTIONS ? POLLIN : 0), 0});
+	mPollConnections.push_back(nullptr);
+
+	/*
+	 * Each connection contributes two entries: its socket followed by the
+	 * eventfd signalled when the script processor queues a response.
+	 */
+	for (Connection *lConnection : mConnections)
+	{
+		short lEvents = (lConnection->HasBacklog() ? 0 : POLLIN) | (lConnection->HasOutput() ? POLLOUT : 0);
+		mPollFds.push_back({lConnection->GetSocket(), lEvents, 0});
+		mPollFds.push_back({lConnection->GetEventDescriptor(), POLLIN, 0});
+		mPollConnections.push_back(lConnection);
+		mPollConnections.push_back(lConnection);
+	}
+
+	int lReady = poll(mPollFds.data(), mPollFds.size(), GetPollTimeout());
+	if (lReady < 0)
+	{
+		if (errno != EINTR)
+		{
+			perror("SCPI poll");
+		}
+		return;
+	}
+
+	if (mPollFds[0].revents & POLLIN)
+	{
+		Accept();
+	}
+
+	for (size_t lIndex = 1; lIndex + 1 < mPollFds.size(); lIndex += 2)
+	{
+		Connection *lConnection = mPollConnections[lIndex];
+
+		if (mPollFds[lIndex + 1].revents & POLLIN)
+		{
+			lConnection->Collect();
+		}
+
+		if (mPollFds[lIndex].revents & (POLLIN | POLLHUP | POLLERR))
+		{
+			Receive(lConnection);
+		}
+
+		if (lConnection->mClosed)
+		{
+			continue;
+		}
+
+		lConnection->SubmitBacklog();
+
+		if (lConnection->HasOutput())
+		{
+			Flush(lConnection);
+		}
+	}
+
+	for (auto lIterator = mConnections.begin(); lIterator != mConnections.end();)
+	{
+		if ((*lIterator)->mClosed)
+		{
+			delete *lIterator;
+			lIterator = mConnections.erase(lIterator);
+		}
+		else
+		{
+			++lIterator;
+		}
+	}
+}
+
+void Server::Accept(void)
+{
+	struct sockaddr_in lClientAddr;
+	socklen_t lLength = sizeof(lClientAddr);
+
+	int lSocket = accept4(mServerSocket, reinterpret_cast<struct sockaddr *>(&lClientAddr), &lLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (lSocket < 0)
+	{
+		perror("SCPI accept");
+		return;
+	}
+
+	int lOpt = 1;
+	if (setsockopt(lSocket, IPPROTO_TCP, TCP_NODELAY, &lOpt, sizeof(lOpt)))
+	{
+		perror("setsockopt (TCP_NODELAY)");
+	}
+
+	mConnections.push_back(new Connection(lSocket, mInputTerminators.c_str(), mOutputTerminator.c_str()));
+}
+
+void Server::Receive(Connection *lConnection)
+{
+	ssize_t lBytesRead = lConnection->Receive(RECEIVE_CHUNK_SIZE);
+	if (lBytesRead == 0 || (lBytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+	{
+		Close(lConnection);
+	}
+}
+
+void Server::Flush(Connection *lConnection)
+{
+	if (lConnection->Drain())
+	{
+		Close(lConnection);
+	}
+}
+
+void Server::Close(Connection *lConnection)
+{
+	if (lConnection->mSocket >= 0)
+	{
+		close(lConnection->mSocket);
+		lConnection->mSocket = -1;
+	}
+
+	lConnection->mClosed = true;
+}
+
+int Server::GetPollTimeout(void) const
+{
+	for (const Connection *lConnection : mConnections)
+	{
+		if (lConnection->HasBacklog())
+		{
+			return BACKLOG_RETRY_MS;
+		}
+	}
+
+	return POLL_TIMEOUT_MS;
+}
@@ -0,0 +1,226 @@
+/*
+ * serial.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "serial.hpp"
+
+using namespace Serial;
+
+struct BaudRate
+{
+	uint32_t mRate;
+	speed_t mSpeed;
+};
+
+static const BaudRate sBaudRates[] = {
+	{ 9600, B9600 },
+	{ 19200, B19200 },
+	{ 38400, B38400 },
+	{ 57600, B57600 },
+	{ 115200, B115200 },
+	{ 230400, B230400 },
+	{ 460800, B460800 },
+	{ 500000, B500000 },
+	{ 576000, B576000 },
+	{ 921600, B921600 },
+	{ 1000000, B1000000 },
+	{ 1500000, B1500000 },
+	{ 2000000, B2000000 },
+	{ 3000000, B3000000 },
+	{ 4000000, B4000000 },
+};
+
+Port::Port(const char *lPath, const Settings &lSettings)
+: StreamInterface("serial", lSettings.mInputTerminators, lSettings.mOutputTerminator, MAX_MESSAGE_LENGTH)
+, mReadDescriptor{-1}
+, mWriteDescriptor{-1}
+{
+	mReadDescriptor = open(lPath, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (mReadDescriptor < 0)
+	{
+		// Not every fixture has a serial link; stay closed and let the caller bail out
+		if (errno != ENOENT && errno != ENODEV && errno != ENXIO)
+		{
+			perror("could not open serial device");
+		}
+		return;
+	}
+
+	/*
+	 * O_NONBLOCK belongs to the open file description, and VMIN/VTIME are
+	 * ignored on a non-blocking read, so output gets a descriptor of its own.
+	 */
+	mWriteDescriptor = open(lPath, O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (mWriteDescriptor < 0)
+	{
+		perror("could not open serial device for writing");
+		Close();
+		return;
+	}
+
+	if (tcgetattr(mReadDescriptor, &mSavedAttributes))
+	{
+		perror("tcgetattr");
+		Close();
+		return;
+	}
+
+	if (!Configure(lSettings))
+	{
+		Close();
+		return;
+	}
+}
+
+Port::~Port()
+{
+	if (mReadDescriptor >= 0)
+	{
+		tcsetattr(mReadDescriptor, TCSANOW, &mSavedAttributes);
+	}
+
+	Close();
+}
+
+bool Port::Configure(const Settings &lSettings)
+{
+	speed_t lSpeed = B0;
+	for (const BaudRate &lBaudRate : sBaudRates)
+	{
+		if (lBaudRate.mRate == lSettings.mBaudRate)
+		{
+			lSpeed = lBaudRate.mSpeed;
+			break;
+		}
+	}
+
+	if (lSpeed == B0)
+	{
+		fprintf(stderr, "unsupported serial baud rate %u\n", lSettings.mBaudRate);
+		return false;
+	}
+
+	struct termios lAttributes = mSavedAttributes;
+	cfmakeraw(&lAttributes);
+	lAttributes.c_cflag |= CLOCAL | CREAD;
+	lAttributes.c_cflag &= ~CRTSCTS;
+	lAttributes.c_iflag &= ~(IXON | IXOFF | IXANY);
+
+	switch (lSettings.mFlowControl)
+	{
+		case FLOW_XON_XOFF:
+			lAttributes.c_iflag |= IXON | IXOFF;
+			lAttributes.c_cc[VSTART] = 0x11;
+			lAttributes.c_cc[VSTOP] = 0x13;
+		break;
+
+		case FLOW_RTS_CTS:
+			lAttributes.c_cflag |= CRTSCTS;
+		break;
+
+		case FLOW_NONE:
+		default:
+		break;
+	}
+
+	lAttributes.c_cc[VMIN] = lSettings.mReadMinimum;
+	lAttributes.c_cc[VTIME] = lSettings.mReadTimeout;
+
+	if (cfsetispeed(&lAttributes, lSpeed) || cfsetospeed(&lAttributes, lSpeed))
+	{
+		perror("cfsetspeed");
+		return false;
+	}
+
+	if (tcsetattr(mReadDescriptor, TCSANOW, &lAttributes))
+	{
+		perror("tcsetattr");
+		return false;
+	}
+
+	tcflush(mReadDescriptor, TCIOFLUSH);
+
+	return true;
+}
+
+void Port::Close(void)
+{
+	if (mReadDescriptor >= 0)
+	{
+		close(mReadDescriptor);
+		mReadDescriptor = -1;
+	}
+
+	if (mWriteDescriptor >= 0)
+	{
+		close(mWriteDescriptor);
+		mWriteDescriptor = -1;
+	}
+}
+
+void Port::Poll(void)
+{
+	struct pollfd lPollFds[3] = {
+		{ mReadDescriptor, static_cast<short>(HasBacklog() ? 0 : POLLIN), 0 },
+		{ mWriteDescriptor, static_cast<short>(HasOutput() ? POLLOUT : 0), 0 },
+		{ GetEventDescriptor(), POLLIN, 0 },
+	};
+
+	int lReady = poll(lPollFds, 3, HasBacklog() ? BACKLOG_RETRY_MS : POLL_TIMEOUT_MS);
+	if (lReady < 0)
+	{
+		if (errno != EINTR)
+		{
+			perror("serial poll");
+		}
+		return;
+	}
+
+	if (lPollFds[2].revents & POLLIN)
+	{
+		Collect();
+	}
+
+	if (lPollFds[0].revents & POLLIN)
+	{
+		ssize_t lBytesRead = Receive(READ_CHUNK_SIZE);
+		if (lBytesRead < 0 && errno != EINTR && errno != EAGAIN)
+		{
+			perror("serial read");
+		}
+	}
+	else if (lPollFds[0].revents & (POLLHUP | POLLERR))
+	{
+		// Nobody on the other end (pty master closed, USB host detached); wait for a peer
+		usleep(POLL_TIMEOUT_MS * 1000);
+	}
+
+	SubmitBacklog();
+
+	if (HasOutput() && Drain())
+	{
+		perror("serial write");
+		DiscardOutput();
+	}
+}
+
+ssize_t Port::Read(void *lBuffer, size_t lLength)
+{
+	return read(mReadDescriptor, lBuffer, lLength);
+}
+
+ssize_t Port::Write(const struct iovec *lVector, int lCount)
+{
+	return writev(mWriteDescriptor, lVector, lCount);
+}
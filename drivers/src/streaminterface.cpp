@@ -0,0 +1,240 @@
+/*
+ * streaminterface.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "scriptprocessor.hpp"
+#include "streaminterface.hpp"
+
+StreamInterface::StreamInterface(const char *lName, const char *lInputTerminators, const char *lOutputTerminator,
+								 size_t lMaxMessageLength)
+: CommandInterface(64, lName)
+, mName{lName}
+, mInputTerminators{lInputTerminators}
+, mOutputTerminator{lOutputTerminator}
+, mMaxMessageLength{lMaxMessageLength}
+, mOutputOffset{0}
+{
+	mEventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (mEventDescriptor < 0)
+	{
+		perror((mName + " eventfd").c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	SetNotifyDescriptor(mEventDescriptor);
+
+	// Over its admission limits a stream holds messages back and stops reading
+	AdmissionLimits lLimits = GetAdmissionLimits();
+	lLimits.mFlowControlled = true;
+	SetAdmissionLimits(lLimits);
+}
+
+StreamInterface::~StreamInterface()
+{
+	Shutdown();
+	SetNotifyDescriptor(-1);
+
+	DiscardOutput();
+	close(mEventDescriptor);
+}
+
+ssize_t StreamInterface::Receive(size_t lChunkSize)
+{
+	size_t lOffset = mReceiveBuffer.size();
+
+	mReceiveBuffer.resize(lOffset + lChunkSize);
+	ssize_t lBytesRead = Read(&mReceiveBuffer[lOffset], lChunkSize);
+	if (lBytesRead <= 0)
+	{
+		mReceiveBuffer.resize(lOffset);
+		return lBytesRead;
+	}
+
+	mReceiveBuffer.resize(lOffset + lBytesRead);
+	Split();
+
+	return lBytesRead;
+}
+
+/*
+ * Hand every complete program message in the receive buffer to the script
+ * processor. Terminators inside arbitrary block data do not end a message.
+ */
+void StreamInterface::Split(void)
+{
+	size_t lStart = 0;
+	size_t lLength;
+
+	while ((lLength = mScanner.FindEnd(mReceiveBuffer.data() + lStart, mReceiveBuffer.size() - lStart, mInputTerminators)) != string::npos)
+	{
+		if (lLength)
+		{
+			const char *lMessage = mReceiveBuffer.data() + lStart;
+			if (HasBacklog() || !Submit(lMessage, lLength))
+			{
+				mInput.emplace_back(lMessage, lLength);
+			}
+		}
+		lStart += lLength + 1;
+		mScanner.Reset();
+	}
+
+	mReceiveBuffer.erase(0, lStart);
+
+	if (mReceiveBuffer.size() > mMaxMessageLength)
+	{
+		fprintf(stderr, "%s: discarding unterminated message of %zu bytes\n", mName.c_str(), mReceiveBuffer.size());
+		mReceiveBuffer.clear();
+		mScanner.Reset();
+	}
+}
+
+bool StreamInterface::Submit(const char *lData, size_t lLength)
+{
+	CommandMessage *lMessage = BuildMessage(lData, lLength, gScriptProcessor);
+	if (Send(lMessage))
+	{
+		delete lMessage;
+		return false;
+	}
+
+	return true;
+}
+
+void StreamInterface::SubmitBacklog(void)
+{
+	while (!mInput.empty())
+	{
+		const string &lMessage = mInput.front();
+		if (!Submit(lMessage.data(), lMessage.length()))
+		{
+			break;
+		}
+		mInput.pop_front();
+	}
+}
+
+void StreamInterface::Collect(void)
+{
+	uint64_t lCount;
+	if (read(mEventDescriptor, &lCount, sizeof(lCount)) < 0 && errno != EAGAIN)
+	{
+		perror((mName + " eventfd read").c_str());
+	}
+
+	CommandMessage *lMessage;
+	while ((lMessage = TryReceive()))
+	{
+		mOutput.push_back(lMessage);
+	}
+}
+
+void StreamInterface::DiscardOutput(void)
+{
+	for (CommandMessage *lPending : mOutput)
+	{
+		delete lPending;
+	}
+	mOutput.clear();
+	mOutputOffset = 0;
+}
+
+bool StreamInterface::IsTerminated(const CommandMessage *lMessage) const
+{
+	size_t lLength = lMessage->GetLength();
+	size_t lTerminatorLength = mOutputTerminator.length();
+
+	return lLength >= lTerminatorLength &&
+		   !memcmp(lMessage->GetData() + lLength - lTerminatorLength, mOutputTerminator.data(), lTerminatorLength);
+}
+
+/*
+ * Write as much of the output queue as the stream will take without
+ * blocking. Whatever is left is picked up again once poll() reports POLLOUT.
+ */
+int StreamInterface::Drain(void)
+{
+	struct iovec lVector[STREAM_MAX_IOVECS];
+	const char *lTerminator = mOutputTerminator.data();
+	size_t lTerminatorLength = mOutputTerminator.length();
+
+	while (HasOutput())
+	{
+		int lCount = 0;
+		size_t lOffset = mOutputOffset;
+
+		for (auto lIterator = mOutput.begin();
+			 lIterator != mOutput.end() && lCount + 2 <= static_cast<int>(STREAM_MAX_IOVECS);
+			 ++lIterator)
+		{
+			const char *lData = (*lIterator)->GetData();
+			size_t lLength = (*lIterator)->GetLength();
+
+			if (lOffset < lLength)
+			{
+				lVector[lCount].iov_base = const_cast<char *>(lData + lOffset);
+				lVector[lCount].iov_len = lLength - lOffset;
+				lCount++;
+				lOffset = 0;
+			}
+			else
+			{
+				lOffset -= lLength;
+			}
+
+			if (!IsTerminated(*lIterator))
+			{
+				lVector[lCount].iov_base = const_cast<char *>(lTerminator + lOffset);
+				lVector[lCount].iov_len = lTerminatorLength - lOffset;
+				lCount++;
+			}
+			lOffset = 0;
+		}
+
+		ssize_t lWritten = Write(lVector, lCount);
+		if (lWritten < 0)
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+		}
+
+		/*
+		 * Retire every response that was written completely and remember how far
+		 * into the next one the stream got.
+		 */
+		size_t lRemaining = mOutputOffset + lWritten;
+		while (HasOutput())
+		{
+			CommandMessage *lMessage = mOutput.front();
+			size_t lTotal = lMessage->GetLength() + (IsTerminated(lMessage) ? 0 : lTerminatorLength);
+
+			if (lRemaining < lTotal)
+			{
+				break;
+			}
+
+			lRemaining -= lTotal;
+			mOutput.pop_front();
+			delete lMessage;
+		}
+		mOutputOffset = lRemaining;
+
+		if (lRemaining)
+		{
+			// Short write, the stream is full
+			return 0;
+		}
+	}
+
+	return 0;
+}
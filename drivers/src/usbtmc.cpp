@@ -23,7 +23,7 @@
 using namespace std;
 
 UsbTmc::UsbTmc(void)
-: CommandInterface(64)
+: CommandInterface(64, "usbtmc")
 , mBulkXferIndex(0)
 , mHeader({0})
 {
@@ -90,6 +90,10 @@ string UsbTmc::ServiceBulkOut(gadget_tmc_header *lHeader)
 		mBulkXferIndex = (++mBulkXferIndex == 16) ? 0 : mBulkXferIndex;
 	} while(lBytesRemaining);
 
+	// Drop the alignment padding; block data may legitimately end in NUL bytes
+	if(lDataString.length() > lHeader->TransferSize)
+		lDataString.resize(lHeader->TransferSize);
+
 	return lDataString;
 }
 
@@ -14,8 +14,12 @@
 #include <ctime>
 
 #include "endpoint.hpp"
+#include "hislip.hpp"
+#include "localsocket.hpp"
 #include "osalthread.hpp"
+#include "scpisocket.hpp"
 #include "scriptprocessor.hpp"
+#include "serial.hpp"
 #include "usbtmc.hpp"
 
 #ifdef BUILD_WITH_DISPLAY
@@ -24,10 +28,15 @@
 
 OsalThread *gScriptProcessorThread;
 OsalThread *gUsbTmcThread;
+OsalThread *gHiSlipThread;
+OsalThread *gScpiSocketThread;
+OsalThread *gSerialThread;
+OsalThread *gLocalSocketThread;
 #ifdef BUILD_WITH_DISPLAY
 AardvarkDisplay *gDisplay;
 #endif
 std::atomic<bool> gStop{false};
+static std::chrono::steady_clock::time_point sProcessStart;
 
 #ifdef DAEMONIZE
 static int InitDaemon(void);
@@ -39,11 +48,17 @@ static void DeleteThreads(void);
 static void SignalHandler(int lSignal);
 static void *ScriptProcessorThreadFxn(void *lArg);
 static void *UsbTmcThreadFxn(void *lArg);
+static void *HiSlipThreadFxn(void *lArg);
+static void *ScpiSocketThreadFxn(void *lArg);
+static void *SerialThreadFxn(void *lArg);
+static void *LocalSocketThreadFxn(void *lArg);
 
 using namespace std;
 
 int main(int argc, char *argv[])
 {
+	sProcessStart = chrono::steady_clock::now();
+
 	signal(SIGINT, SignalHandler);
 	signal(SIGTERM, SignalHandler);
 	signal(SIGUSR1, SignalHandler);
@@ -124,24 +139,40 @@ static void CreateThreads(void)
 {
 	gScriptProcessorThread = new OsalThread(10, 1024, ScriptProcessorThreadFxn, static_cast<void *>(nullptr));
 	gUsbTmcThread = new OsalThread(8, 1024, UsbTmcThreadFxn, static_cast<void *>(nullptr));
+	gHiSlipThread = new OsalThread(8, 1024, HiSlipThreadFxn, static_cast<void *>(nullptr));
+	gScpiSocketThread = new OsalThread(8, 1024, ScpiSocketThreadFxn, static_cast<void *>(nullptr));
+	gSerialThread = new OsalThread(8, 1024, SerialThreadFxn, static_cast<void *>(nullptr));
+	gLocalSocketThread = new OsalThread(8, 1024, LocalSocketThreadFxn, static_cast<void *>(nullptr));
 }
 
 static void JoinThreads(void)
 {
 	gScriptProcessorThread->Join(nullptr);
 	gUsbTmcThread->Join(nullptr);
+	gHiSlipThread->Join(nullptr);
+	gScpiSocketThread->Join(nullptr);
+	gSerialThread->Join(nullptr);
+	gLocalSocketThread->Join(nullptr);
 }
 
 static void DetachThreads(void)
 {
 	gScriptProcessorThread->Detach();
 	gUsbTmcThread->Detach();
+	gHiSlipThread->Detach();
+	gScpiSocketThread->Detach();
+	gSerialThread->Detach();
+	gLocalSocketThread->Detach();
 }
 
 static void DeleteThreads(void)
 {
 	delete gScriptProcessorThread;
 	delete gUsbTmcThread;
+	delete gHiSlipThread;
+	delete gScpiSocketThread;
+	delete gSerialThread;
+	delete gLocalSocketThread;
 }
 
 static void *ScriptProcessorThreadFxn(void *lArg)
@@ -152,25 +183,19 @@ static void *ScriptProcessorThreadFxn(void *lArg)
 	}
 
 	OsalThread *lThisThread = reinterpret_cast<OsalThread *>(lArg);
+
+	gScriptProcessor->Autorun();
+	gScriptProcessor->Ready(sProcessStart);
+
 	while (!gStop)
 	{
 		CommandMessage *lMessage = gScriptProcessor->Receive();
 		if (lMessage)
 		{
-			gScriptProcessor->HandleCommand(lMessage->GetData(), lMessage->GetLength());
-	
-			if (gScriptProcessor->GetCount() > 0)
-			{
-				CommandMessage *lReplyMessage = gScriptProcessor->BuildMessage(gScriptProcessor->GetData(),
-																			   gScriptProcessor->GetCount(),
-																			   reinterpret_cast<Endpoint *>(lMessage->GetOrigin()));
-				gScriptProcessor->Send(lReplyMessage);
-	
-				gScriptProcessor->ClearData();
-			}
-	
-			delete lMessage;
+			gScriptProcessor->Process(lMessage);
 		}
+
+		gScriptProcessor->ResumeSuspended();
 	}
 
 	return nullptr;
@@ -201,7 +226,10 @@ static void *UsbTmcThreadFxn(void *lArg)
 						{
 							string lData = lUsbTmc.ServiceBulkOut(&lHeader);
 							CommandMessage *lDataMessage = lUsbTmc.BuildMessage(lData, gScriptProcessor);
-							lUsbTmc.Send(lDataMessage);
+							if (lUsbTmc.Send(lDataMessage))
+							{
+								delete lDataMessage;
+							}
 							break;
 						}
 						case GADGET_TMC_REQUEST_DEV_DEP_MSG_IN:
@@ -210,7 +238,7 @@ static void *UsbTmcThreadFxn(void *lArg)
 							CommandMessage *lMessage = lUsbTmc.Receive();
 							if (lMessage)
 							{
-								lUsbTmc.ServiceBulkIn(&lHeader, lMessage->GetData());
+								lUsbTmc.ServiceBulkIn(&lHeader, string(lMessage->GetData(), lMessage->GetLength()));
 								delete lMessage;
 							}
 							break;
@@ -226,6 +254,75 @@ static void *UsbTmcThreadFxn(void *lArg)
 	return nullptr;
 }
 
+static void *HiSlipThreadFxn(void *lArg)
+{
+	if (!lArg)
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	HiSlip::Server lHiSlipServer(HiSlip::PORT);
+	while (!gStop)
+	{
+		lHiSlipServer.Poll();
+	}
+
+	return nullptr;
+}
+
+static void *ScpiSocketThreadFxn(void *lArg)
+{
+	if (!lArg)
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	ScpiSocket::Server lScpiSocketServer(ScpiSocket::PORT);
+	while (!gStop)
+	{
+		lScpiSocketServer.Poll();
+	}
+
+	return nullptr;
+}
+
+static void *SerialThreadFxn(void *lArg)
+{
+	if (!lArg)
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	Serial::Port lSerialPort(Serial::DEFAULT_DEVICE_PATH);
+	if (!lSerialPort.IsOpen())
+	{
+		return nullptr;
+	}
+
+	while (!gStop)
+	{
+		lSerialPort.Poll();
+	}
+
+	return nullptr;
+}
+
+static void *LocalSocketThreadFxn(void *lArg)
+{
+	if (!lArg)
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	LocalSocket::Server lLocalSocketServer(LocalSocket::DEFAULT_SOCKET_PATH);
+	while (!gStop)
+	{
+		lLocalSocketServer.Poll();
+	}
+
+	return nullptr;
+}
+
 void SignalHandler(int lSignal)
 {
 	switch (lSignal)
@@ -235,6 +332,10 @@ void SignalHandler(int lSignal)
 			gStop = true;
 			gScriptProcessorThread->Cancel();
 			gUsbTmcThread->Cancel();
+			gHiSlipThread->Cancel();
+			gScpiSocketThread->Cancel();
+			gSerialThread->Cancel();
+			gLocalSocketThread->Cancel();
 		break;
 
 		case SIGUSR1:
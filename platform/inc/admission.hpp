@@ -0,0 +1,77 @@
+/*
+ * admission.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_ADMISSION_HPP_
+#define AARDVARK_PLATFORM_INC_ADMISSION_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "lua.hpp"
+#include "session.hpp"
+
+class ScriptProcessor;
+
+/*
+ * What the 'admission' table is bound to: the admission limits and counters
+ * of whichever session is running the current command. Setters return what
+ * is wrong with the value, or nullptr.
+ */
+class AdmissionTable
+{
+public:
+	explicit AdmissionTable(ScriptProcessor *lScriptProcessor);
+
+	size_t GetMaxCommands(void) const;
+	const char *SetMaxCommands(size_t lCommands);
+	size_t GetMaxBytes(void) const;
+	const char *SetMaxBytes(size_t lBytes);
+	double GetRate(void) const;
+	const char *SetRate(double lRate);
+	double GetBurst(void) const;
+	const char *SetBurst(double lBurst);
+	bool IsHighPriority(void) const;
+	void SetHighPriority(bool lHighPriority);
+
+	uint64_t GetAccepted(void) const;
+	uint64_t GetDeferred(void) const;
+	uint64_t GetRejected(void) const;
+	uint64_t GetQueueFull(void) const;
+	uint64_t GetBytesFull(void) const;
+	uint64_t GetRateLimited(void) const;
+	uint64_t GetReserveFull(void) const;
+
+private:
+	ScriptProcessor *mScriptProcessor;
+
+	AdmissionLimits GetLimits(void) const;
+	void SetLimits(const AdmissionLimits &lLimits);
+	AdmissionCounters GetCounters(void) const;
+};
+
+/*
+ * The 'admission' table: admission limits (see AdmissionLimits) and counters
+ * of the session running the current command.
+ *
+ *		admission.maxcommands	program messages the session may have queued
+ *		admission.maxbytes		bytes the session may have queued
+ *		admission.rate			program messages per second, 0 for no limit
+ *		admission.burst			program messages admitted at once under rate
+ *		admission.priority		whether the session may use the reserved part
+ *								of the shared queue
+ *
+ *		admission.accepted		program messages queued
+ *		admission.deferred		handed back to a flow controlled transport
+ *		admission.rejected		discarded with -350
+ *		admission.queuefull		deferred or rejected because of maxcommands,
+ *		admission.bytesfull		maxbytes,
+ *		admission.ratelimited	rate,
+ *		admission.reservefull	or a full shared queue
+ */
+void AdmissionInstall(lua_State *lState, ScriptProcessor *lScriptProcessor);
+
+#endif /* AARDVARK_PLATFORM_INC_ADMISSION_HPP_ */
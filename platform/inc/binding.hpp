@@ -0,0 +1,296 @@
+/*
+ * binding.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_BINDING_HPP_
+#define AARDVARK_PLATFORM_INC_BINDING_HPP_
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "lua.hpp"
+#include "rot.hpp"
+
+using namespace std;
+
+/*
+ * Typed bindings for device objects
+ *
+ * A C++ class's Lua properties and methods are declared once, at compile
+ * time, and become a read-only object (see rot.hpp) whose getters, setters
+ * and methods are thunks generated for each member function. A thunk converts
+ * between Lua and the member's own parameter and return types and calls it
+ * directly; there is no function id to switch on.
+ *
+ *		static constexpr auto sLedBinding = Bind<Led>()
+ *			.Property<&Led::IsOn, &Led::Set>("state")
+ *			.Method<&Led::Toggle>("toggle");
+ *
+ *		PushBound<sLedBinding>(lLua, &gLed);
+ *
+ * A property without a setter cannot be assigned. Methods are called without
+ * self, like the closures of MakeTableReadOnly() tables: led.toggle().
+ * Values may be bool, integers, enums, floating point, const char * or
+ * string. A value of the wrong type, or an integer the member's type cannot
+ * hold, raises an error.
+ *
+ * A member whose first parameter is Lua & is passed the calling state ahead
+ * of the converted values. A setter that returns const char * checks the
+ * value itself: anything but nullptr is raised as the error for that value.
+ */
+
+struct BindMethod
+{
+	const char *mName;
+	lua_CFunction mFunc;
+};
+
+namespace BindDetail
+{
+	// The values a member takes from Lua: its parameters less a leading Lua &
+	template <typename P>
+	struct Values
+	{
+		using Type = P;
+		static constexpr bool TAKES_LUA = false;
+	};
+
+	template <typename... A>
+	struct Values<tuple<Lua, A...>>
+	{
+		using Type = tuple<A...>;
+		static constexpr bool TAKES_LUA = true;
+	};
+
+	template <typename M> struct Member;
+
+	template <typename C, typename R, typename... A>
+	struct Member<R (C::*)(A...)>
+	{
+		using Class = C;
+		using Result = R;
+		using Arguments = typename Values<tuple<remove_cvref_t<A>...>>::Type;
+		static constexpr bool TAKES_LUA = Values<tuple<remove_cvref_t<A>...>>::TAKES_LUA;
+	};
+
+	template <typename C, typename R, typename... A>
+	struct Member<R (C::*)(A...) const> : Member<R (C::*)(A...)> { };
+
+	inline void Push(Lua &lLua, bool lValue) { lLua.PushBoolean(lValue); }
+	inline void Push(Lua &lLua, const char *lValue) { lLua.PushString(lValue); }
+	inline void Push(Lua &lLua, const string &lValue) { lLua.PushLString(lValue.data(), lValue.size()); }
+
+	template <typename V> requires is_integral_v<V> || is_enum_v<V>
+	inline void Push(Lua &lLua, V lValue) { lLua.PushInteger(static_cast<lua_Integer>(lValue)); }
+
+	template <typename V> requires is_floating_point_v<V>
+	inline void Push(Lua &lLua, V lValue) { lLua.PushNumber(static_cast<lua_Number>(lValue)); }
+
+	template <typename V>
+	inline V Check(Lua &lLua, int lIndex)
+	{
+		if constexpr (is_same_v<V, bool>)
+		{
+			lLua.CheckType(lIndex, LUA_TBOOLEAN);
+			return lLua.ToBoolean(lIndex);
+		}
+		else if constexpr (is_integral_v<V>)
+		{
+			lua_Integer lValue = lLua.CheckInteger(lIndex);
+			lLua.ArgCheck(in_range<V>(lValue), lIndex, is_unsigned_v<V> && lValue < 0 ? "must not be negative" : "out of range");
+			return static_cast<V>(lValue);
+		}
+		else if constexpr (is_enum_v<V>)
+		{
+			return static_cast<V>(lLua.CheckInteger(lIndex));
+		}
+		else if constexpr (is_floating_point_v<V>)
+		{
+			return static_cast<V>(lLua.CheckNumber(lIndex));
+		}
+		else if constexpr (is_same_v<V, const char *>)
+		{
+			return lLua.CheckString(lIndex);
+		}
+		else
+		{
+			static_assert(is_same_v<V, string>, "no Lua conversion for this type");
+
+			size_t lLength;
+			const char *lText = lLua.CheckLString(lIndex, &lLength);
+			return string(lText, lLength);
+		}
+	}
+
+	template <typename T, auto F, typename... V>
+	decltype(auto) Apply(Lua &lLua, T *lObject, V &&...lValues)
+	{
+		if constexpr (Member<decltype(F)>::TAKES_LUA)
+		{
+			return (lObject->*F)(lLua, forward<V>(lValues)...);
+		}
+		else
+		{
+			return (lObject->*F)(forward<V>(lValues)...);
+		}
+	}
+
+	template <typename T, auto Get>
+	int Getter(Lua &lLua, void *lObject)
+	{
+		Push(lLua, Apply<T, Get>(lLua, static_cast<T *>(lObject)));
+		return 1;
+	}
+
+	template <typename T, auto Set>
+	void Setter(Lua &lLua, void *lObject, int lValue)
+	{
+		using Value = tuple_element_t<0, typename Member<decltype(Set)>::Arguments>;
+
+		if constexpr (is_same_v<typename Member<decltype(Set)>::Result, const char *>)
+		{
+			const char *lError = Apply<T, Set>(lLua, static_cast<T *>(lObject), Check<Value>(lLua, lValue));
+			if (lError)
+			{
+				lLua.ArgError(lValue, lError);
+			}
+		}
+		else
+		{
+			Apply<T, Set>(lLua, static_cast<T *>(lObject), Check<Value>(lLua, lValue));
+		}
+	}
+
+	template <typename T, auto Call, typename... A, size_t... I>
+	int Invoke(Lua &lLua, T *lObject, tuple<A...> *, index_sequence<I...>)
+	{
+		if constexpr (is_void_v<typename Member<decltype(Call)>::Result>)
+		{
+			Apply<T, Call>(lLua, lObject, Check<A>(lLua, I + 1)...);
+			return 0;
+		}
+		else
+		{
+			Push(lLua, Apply<T, Call>(lLua, lObject, Check<A>(lLua, I + 1)...));
+			return 1;
+		}
+	}
+
+	template <typename T, auto Call>
+	int Method(lua_State *lState)
+	{
+		using Arguments = typename Member<decltype(Call)>::Arguments;
+
+		Lua lLua(lState);
+
+		T *lObject = static_cast<T *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+		return Invoke<T, Call>(lLua, lObject, static_cast<Arguments *>(nullptr),
+							   make_index_sequence<tuple_size_v<Arguments>>());
+	}
+}
+
+/*
+ * Built up one Property() or Method() at a time, each returning a bigger
+ * Binding. The members are public so a Binding can be a constant.
+ */
+template <typename T, size_t P = 0, size_t M = 0>
+struct Binding
+{
+	using Class = T;
+
+	array<RotProperty, P> mProperties;
+	array<BindMethod, M> mMethods;
+
+	template <auto Get, auto Set = nullptr>
+	constexpr Binding<T, P + 1, M> Property(const char *lName) const
+	{
+		using Getter = BindDetail::Member<decltype(Get)>;
+
+		static_assert(is_same_v<typename Getter::Class, T>, "getter is not a member of the bound class");
+		static_assert(tuple_size_v<typename Getter::Arguments> == 0, "a getter takes no arguments");
+
+		Binding<T, P + 1, M> lNext{};
+		for (size_t lIndex = 0; lIndex < P; lIndex++)
+		{
+			lNext.mProperties[lIndex] = mProperties[lIndex];
+		}
+		lNext.mMethods = mMethods;
+
+		if constexpr (is_null_pointer_v<decltype(Set)>)
+		{
+			lNext.mProperties[P] = RotProperty{ lName, BindDetail::Getter<T, Get>, nullptr };
+		}
+		else
+		{
+			using Setter = BindDetail::Member<decltype(Set)>;
+
+			static_assert(is_same_v<typename Setter::Class, T>, "setter is not a member of the bound class");
+			static_assert(tuple_size_v<typename Setter::Arguments> == 1, "a setter takes one argument");
+
+			lNext.mProperties[P] = RotProperty{ lName, BindDetail::Getter<T, Get>, BindDetail::Setter<T, Set> };
+		}
+
+		return lNext;
+	}
+
+	template <auto Call>
+	constexpr Binding<T, P, M + 1> Method(const char *lName) const
+	{
+		static_assert(is_same_v<typename BindDetail::Member<decltype(Call)>::Class, T>,
+					  "method is not a member of the bound class");
+
+		Binding<T, P, M + 1> lNext{};
+		lNext.mProperties = mProperties;
+		for (size_t lIndex = 0; lIndex < M; lIndex++)
+		{
+			lNext.mMethods[lIndex] = mMethods[lIndex];
+		}
+		lNext.mMethods[M] = BindMethod{ lName, BindDetail::Method<T, Call> };
+
+		return lNext;
+	}
+};
+
+template <typename T>
+constexpr Binding<T> Bind(void)
+{
+	return Binding<T>{};
+}
+
+// The perfect hash of a binding's properties, made once per binding
+template <const auto &B>
+inline constexpr RotTable cBoundTable{B.mProperties};
+
+template <const auto &B>
+inline constexpr RotLayout cBoundLayout = cBoundTable<B>.GetLayout();
+
+/*
+ * Pushes a read-only object over lObject, described by the binding B.
+ */
+template <const auto &B>
+void PushBound(Lua &lLua, typename remove_cvref_t<decltype(B)>::Class *lObject)
+{
+	if constexpr (B.mProperties.size() == 0)
+	{
+		PushReadOnlyObject(lLua, cRotNoProperties, lObject);
+	}
+	else
+	{
+		PushReadOnlyObject(lLua, cBoundLayout<B>, lObject);
+	}
+
+	for (const BindMethod &lMethod : B.mMethods)
+	{
+		AddReadOnlyMethod(lLua, lMethod.mName, lObject, lMethod.mFunc);
+	}
+}
+
+#endif /* AARDVARK_PLATFORM_INC_BINDING_HPP_ */
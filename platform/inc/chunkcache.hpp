@@ -0,0 +1,88 @@
+/*
+ * chunkcache.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_CHUNKCACHE_HPP_
+#define AARDVARK_PLATFORM_INC_CHUNKCACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "lua.hpp"
+
+using namespace std;
+
+constexpr size_t CHUNK_CACHE_DEFAULT_CAPACITY = 256;
+constexpr size_t CHUNK_CACHE_MAX_TEXT_LENGTH = 4096;	// longer chunks are compiled every time
+
+/*
+ * Compiled Lua chunk cache
+ *
+ * Test executives send the same few hundred command strings over and over.
+ * Load() keeps the function compiled from each command text in the Lua
+ * registry, keyed by a hash of the text, so a repeated command is only parsed
+ * the first time. The least recently used chunk is dropped once the cache
+ * holds mCapacity of them.
+ *
+ * A compiled chunk is bound to the environment it was loaded against, so the
+ * same text loaded for two sessions is two entries, and the whole cache is
+ * dropped whenever the global table is replaced.
+ */
+class ChunkCache
+{
+public:
+	explicit ChunkCache(size_t lCapacity = CHUNK_CACHE_DEFAULT_CAPACITY);
+	ChunkCache(ChunkCache &) = delete;
+	ChunkCache &operator=(ChunkCache &) = delete;
+
+	/*
+	 * Same contract as luaL_loadbuffer(): pushes the compiled chunk and returns
+	 * LUA_OK, or pushes the error message and returns the error code. When
+	 * lEnvironment is a stack index, the table there becomes the chunk's _ENV
+	 * instead of the globals.
+	 */
+	int Load(Lua &lLua, const char *lText, size_t lLength, const char *lName, int lEnvironment = 0);
+	void Invalidate(Lua &lLua);
+	void Invalidate(Lua &lLua, const void *lEnvironment);	// just the chunks bound to one environment
+	void SetCapacity(Lua &lLua, size_t lCapacity);
+
+	inline uint64_t GetHits(void) const { return mHits; }
+	inline uint64_t GetMisses(void) const { return mMisses; }
+	inline uint64_t GetEvictions(void) const { return mEvictions; }
+	inline size_t GetSize(void) const { return mEntries.size(); }
+	inline size_t GetCapacity(void) const { return mCapacity; }
+
+private:
+	struct Entry
+	{
+		uint64_t mHash;
+		const void *mEnvironment;
+		string mText;
+		int mReference;
+	};
+
+	list<Entry> mEntries;							// most recently used first
+	unordered_map<uint64_t, list<Entry>::iterator> mIndex;
+	size_t mCapacity;
+	const void *mGlobals;							// global table the cached chunks were loaded against
+
+	uint64_t mHits;
+	uint64_t mMisses;
+	uint64_t mEvictions;
+
+	static uint64_t Hash(const char *lText, size_t lLength, const void *lEnvironment);
+	static int Compile(Lua &lLua, const char *lText, size_t lLength, const char *lName, int lEnvironment);
+	void Evict(Lua &lLua);
+	void Remove(Lua &lLua, list<Entry>::iterator lEntry);
+	void CheckGlobals(Lua &lLua);
+};
+
+void ChunkCacheInstall(lua_State *lState, ChunkCache *lCache);
+
+#endif /* AARDVARK_PLATFORM_INC_CHUNKCACHE_HPP_ */
@@ -22,6 +22,7 @@ public:
     void Put(CommandMessage *lMessage);
     CommandMessage *Get(void);
     inline bool IsEmpty(void) { return mGetIndex == mPutIndex; }
+    inline bool IsFull(void) { return ((mPutIndex + 1) % mCapacity) == mGetIndex; }
 private:
     size_t mCapacity;
     size_t mGetIndex;
@@ -13,15 +13,30 @@
 #include "commandmessage.hpp"
 #include "circulbarbuffer.hpp"
 #include "endpoint.hpp"
+#include "session.hpp"
 
 class CommandInterface : public Endpoint
 {
 public:
-	CommandInterface(size_t lQueueCapacity);
+	CommandInterface(size_t lQueueCapacity, const char *lName = "", unsigned int lWeight = SESSION_DEFAULT_WEIGHT);
 	~CommandInterface();
 
+	inline ClientSession &GetSession(void) { return mSession; }
+	inline void SetSessionWeight(unsigned int lWeight) { gSessionManager.SetWeight(&mSession, lWeight); }
+	inline AdmissionLimits GetAdmissionLimits(void) { return gSessionManager.GetLimits(&mSession); }
+	inline void SetAdmissionLimits(const AdmissionLimits &lLimits) { gSessionManager.SetLimits(&mSession, lLimits); }
+
+protected:
+	/*
+	 * Unregisters the session and drops the responses already queued. Once it
+	 * returns the script processor sends nothing more to this interface, so a
+	 * derived destructor calls it before it closes its notify descriptor.
+	 */
+	void Shutdown(void);
+
 private:
-	CircularBuffer mQueue;
+	ClientSession mSession;
+	bool mRegistered;
 };
 
 
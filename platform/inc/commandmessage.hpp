@@ -9,6 +9,7 @@
 #define AARDVARK_PLATFORM_INC_COMMANDMESSAGE_HPP_
 
 #include <cstddef>
+#include <cstdint>
 
 class CommandMessage
 {
@@ -22,11 +23,14 @@ public:
 	inline unsigned long GetLength(void) const { return mLength; };
 	inline void *GetOrigin(void) const { return mOrigin; };
 	inline void *GetDestination(void) const { return mDestination; };
+	inline uint64_t GetTag(void) const { return mTag; };	// interface defined, copied from a request to its response
+	inline void SetTag(uint64_t lTag) { mTag = lTag; };
 private:
 	char *mMessage;
 	unsigned long mLength;
 	void *mOrigin;
 	void *mDestination;
+	uint64_t mTag;
 
 	void Swap(CommandMessage& lOther);
 };
@@ -2,6 +2,7 @@
 #ifndef ENDPOINT_HPP_
 #define ENDPOINT_HPP_
 
+#include <atomic>
 #include <cassert>
 #include <string>
 
@@ -16,10 +17,24 @@ class Endpoint
 {
     public:
         Endpoint(void);
-        ~Endpoint();
+        virtual ~Endpoint();
         CommandMessage *Receive(void);
+        CommandMessage *TryReceive(void);
         int Send(CommandMessage *lMessage);
 
+        /*
+         * Queue a message sent to this endpoint. Returns -1 without taking
+         * ownership when it cannot be accepted.
+         */
+        virtual int Deliver(CommandMessage *lMessage);
+
+        /*
+         * Endpoints serviced from a poll() loop can register an eventfd that is
+         * signalled whenever a message is queued for them.
+         */
+        inline void SetNotifyDescriptor(int lFileDescriptor) { mNotifyDescriptor = lFileDescriptor; }
+        inline int GetNotifyDescriptor(void) const { return mNotifyDescriptor; }
+
         inline CommandMessage *BuildMessage(string &lData, void *lDestination) { return BuildMessage(lData.c_str(), lData.length(), lDestination); }
         inline CommandMessage *BuildMessage(const char *lData, size_t lLength, void *lDestination) { return new CommandMessage(lData, lLength, reinterpret_cast<void *>(this), lDestination); }
 
@@ -27,6 +42,7 @@ class Endpoint
         pthread_mutex_t mLock;
         pthread_cond_t mCondition;
         CircularBuffer mMessageQueue;
+        atomic<int> mNotifyDescriptor;		// set by the interface thread, read by senders
 
         inline int Lock(void) { return pthread_mutex_lock(&mLock); }
         inline int Unlock(void) { return pthread_mutex_unlock(&mLock); }
@@ -34,6 +50,7 @@ class Endpoint
         inline int ConditionSignal(void) { return pthread_cond_signal(&mCondition); }
         inline int Wait(void) { int lError{0}; while(mMessageQueue.IsEmpty()) { lError = ConditionWait(); } return lError; }
         inline int Post(void) { int lError = ConditionSignal(); return lError; }
+        void Notify(void);
 };
 
 #endif // ENDPOINT_HPP_
@@ -10,6 +10,7 @@
 
 
 #include <cstdint>
+#include <mutex>
 #include <queue>
 
 #include "lua.hpp"
@@ -46,24 +47,35 @@ private:
 };
 
 
+/*
+ * Errors are pushed from the interface threads as well as the script
+ * processor, so every access goes through mLock.
+ */
 class ErrorController {
 public:
 	ErrorController(void) { }
 
+	static size_t GetMaxQueueLength(void) { return cMaxQueueLength; }
+
 	/*
 	 * Lua bindings
 	 */
 	static int HandleMsg(lua_State *lState);
 	static int FuncNext(lua_State *lState);
 
-	void Push(Error lError) { mQueue.push(lError); }
-	Error Next(void) { return mQueue.front(); }
-	void Pop(void) { mQueue.pop(); }
-	size_t Count(void) { return mQueue.size(); }
-	bool IsEmpty(void) { return mQueue.empty(); }
+	void Push(Error lError);
+	bool Take(Error &lError);
+	void Clear(void);
+	Error Next(void) { std::lock_guard<std::mutex> lGuard(mLock); return mQueue.front(); }
+	void Pop(void) { std::lock_guard<std::mutex> lGuard(mLock); mQueue.pop(); }
+	size_t Count(void) { std::lock_guard<std::mutex> lGuard(mLock); return mQueue.size(); }
+	bool IsEmpty(void) { std::lock_guard<std::mutex> lGuard(mLock); return mQueue.empty(); }
 
 private:
+	static constexpr size_t cMaxQueueLength = 32;
+	std::mutex mLock;
 	std::queue<Error> mQueue;
+	bool mOverflowed = false;
 };
 
 
@@ -84,4 +96,39 @@ constexpr char cSystemGeneralErrorMessage[] = "general error";
 }
 
 
+/*
+ * SCPI standard error numbers (stored without their sign, like the system
+ * errors above)
+ */
+namespace ScpiErrors {
+
+constexpr int32_t DATA_TYPE_ERROR = 104;
+constexpr int32_t PARAMETER_NOT_ALLOWED = 108;
+constexpr int32_t MISSING_PARAMETER = 109;
+constexpr int32_t UNDEFINED_HEADER = 113;
+constexpr int32_t INVALID_STRING_DATA = 151;
+constexpr int32_t INVALID_BLOCK_DATA = 161;
+constexpr int32_t MACRO_ERROR = 180;
+constexpr int32_t INVALID_INSIDE_MACRO_DEFINITION = 183;
+constexpr int32_t MACRO_PARAMETER_ERROR = 184;
+constexpr int32_t DATA_OUT_OF_RANGE = 222;
+constexpr int32_t ILLEGAL_PARAMETER_VALUE = 224;
+constexpr int32_t QUEUE_OVERFLOW = 350;
+
+constexpr char cDataTypeErrorMessage[] = "Data type error";
+constexpr char cParameterNotAllowedMessage[] = "Parameter not allowed";
+constexpr char cMissingParameterMessage[] = "Missing parameter";
+constexpr char cUndefinedHeaderMessage[] = "Undefined header";
+constexpr char cInvalidStringDataMessage[] = "Invalid string data";
+constexpr char cInvalidBlockDataMessage[] = "Invalid block data";
+constexpr char cMacroErrorMessage[] = "Macro error";
+constexpr char cInvalidInsideMacroDefinitionMessage[] = "Invalid inside macro definition";
+constexpr char cMacroParameterErrorMessage[] = "Macro parameter error";
+constexpr char cDataOutOfRangeMessage[] = "Data out of range";
+constexpr char cIllegalParameterValueMessage[] = "Illegal parameter value";
+constexpr char cQueueOverflowMessage[] = "Queue overflow";
+
+}
+
+
 #endif /* PLATFORM_INC_ERRORS_HPP_ */
@@ -0,0 +1,50 @@
+/*
+ * format.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_FORMAT_HPP_
+#define AARDVARK_PLATFORM_INC_FORMAT_HPP_
+
+#include "lua.hpp"
+#include "responsewriter.hpp"
+
+class ScriptProcessor;
+
+/*
+ * What the 'format' table is bound to: the settings of whichever session is
+ * running the current command. Setters return what is wrong with the value,
+ * or nullptr.
+ */
+class FormatTable
+{
+public:
+	explicit FormatTable(ScriptProcessor *lScriptProcessor);
+
+	unsigned int GetAsciiPrecision(void) const;
+	const char *SetAsciiPrecision(unsigned int lPrecision);
+	DataFormat GetDataFormat(void) const;
+	const char *SetDataFormat(DataFormat lFormat);
+	ByteOrder GetByteOrder(void) const;
+	const char *SetByteOrder(ByteOrder lOrder);
+
+private:
+	ScriptProcessor *mScriptProcessor;
+
+	ResponseWriter &GetResponse(void) const;
+};
+
+/*
+ * The 'format' table: response format settings of the session running the
+ * current command.
+ *
+ *		format.asciiprecision	significant digits of printed numbers, 0 for
+ *								the shortest exact representation
+ *		format.data				format.ASCII, format.REAL32 or format.REAL64
+ *		format.byteorder		format.NORMAL (big endian) or format.SWAPPED
+ */
+void FormatInstall(lua_State *lState, ScriptProcessor *lScriptProcessor);
+
+#endif /* AARDVARK_PLATFORM_INC_FORMAT_HPP_ */
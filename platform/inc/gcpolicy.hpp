@@ -0,0 +1,157 @@
+/*
+ * gcpolicy.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_GCPOLICY_HPP_
+#define AARDVARK_PLATFORM_INC_GCPOLICY_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "lua.hpp"
+
+using namespace std;
+
+enum GcMode {
+	GC_MODE_INCREMENTAL = 0,
+	GC_MODE_GENERATIONAL,
+};
+
+// Lua 5.4's own defaults
+constexpr int GC_DEFAULT_PAUSE = 200;			// %
+constexpr int GC_DEFAULT_STEP_MULTIPLIER = 100;
+constexpr int GC_DEFAULT_STEP_SIZE = 13;		// log2 of bytes
+constexpr int GC_DEFAULT_MINOR_MULTIPLIER = 20;	// %
+constexpr int GC_DEFAULT_MAJOR_MULTIPLIER = 100;	// %
+
+constexpr int GC_DEFAULT_IDLE_STEP = 16;		// KiB of work per idle step
+constexpr unsigned int GC_IDLE_MAX_STEPS = 256;	// per idle period
+
+// Upper bounds of the pause histogram buckets; one more bucket takes the rest
+constexpr array<chrono::microseconds, 7> GC_PAUSE_LIMITS = {
+	chrono::microseconds(10),
+	chrono::microseconds(50),
+	chrono::microseconds(100),
+	chrono::microseconds(500),
+	chrono::microseconds(1000),
+	chrono::microseconds(5000),
+	chrono::microseconds(10000),
+};
+constexpr size_t GC_PAUSE_BUCKETS = GC_PAUSE_LIMITS.size() + 1;
+
+/*
+ * Garbage collector policy
+ *
+ * Left alone, Lua collects whenever allocation debt calls for it, which may be
+ * in the middle of a latency critical query. Instead:
+ *
+ *	- the collector runs in the selected mode with the selected parameters
+ *	- Idle() does collection work in explicit steps while no session has
+ *	  input, once per idle period unless the heap has grown since
+ *	- with mBetweenCommands set, the script processor holds automatic
+ *	  collection while scripts run, leaving the work to Idle()
+ *	- a GcCriticalSection holds it for the duration of a timed operation
+ *
+ * Holding collection does not stop the emergency collection Lua does when an
+ * allocation fails, so the heap limit still holds.
+ *
+ * Every explicit step is timed into a pause histogram.
+ */
+class GcPolicy
+{
+public:
+	GcPolicy(void);
+	GcPolicy(GcPolicy &) = delete;
+	GcPolicy &operator=(GcPolicy &) = delete;
+
+	void Apply(Lua &lLua);			// mode and parameters to the collector
+	void Idle(Lua &lLua);
+	bool Step(Lua &lLua);			// true when the step finished a cycle
+	void Hold(Lua &lLua);
+	void Release(Lua &lLua);
+
+	/*
+	 * The setters of collector parameters check the value, returning what is
+	 * wrong with it or nullptr, and hand the new parameters to the collector.
+	 */
+	inline GcMode GetMode(void) const { return mMode; }
+	const char *SetMode(Lua &lLua, GcMode lMode);
+	inline int GetPause(void) const { return mPause; }
+	const char *SetPause(Lua &lLua, int lPause);
+	inline int GetStepMultiplier(void) const { return mStepMultiplier; }
+	const char *SetStepMultiplier(Lua &lLua, int lMultiplier);
+	inline int GetStepSize(void) const { return mStepSize; }
+	const char *SetStepSize(Lua &lLua, int lSize);
+	inline int GetMinorMultiplier(void) const { return mMinorMultiplier; }
+	const char *SetMinorMultiplier(Lua &lLua, int lMultiplier);
+	inline int GetMajorMultiplier(void) const { return mMajorMultiplier; }
+	const char *SetMajorMultiplier(Lua &lLua, int lMultiplier);
+	inline int GetIdleStep(void) const { return mIdleStep; }
+	const char *SetIdleStep(int lStep);
+	inline bool GetBetweenCommands(void) const { return mBetweenCommands; }
+	inline void SetBetweenCommands(bool lBetween) { mBetweenCommands = lBetween; }
+
+	inline uint64_t GetSteps(void) const { return mSteps; }
+	inline uint64_t GetCycles(void) const { return mCycles; }
+	inline const array<uint64_t, GC_PAUSE_BUCKETS> &GetPauses(void) const { return mPauses; }
+
+	static int FuncHistogram(lua_State *lState);
+	static int FuncCritical(lua_State *lState);
+
+private:
+	GcMode mMode;
+	int mPause;
+	int mStepMultiplier;
+	int mStepSize;
+	int mMinorMultiplier;
+	int mMajorMultiplier;
+	int mIdleStep;						// 0 disables idle collection
+	bool mBetweenCommands;
+
+	unsigned int mHoldDepth;
+	int mIdleCount;						// KiB in use after the last idle cycle
+	uint64_t mSteps;
+	uint64_t mCycles;
+	array<uint64_t, GC_PAUSE_BUCKETS> mPauses;
+};
+
+/*
+ * No automatic collection while one of these is in scope. They nest.
+ */
+class GcCriticalSection
+{
+public:
+	GcCriticalSection(GcPolicy &lPolicy, Lua &lLua) : mPolicy{lPolicy}, mLua{lLua} { mPolicy.Hold(mLua); }
+	~GcCriticalSection() { mPolicy.Release(mLua); }
+	GcCriticalSection(GcCriticalSection &) = delete;
+	GcCriticalSection &operator=(GcCriticalSection &) = delete;
+
+private:
+	GcPolicy &mPolicy;
+	Lua &mLua;
+};
+
+/*
+ * The 'collector' table
+ *
+ *		collector.mode				collector.INCREMENTAL or collector.GENERATIONAL
+ *		collector.pause, .stepmul, .stepsize
+ *									incremental mode parameters
+ *		collector.minormul, .majormul
+ *									generational mode parameters
+ *		collector.idlestep			KiB of work per step while idle, 0 for none
+ *		collector.betweencommands	hold automatic collection while scripts run
+ *		collector.steps, .cycles	explicit steps taken and cycles they finished
+ *		collector.histogram()		{ {limit, count}, ... } of step pauses, limits
+ *									in microseconds
+ *		collector.critical(f, ...)	calls f with collection held, returns its
+ *									results
+ */
+void GcPolicyInstall(lua_State *lState, GcPolicy *lPolicy);
+
+#endif /* AARDVARK_PLATFORM_INC_GCPOLICY_HPP_ */
@@ -86,6 +86,7 @@ protected:
 	lua_State *mState = nullptr;
 public:
 	BasicLua(void) : mOwnsState(true) { mState = NewState(); }
+	BasicLua(lua_Alloc lAlloc, void *lUd) : mOwnsState(true) { mState = NewState(lAlloc, lUd); }
 	explicit BasicLua(lua_State *lState) : mOwnsState(false), mState(lState) { }
 	// BasicLua(const BasicLua& lOther) : mOwnsState(false), mState(lOther.mState) { }
 	~BasicLua() { if(mOwnsState) Close(); }
@@ -114,7 +115,10 @@ public:
 	inline void CreateTable(int lNArr, int lNRec) { lua_createtable(mState, lNArr, lNRec); }
 	inline int Dump(lua_Writer lWriter, void *lData, int lStrip) { return lua_dump(mState, lWriter, lData, lStrip); }
 	inline int Error(void) { return lua_error(mState); }
-	// TODO: varags inline int Gc()
+	inline int Gc(int lWhat) { return lua_gc(mState, lWhat); }
+	inline int Gc(int lWhat, int lArg1) { return lua_gc(mState, lWhat, lArg1); }
+	inline int Gc(int lWhat, int lArg1, int lArg2) { return lua_gc(mState, lWhat, lArg1, lArg2); }
+	inline int Gc(int lWhat, int lArg1, int lArg2, int lArg3) { return lua_gc(mState, lWhat, lArg1, lArg2, lArg3); }
 	inline lua_Alloc GetAllcF(void **lUd) { return lua_getallocf(mState, lUd); }
 	inline int GetField(int lIndex, const char *lKey) { return lua_getfield(mState, lIndex, lKey); }
 	inline void *GetExtraSpace(void) { return lua_getextraspace(mState); }
@@ -192,10 +196,10 @@ public:
 	inline int ToBoolean(int lIndex) { return lua_toboolean(mState, lIndex); }
 	inline lua_CFunction ToCFunction(int lIndex) { return lua_tocfunction(mState, lIndex); }
 	inline void ToClose(int lIndex) { lua_toclose(mState, lIndex); }
-	inline int ToInteger(int lIndex) { return lua_tointeger(mState, lIndex); }
+	inline lua_Integer ToInteger(int lIndex) { return lua_tointeger(mState, lIndex); }
 	inline int ToIntegerX(int lIndex, int *lIsNum) { return lua_tointegerx(mState, lIndex, lIsNum); }
 	inline const char *ToLString(int lIndex, size_t *lLen) { return lua_tolstring(mState, lIndex, lLen); }
-	inline int ToNumber(int lIndex) { return lua_tonumber(mState, lIndex); }
+	inline lua_Number ToNumber(int lIndex) { return lua_tonumber(mState, lIndex); }
 	inline int ToNumberX(int lIndex, int *lIsNum) { return lua_tonumberx(mState, lIndex, lIsNum); }
 	inline const void *ToPointer(int lIndex) { return lua_topointer(mState, lIndex); }
 	inline const char *ToString(int lIndex) { return lua_tostring(mState, lIndex); }
@@ -207,6 +211,7 @@ public:
 	inline lua_Number Version(void) { return lua_version(mState); }
 	inline void Warning(const char *lMsg, int lToCont) { lua_warning(mState, lMsg, lToCont); }
 	inline void XMove(lua_State *lFrom, lua_State *lTo, int n) { lua_xmove(lFrom, lTo, n); }
+	inline int Yield(int lNResults) { return lua_yield(mState, lNResults); }
 	inline int YieldK(int lNResults, lua_KContext lCtx, lua_KFunction lKFunc) { return lua_yieldk(mState, lNResults, lCtx, lKFunc); }
 
 	// Debug Interface
@@ -276,6 +281,7 @@ public:
 	inline void PushResult(luaL_Buffer *lBuffer) { luaL_pushresult(lBuffer); }
 	inline void PushResultSize(luaL_Buffer *lBuffer, size_t lSize) { luaL_pushresultsize(lBuffer, lSize); }
 	// TODO: these ones
+	inline int Ref(int t) { return luaL_ref(mState, t); }
 	inline void SetMetaTable(const char *lName) { luaL_setmetatable(mState, lName); }
 	inline void *TestUData(int lArg, const char *lName) { return luaL_testudata(mState, lArg, lName); }
 	inline const char *ToLStringAux(int lIndex, size_t *lLen) { return luaL_tolstring(mState, lIndex, lLen); }
@@ -291,6 +297,7 @@ class Lua : public BasicLua
 {
 public:
 	Lua(void);
+	Lua(lua_Alloc lAlloc, void *lUd);
 	explicit Lua(lua_State *lState) : BasicLua(lState) { }
 	~Lua() { }
 
@@ -301,8 +308,6 @@ public:
 	void AddRotSetter(int lTableIndex) { AddRotMetaObject(lTableIndex, "Setters"); }
 	void AddRotGetter(int lTableIndex) { AddRotMetaObject(lTableIndex, "Getters"); }
 
-	void InstallRotConstructor(void);
-
 	void GetBackdoor(void);
 
 	// DEBUG
@@ -312,6 +317,10 @@ public:
 	void BackdoorInstall(lua_State *lState);
 
 private:
+	void Init(void);
+
+	static int Panic(lua_State *lState);
+	static void Warn(void *lUd, const char *lMessage, int lToCont);
 
 	inline const char *GetPrompt (int firstline) {
 		if (lua_getglobal(mState, firstline ? "_PROMPT" : "_PROMPT2") == LUA_TNIL)
@@ -0,0 +1,141 @@
+/*
+ * luaallocator.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_LUAALLOCATOR_HPP_
+#define AARDVARK_PLATFORM_INC_LUAALLOCATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lua.hpp"
+
+using namespace std;
+
+class ScriptProcessor;
+
+constexpr size_t LUA_HEAP_DEFAULT_LIMIT = 64 * 1024 * 1024;
+constexpr size_t LUA_POOL_GRANULE = 16;					// also the alignment of every pooled block
+constexpr size_t LUA_POOL_MAX_SIZE = 256;				// larger blocks come from malloc()
+constexpr size_t LUA_POOL_CLASS_COUNT = LUA_POOL_MAX_SIZE / LUA_POOL_GRANULE;
+constexpr size_t LUA_POOL_CHUNK_SIZE = 64 * 1024;
+
+/*
+ * What one session's scripts have done to the heap. Frees are charged to
+ * whichever session is running when they happen, which for garbage collected
+ * objects need not be the one that allocated them.
+ */
+struct MemoryAccount
+{
+	uint64_t mAllocated = 0;		// bytes
+	uint64_t mAllocations = 0;
+	uint64_t mFreed = 0;			// bytes
+};
+
+/*
+ * Lua heap
+ *
+ * The lua_Alloc of the script processor's state. Blocks of up to
+ * LUA_POOL_MAX_SIZE bytes (strings, tables, closures, upvalues: nearly
+ * everything Lua allocates) come from per-size-class free lists carved out of
+ * LUA_POOL_CHUNK_SIZE chunks. A freed block goes back on its list for the next
+ * object of that size and chunks are never handed back, so churn no longer
+ * fragments the malloc() heap and the resident size settles instead of
+ * creeping up.
+ *
+ * Growing past mLimit bytes in use fails the allocation, which Lua turns into
+ * an emergency collection and, failing that, a "not enough memory" error in
+ * the script that asked for it. Every session shares the one heap, so the
+ * limit is device-wide; it is set from C++ and scripts can only read it. The
+ * per-session MemoryAccount is bookkeeping, not a limit, since a garbage
+ * collected object is freed by whichever session happens to be running.
+ * Shrinking a block never fails.
+ */
+class LuaAllocator
+{
+public:
+	explicit LuaAllocator(size_t lLimit = LUA_HEAP_DEFAULT_LIMIT);
+	~LuaAllocator();
+	LuaAllocator(LuaAllocator &) = delete;
+	LuaAllocator &operator=(LuaAllocator &) = delete;
+
+	static void *Allocate(void *lUserData, void *lBlock, size_t lOldSize, size_t lNewSize);
+
+	inline size_t GetInUse(void) const { return mInUse; }
+	inline size_t GetPeak(void) const { return mPeak; }
+	inline size_t GetReserved(void) const { return mChunks.size() * LUA_POOL_CHUNK_SIZE; }
+	inline uint64_t GetFailures(void) const { return mFailures; }
+	inline size_t GetLimit(void) const { return mLimit; }
+	inline void SetLimit(size_t lLimit) { mLimit = lLimit; }
+
+	// Account charged from here on; nullptr for none
+	inline void SetAccount(MemoryAccount *lAccount) { mAccount = lAccount; }
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock *mNext;
+	};
+
+	FreeBlock *mFree[LUA_POOL_CLASS_COUNT];
+	vector<void *> mChunks;
+	size_t mLimit;
+	size_t mInUse;
+	size_t mPeak;
+	uint64_t mFailures;
+	MemoryAccount *mAccount;
+
+	static inline bool IsPooled(size_t lSize) { return lSize <= LUA_POOL_MAX_SIZE; }
+	static inline size_t GetClass(size_t lSize) { return (lSize + LUA_POOL_GRANULE - 1) / LUA_POOL_GRANULE - 1; }
+
+	void *Reallocate(void *lBlock, size_t lOldSize, size_t lNewSize);
+	void *New(size_t lSize);
+	void Delete(void *lBlock, size_t lSize);
+	void *Take(size_t lClass);
+	bool Refill(size_t lClass);
+};
+
+extern LuaAllocator gLuaAllocator;
+
+// What the 'memory' table is bound to: the heap, and the account of whichever session is running the current command
+class MemoryTable
+{
+public:
+	explicit MemoryTable(ScriptProcessor *lScriptProcessor);
+
+	inline size_t GetInUse(void) const { return gLuaAllocator.GetInUse(); }
+	inline size_t GetPeak(void) const { return gLuaAllocator.GetPeak(); }
+	inline size_t GetReserved(void) const { return gLuaAllocator.GetReserved(); }
+	inline uint64_t GetFailures(void) const { return gLuaAllocator.GetFailures(); }
+	inline size_t GetLimit(void) const { return gLuaAllocator.GetLimit(); }
+	uint64_t GetAllocated(void) const;
+	uint64_t GetAllocations(void) const;
+	uint64_t GetFreed(void) const;
+
+private:
+	ScriptProcessor *mScriptProcessor;
+
+	const MemoryAccount &GetAccount(void) const;
+};
+
+/*
+ * The 'memory' table: the Lua heap, and what the session running the current
+ * command has allocated from it.
+ *
+ *		memory.inuse		bytes held by live Lua objects
+ *		memory.peak			most bytes ever in use
+ *		memory.reserved		bytes of pool chunks taken from the system
+ *		memory.failures		allocations refused for going over the limit
+ *		memory.limit		cap on memory.inuse for the whole device, 0 for
+ *							none (read-only)
+ *		memory.allocated	bytes allocated by this session's scripts
+ *		memory.allocations	allocations made by this session's scripts
+ *		memory.freed		bytes freed while this session's scripts ran
+ */
+void MemoryInstall(lua_State *lState, ScriptProcessor *lScriptProcessor);
+
+#endif /* AARDVARK_PLATFORM_INC_LUAALLOCATOR_HPP_ */
@@ -0,0 +1,89 @@
+/*
+ * operations.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_OPERATIONS_HPP_
+#define AARDVARK_PLATFORM_INC_OPERATIONS_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "lua.hpp"
+
+using namespace std;
+
+/*
+ * Pending operations (IEEE 488.2 - 12.5)
+ *
+ * Anything that runs on after the command that started it returns (a sweep,
+ * a scan, a script's delay()) is registered here until it is done, either
+ * with an explicit End() or, for a timed operation, when its end time has
+ * passed. The device is complete when nothing is pending:
+ *
+ *		*OPC	sets the OPC bit of the event register once complete
+ *		*OPC?	answers 1 once complete
+ *		*WAI	holds the rest of the program message until complete
+ *
+ * *OPC? and *WAI only hold up the session that sent them. Operations may be
+ * ended from any thread.
+ */
+class OperationTracker
+{
+public:
+	OperationTracker(void);
+	OperationTracker(OperationTracker &) = delete;
+	OperationTracker &operator=(OperationTracker &) = delete;
+
+	uint64_t Begin(const char *lName);
+	uint64_t Begin(const char *lName, chrono::steady_clock::time_point lEnd);
+	uint64_t BeginFor(int64_t lMicroseconds);
+	void End(uint64_t lId);
+
+	bool IsComplete(void);
+	size_t GetPendingCount(void);
+	bool GetNextEnd(chrono::steady_clock::time_point &lEnd);
+	void Poll(void);
+
+	void ArmOpc(void);
+	void DisarmOpc(void);
+
+private:
+	struct Operation
+	{
+		uint64_t mId;
+		string mName;
+		bool mTimed;
+		chrono::steady_clock::time_point mEnd;
+	};
+
+	mutex mLock;
+	vector<Operation> mPending;
+	uint64_t mNextId;
+	bool mOpcArmed;					// *OPC seen, OPC bit not set yet
+
+	uint64_t Add(const char *lName, bool lTimed, chrono::steady_clock::time_point lEnd);
+	void Expire(void);
+	void Completed(void);
+};
+
+extern OperationTracker gOperations;
+
+/*
+ * The 'operations' table
+ *
+ *		operations.pending			number of pending operations
+ *		operations.begin(name)		registers an operation; returns its id
+ *		operations.beginfor(us)		registers one that ends by itself
+ *		operations.finish(id)		ends an operation
+ *		operations.wait()			suspends the script until complete
+ */
+void OperationsInstall(lua_State *lState);
+
+#endif /* AARDVARK_PLATFORM_INC_OPERATIONS_HPP_ */
@@ -0,0 +1,74 @@
+/*
+ * programmessage.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_PROGRAMMESSAGE_HPP_
+#define AARDVARK_PLATFORM_INC_PROGRAMMESSAGE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/*
+ * IEEE 488.2 program message framing
+ *
+ * Arbitrary block program data carries raw bytes, so a terminator character
+ * inside a block does not end the message:
+ *
+ *		#<n><length><length bytes>	definite length; n is the number of length digits
+ *		#0<bytes>NL					indefinite length; ends with the message
+ *
+ * A block only starts where program data can, after the space that follows a
+ * header or after a comma, so a '#' in a Lua line (the length operator) is
+ * left alone.
+ */
+namespace ProgramMessage
+{
+	constexpr size_t MAX_LENGTH_DIGITS = 9;
+
+	enum BlockType {
+		NOT_A_BLOCK = 0,
+		DEFINITE_BLOCK,
+		INDEFINITE_BLOCK,
+		INCOMPLETE_BLOCK,		// the header itself has not all arrived yet
+	};
+
+	/*
+	 * lText starts at a '#'. On a block, lHeaderLength is set to the length of
+	 * the #<n><length> header and, for a definite block, lPayloadLength to the
+	 * number of data bytes that follow it.
+	 */
+	BlockType ParseBlockHeader(string_view lText, size_t &lHeaderLength, size_t &lPayloadLength);
+
+	/*
+	 * Finds the end of a program message in a stream transport's receive
+	 * buffer, stepping over block data. The scan resumes where the previous
+	 * call stopped, so each byte is only looked at once however the message
+	 * arrives; call Reset() once the message has been removed from the buffer.
+	 */
+	class Scanner
+	{
+	public:
+		Scanner(void);
+
+		/*
+		 * lBuffer starts at the beginning of the message. Returns the offset of
+		 * the terminator that ends it, or string::npos when it is not complete.
+		 */
+		size_t FindEnd(const char *lBuffer, size_t lLength, const string &lTerminators);
+		void Reset(void);
+
+	private:
+		size_t mPosition;
+		char mQuote;
+		char mPrevious;			// byte before mPosition, outside block data
+		bool mIndefinite;
+	};
+}
+
+#endif /* AARDVARK_PLATFORM_INC_PROGRAMMESSAGE_HPP_ */
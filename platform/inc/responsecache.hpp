@@ -0,0 +1,90 @@
+/*
+ * responsecache.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_RESPONSECACHE_HPP_
+#define AARDVARK_PLATFORM_INC_RESPONSECACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "lua.hpp"
+
+using namespace std;
+
+constexpr size_t RESPONSE_CACHE_CAPACITY = 64;
+
+// Invalidation keys used by the common commands
+constexpr char RESPONSE_KEY_SETTINGS[] = "settings";	// *RST
+constexpr char RESPONSE_KEY_STATUS[] = "status";		// *CLS
+
+/*
+ * Responses of constant queries
+ *
+ * A query is only cached once it has opted in: a SCPI handler by calling
+ * Scpi::Cacheable() after responding, a Lua query by having its exact text
+ * declared. Its response is stored the first time the script processor runs
+ * it as a transfer of its own, and from then on the interface thread answers
+ * it when the session has nothing queued or running, without going through
+ * the script processor at all.
+ *
+ * A response with an empty key never changes (*IDN?). Any other key names
+ * what it depends on, and Invalidate() of that key drops it until it is run
+ * again. Texts are matched exactly, apart from surrounding whitespace, and a
+ * response that depends on the session's format settings must not opt in.
+ */
+class ResponseCache
+{
+public:
+	ResponseCache(void);
+	ResponseCache(ResponseCache &) = delete;
+	ResponseCache &operator=(ResponseCache &) = delete;
+
+	bool Find(const char *lText, size_t lLength, string &lResponse);
+	void Store(const char *lText, size_t lLength, const string &lResponse, const char *lKey);
+	bool Offer(const char *lText, size_t lLength, const string &lResponse);	// only a declared text
+
+	void Declare(const string &lText, const string &lKey);
+	void Invalidate(const string &lKey);
+	void Clear(void);
+
+	uint64_t GetHits(void);
+	size_t GetSize(void);
+
+private:
+	struct Entry
+	{
+		string mResponse;
+		string mKey;
+	};
+
+	mutex mLock;
+	unordered_map<string, Entry> mEntries;
+	unordered_map<string, string> mDeclared;	// Lua query text to its key
+	uint64_t mHits;
+
+	static string_view Normalize(const char *lText, size_t lLength);
+	void Add(string_view lText, const string &lResponse, string_view lKey);
+};
+
+extern ResponseCache gResponseCache;
+
+/*
+ * The 'responsecache' table
+ *
+ *		responsecache.hits					queries answered from the cache
+ *		responsecache.size					responses held
+ *		responsecache.declare(text, key)	opts a Lua query in; key "" if it never changes
+ *		responsecache.invalidate(key)		drops the responses that depend on key
+ *		responsecache.clear()				drops every response and declaration
+ */
+void ResponseCacheInstall(lua_State *lState);
+
+#endif /* AARDVARK_PLATFORM_INC_RESPONSECACHE_HPP_ */
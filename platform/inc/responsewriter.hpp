@@ -0,0 +1,93 @@
+/*
+ * responsewriter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_RESPONSEWRITER_HPP_
+#define AARDVARK_PLATFORM_INC_RESPONSEWRITER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+constexpr unsigned int ASCII_DEFAULT_PRECISION = 6;
+constexpr unsigned int ASCII_MAX_PRECISION = 17;			// enough to round trip any double
+constexpr size_t RESPONSE_INITIAL_CAPACITY = 1024;
+constexpr size_t RESPONSE_MAX_RETAINED_CAPACITY = 64 * 1024;
+
+enum DataFormat {
+	DATA_ASCII = 0,
+	DATA_REAL32,
+	DATA_REAL64,
+};
+
+enum ByteOrder {
+	BYTE_ORDER_NORMAL = 0,		// big endian, the IEEE 488.2 default
+	BYTE_ORDER_SWAPPED,			// little endian
+};
+
+/*
+ * Response writer
+ *
+ * Builds one session's response in an arena that is reused from message to
+ * message: Clear() keeps the allocation, so once it has grown to the size of
+ * the session's usual responses, formatting them allocates nothing. An
+ * unusually large response does not pin its memory; the arena goes back to
+ * RESPONSE_INITIAL_CAPACITY when it is cleared.
+ *
+ * Numbers are formatted with std::to_chars. Floating point values use the
+ * ascii precision as the number of significant digits in scientific notation
+ * (the same output as "%1.*e" with precision - 1); a precision of 0 selects the
+ * shortest representation that reads back as the same double.
+ *
+ * With a REAL32 or REAL64 data format, numeric data is written as an IEEE
+ * 488.2 definite length arbitrary block (#<n><length><bytes>) of IEEE 754
+ * values in the selected byte order instead.
+ */
+class ResponseWriter
+{
+public:
+	ResponseWriter(void);
+	ResponseWriter(ResponseWriter &) = delete;
+	ResponseWriter &operator=(ResponseWriter &) = delete;
+
+	inline string &GetBuffer(void) { return mBuffer; }
+	inline size_t GetLength(void) const { return mBuffer.length(); }
+	void Clear(void);
+	void Reset(void);				// format settings back to their *RST values
+
+	inline unsigned int GetAsciiPrecision(void) const { return mAsciiPrecision; }
+	bool SetAsciiPrecision(unsigned int lPrecision);
+
+	inline DataFormat GetDataFormat(void) const { return mDataFormat; }
+	inline void SetDataFormat(DataFormat lFormat) { mDataFormat = lFormat; }
+	inline ByteOrder GetByteOrder(void) const { return mByteOrder; }
+	inline void SetByteOrder(ByteOrder lOrder) { mByteOrder = lOrder; }
+	inline bool IsBinary(void) const { return mDataFormat != DATA_ASCII; }
+	inline size_t GetValueSize(void) const { return mDataFormat == DATA_REAL32 ? sizeof(float) : sizeof(double); }
+
+	inline void Write(char lValue) { mBuffer += lValue; }
+	inline void Write(string_view lValue) { mBuffer.append(lValue); }
+	void Write(int64_t lValue);
+	void Write(double lValue);
+
+	// Binary data: a whole block of values, converted and swapped in one pass
+	void WriteBlock(const double *lValues, size_t lCount);
+
+private:
+	string mBuffer;
+	unsigned int mAsciiPrecision;
+	DataFormat mDataFormat;
+	ByteOrder mByteOrder;
+
+	void BeginBlock(size_t lCount);
+	bool NeedsSwap(void) const;
+	void Encode(char *lDestination, const double *lValues, size_t lCount) const;
+};
+
+#endif /* AARDVARK_PLATFORM_INC_RESPONSEWRITER_HPP_ */
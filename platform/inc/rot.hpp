@@ -0,0 +1,238 @@
+/*
+ * rot.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_ROT_HPP_
+#define AARDVARK_PLATFORM_INC_ROT_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "lua.hpp"
+
+constexpr char ROT_METATABLE[] = "ReadOnlyObject";
+
+/*
+ * Native read-only objects
+ *
+ * The device tables scripts poll in tight loops (status, led, information,
+ * errors) are userdata rather than tables run through MakeTableReadOnly().
+ * Their __index and __newindex are C functions that look the key up in a
+ * perfect hash built at compile time from a list of {name, getter, setter},
+ * and call the getter or setter straight away: reading status.event is one
+ * C call, with no Lua closure or upvalue switch in between.
+ *
+ * A getter pushes the value and returns how many it pushed. A setter gets
+ * the stack index of the new value. Either may be nullptr. Methods (keys that
+ * are not properties) live in the object's user value table.
+ */
+typedef int (*RotGetter)(Lua &lLua, void *lObject);
+typedef void (*RotSetter)(Lua &lLua, void *lObject, int lValue);
+
+struct RotProperty
+{
+	const char *mName;
+	RotGetter mGet;
+	RotSetter mSet;
+	size_t mLength = 0;			// of mName, filled in by RotTable
+};
+
+/*
+ * FNV-1a, seeded. The low bits of FNV only depend on the low bits of the seed
+ * and of each byte, and the slot is taken from the low bits, so the result is
+ * mixed down before it is masked; otherwise only a handful of seeds differ.
+ */
+constexpr uint32_t RotHash(const char *lName, size_t lLength, uint32_t lSeed)
+{
+	uint32_t lHash = 2166136261u ^ lSeed;
+	for (size_t lIndex = 0; lIndex < lLength; lIndex++)
+	{
+		lHash ^= static_cast<uint8_t>(lName[lIndex]);
+		lHash *= 16777619u;
+	}
+
+	lHash ^= lHash >> 16;
+	lHash *= 0x7feb352du;
+	lHash ^= lHash >> 15;
+	return lHash;
+}
+
+constexpr size_t RotNameLength(const char *lName)
+{
+	size_t lLength = 0;
+	while (lName[lLength])
+	{
+		lLength++;
+	}
+	return lLength;
+}
+
+constexpr bool RotSameName(const char *lName, const char *lOther)
+{
+	size_t lIndex = 0;
+	while (lName[lIndex] && lName[lIndex] == lOther[lIndex])
+	{
+		lIndex++;
+	}
+	return lName[lIndex] == lOther[lIndex];
+}
+
+constexpr size_t RotSlotCount(size_t lProperties)
+{
+	size_t lSlots = 1;
+	while (lSlots < 2 * lProperties)
+	{
+		lSlots <<= 1;
+	}
+	return lSlots;
+}
+
+// Not constexpr: reaching it while building a RotTable stops the compile
+void RotDuplicateProperty(void);
+
+/*
+ * What the metamethods work from: a view of a RotTable.
+ */
+struct RotLayout
+{
+	const RotProperty *mProperties;
+	const uint8_t *mSlots;			// property index + 1, 0 when empty
+	uint32_t mMask;
+	uint32_t mSeed;
+
+	inline const RotProperty *Find(const char *lName, size_t lLength) const
+	{
+		uint8_t lSlot = mSlots[RotHash(lName, lLength, mSeed) & mMask];
+		if (!lSlot)
+		{
+			return nullptr;
+		}
+
+		// Lua strings may hold a NUL, so the length is compared before the bytes
+		const RotProperty *lProperty = &mProperties[lSlot - 1];
+		if (lProperty->mLength != lLength || memcmp(lProperty->mName, lName, lLength))
+		{
+			return nullptr;
+		}
+		return lProperty;
+	}
+};
+
+/*
+ * Perfect hash over a fixed property list, found at compile time by trying
+ * seeds until every name has a slot to itself:
+ *
+ *		static constexpr RotProperty sProperties[] = { { "state", GetState, SetState } };
+ *		static constexpr RotTable sTable{sProperties};
+ *		static constexpr RotLayout sLayout = sTable.GetLayout();
+ */
+template <size_t N>
+class RotTable
+{
+	static_assert(N > 0 && N < 255, "a RotTable holds 1 to 254 properties");
+
+public:
+	static constexpr size_t SLOTS = RotSlotCount(N);
+
+	consteval RotTable(const RotProperty (&lProperties)[N])
+	: mProperties{}
+	, mSlots{}
+	, mSeed{0}
+	{
+		Build(lProperties);
+	}
+
+	consteval RotTable(const std::array<RotProperty, N> &lProperties)
+	: mProperties{}
+	, mSlots{}
+	, mSeed{0}
+	{
+		Build(lProperties.data());
+	}
+
+	constexpr RotLayout GetLayout(void) const
+	{
+		return RotLayout{ mProperties, mSlots, static_cast<uint32_t>(SLOTS - 1), mSeed };
+	}
+
+private:
+	RotProperty mProperties[N];
+	uint8_t mSlots[SLOTS];
+	uint32_t mSeed;
+
+	consteval void Build(const RotProperty *lProperties)
+	{
+		for (size_t lIndex = 0; lIndex < N; lIndex++)
+		{
+			mProperties[lIndex] = lProperties[lIndex];
+			mProperties[lIndex].mLength = RotNameLength(mProperties[lIndex].mName);
+			for (size_t lOther = 0; lOther < lIndex; lOther++)
+			{
+				if (RotSameName(mProperties[lIndex].mName, mProperties[lOther].mName))
+				{
+					RotDuplicateProperty();
+				}
+			}
+		}
+
+		while (!TrySeed())
+		{
+			mSeed++;
+		}
+	}
+
+	consteval bool TrySeed(void)
+	{
+		for (size_t lSlot = 0; lSlot < SLOTS; lSlot++)
+		{
+			mSlots[lSlot] = 0;
+		}
+
+		for (size_t lIndex = 0; lIndex < N; lIndex++)
+		{
+			const char *lName = mProperties[lIndex].mName;
+			size_t lSlot = RotHash(lName, RotNameLength(lName), mSeed) & (SLOTS - 1);
+			if (mSlots[lSlot])
+			{
+				return false;
+			}
+			mSlots[lSlot] = static_cast<uint8_t>(lIndex + 1);
+		}
+		return true;
+	}
+};
+
+// For objects with methods only
+inline constexpr uint8_t cRotNoSlots[1] = { 0 };
+inline constexpr RotLayout cRotNoProperties{ nullptr, cRotNoSlots, 0, 0 };
+
+/*
+ * Pushes a new read-only object over lObject. The layout must outlive it.
+ */
+void PushReadOnlyObject(Lua &lLua, const RotLayout &lLayout, void *lObject);
+
+/*
+ * Adds a method (a C closure with lUpValue as upvalue 1) to the read-only
+ * object on top of the stack.
+ */
+void AddReadOnlyMethod(Lua &lLua, const char *lName, void *lUpValue, lua_CFunction lFunc);
+
+/*
+ * Adds an integer constant (format.ASCII) to the read-only object on top of
+ * the stack.
+ */
+void AddReadOnlyConstant(Lua &lLua, const char *lName, lua_Integer lValue);
+
+/*
+ * Makes the read-only object on top of the stack callable: object(...) calls
+ * lFunc (a C closure with lUpValue as upvalue 1) with the arguments that
+ * follow the object.
+ */
+void SetReadOnlyCall(Lua &lLua, void *lUpValue, lua_CFunction lFunc);
+
+#endif /* AARDVARK_PLATFORM_INC_ROT_HPP_ */
@@ -0,0 +1,52 @@
+/*
+ * scheduler.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_SCHEDULER_HPP_
+#define AARDVARK_PLATFORM_INC_SCHEDULER_HPP_
+
+#include <cstdint>
+
+#include "lua.hpp"
+
+class ScriptProcessor;
+struct ScriptBudget;
+
+// What the 'scheduler' table is bound to: the budget of whichever session is running the current command
+class SchedulerTable
+{
+public:
+	explicit SchedulerTable(ScriptProcessor *lScriptProcessor);
+
+	uint64_t GetSliceInstructions(void) const;
+	void SetSliceInstructions(uint64_t lInstructions);
+	uint64_t GetSliceTime(void) const;
+	void SetSliceTime(uint64_t lMicroseconds);
+	uint64_t GetScriptLimit(void) const;
+	void SetScriptLimit(uint64_t lInstructions);
+	uint64_t GetPreemptions(void) const;
+
+private:
+	ScriptProcessor *mScriptProcessor;
+
+	ScriptBudget &GetBudget(void) const;
+};
+
+/*
+ * The 'scheduler' table: script budget of the session running the current
+ * command. 0 disables a limit.
+ *
+ *		scheduler.sliceinstructions	instructions a script runs before other
+ *									sessions get a turn
+ *		scheduler.slicetime			microseconds a script runs before other
+ *									sessions get a turn
+ *		scheduler.scriptlimit		instructions after which a script gets an
+ *									error
+ *		scheduler.preemptions		times this session's scripts were preempted
+ */
+void SchedulerInstall(lua_State *lState, ScriptProcessor *lScriptProcessor);
+
+#endif /* AARDVARK_PLATFORM_INC_SCHEDULER_HPP_ */
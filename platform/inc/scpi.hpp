@@ -0,0 +1,469 @@
+/*
+ * scpi.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_SCPI_HPP_
+#define AARDVARK_PLATFORM_INC_SCPI_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "session.hpp"
+
+using namespace std;
+
+/*
+ * SCPI command tree
+ *
+ * Commands are declared as a constexpr table of header patterns in the usual
+ * SCPI notation, e.g.
+ *
+ *		{ "SYSTem:ERRor[:NEXT]?", SystemErrorNextQuery }
+ *		{ "OUTPut#[:STATe]", OutputState }
+ *
+ * Upper case letters are the short form, the whole word the long form. A '#'
+ * allows a numeric suffix and [ ] marks an optional node. A trailing '?' makes
+ * the entry the query form of that header.
+ *
+ * BuildTree() expands every optional node and folds the patterns into a trie
+ * at compile time. It rejects malformed patterns, ambiguous short forms and
+ * headers claimed twice with a compile error. At run time Execute() walks that
+ * trie for every program message unit and calls the C++ handler directly, so
+ * SCPI traffic never goes through the Lua compiler.
+ */
+namespace Scpi
+{
+	constexpr uint16_t NO_NODE = 0xffff;
+	constexpr size_t MAX_MNEMONIC_LENGTH = 12;
+	constexpr size_t MAX_DEPTH = 8;
+	constexpr size_t MAX_PARAMETERS = 16;
+	constexpr int32_t DEFAULT_SUFFIX = 1;
+	constexpr size_t MAX_MACRO_LABEL_LENGTH = 12;
+
+	struct Context;
+	typedef void (*Handler)(Context &lContext);
+
+	struct Command
+	{
+		const char *mPattern;
+		Handler mHandler;
+	};
+
+	struct Node
+	{
+		char mMnemonic[MAX_MNEMONIC_LENGTH + 1] = {};	// long form, upper case
+		uint8_t mShortLength = 0;
+		uint8_t mLongLength = 0;
+		bool mSuffix = false;
+		uint16_t mParent = NO_NODE;
+		uint16_t mFirstChild = NO_NODE;
+		uint16_t mNextSibling = NO_NODE;
+		Handler mSet = nullptr;
+		Handler mQuery = nullptr;
+	};
+
+	struct TreeView
+	{
+		const Node *mNodes;
+		uint16_t mRoot;
+	};
+
+	template <size_t NODES>
+	struct Tree
+	{
+		Node mNodes[NODES] = {};
+		uint16_t mCount = 0;
+		uint16_t mRoot = NO_NODE;
+
+		constexpr TreeView View(void) const { return TreeView{ mNodes, mRoot }; }
+	};
+
+	/*
+	 * Everything a handler gets to see about the program message unit being
+	 * executed. Parameters point into the received message and are only valid
+	 * for the duration of the call; GetBlock() hands out arbitrary block data
+	 * the same way, without copying it.
+	 */
+	struct Context
+	{
+		ClientSession *mSession;
+		string *mOutput;
+		bool mQuery;
+		size_t mDepth;
+		int32_t mSuffixes[MAX_DEPTH];
+		size_t mParameterCount;
+		string_view mParameters[MAX_PARAMETERS];
+		bool mCanHold;				// the caller can carry on with the message later
+		bool mHold;					// set by the handler to be called again later
+		bool mCacheable;			// set by Cacheable()
+		const char *mCacheKey;
+	};
+
+	/*
+	 * Where Execute() stopped in a program message whose handler asked to be
+	 * held (*WAI, *OPC? while operations are pending). Handing it back to
+	 * Execute() runs that unit again and carries on from there, with the
+	 * header path and the response separators as they were.
+	 *
+	 * Once the message is done, mCacheable tells whether it was a single unit
+	 * whose handler let its response be cached.
+	 */
+	struct Progress
+	{
+		bool mHeld = false;
+		size_t mOffset = 0;			// of the held unit
+		uint16_t mPath = NO_NODE;
+		size_t mResponses = 0;
+		bool mCacheable = false;
+		const char *mCacheKey = nullptr;
+	};
+
+	/*
+	 * IEEE 488.2 macros (10.7, 10.9, 10.10, 10.13, 10.22, 10.25)
+	 *
+	 * *DMC "label",<body> defines a macro; while *EMC 1 has them enabled, a
+	 * program message unit that is just the label runs the body in its place.
+	 * A body made of SCPI headers is resolved against the tree when it is
+	 * defined and kept as the list of handler calls it expands to, with its
+	 * parameters already split, so expanding it parses nothing. Any other body
+	 * is a Lua chunk: it is compiled when it is defined and runs when its label
+	 * is sent as a line of its own.
+	 *
+	 * Macro parameters ($1 to $9) are not supported, and a macro body cannot
+	 * be held by *WAI or *OPC?.
+	 */
+	struct MacroUnit
+	{
+		Handler mHandler;
+		Context mContext;			// parameters point into the macro's body
+	};
+
+	struct Macro
+	{
+		string mBody;
+		bool mScpi;
+		vector<MacroUnit> mUnits;
+	};
+
+	class MacroTable
+	{
+	public:
+		explicit MacroTable(TreeView lTree);
+		MacroTable(MacroTable &) = delete;
+		MacroTable &operator=(MacroTable &) = delete;
+
+		// Each of these pushes the matching SCPI error when it fails
+		const Macro *Define(string_view lLabel, string_view lBody);
+		bool Remove(string_view lLabel);
+		void Purge(void);
+
+		const Macro *Find(string_view lLabel) const;
+		const Macro *FindExpandable(string_view lLabel) const;		// nullptr while disabled
+		vector<string> GetLabels(void) const;
+		void Expand(const Macro &lMacro, ClientSession *lSession, size_t &lResponses);
+
+		inline bool IsEnabled(void) const { return mEnabled; }
+		inline void SetEnabled(bool lEnabled) { mEnabled = lEnabled; }
+		inline bool IsExpanding(void) const { return mExpanding != 0; }
+
+		static bool IsValidLabel(string_view lLabel);
+
+	private:
+		struct LabelLess
+		{
+			using is_transparent = void;
+			bool operator()(string_view lFirst, string_view lSecond) const;
+		};
+
+		TreeView mTree;
+		map<string, Macro, LabelLess> mMacros;	// nodes stay put, so the units' views stay valid
+		bool mEnabled;
+		unsigned int mExpanding;				// macros being expanded; *TRG can nest one
+
+		bool Prepare(Macro &lMacro);
+	};
+
+	bool Execute(const TreeView &lTree, const char *lMessage, size_t lLength, ClientSession *lSession,
+				 Progress *lProgress = nullptr, MacroTable *lMacros = nullptr);
+	bool Recognize(const TreeView &lTree, const char *lMessage, size_t lLength, const MacroTable *lMacros = nullptr);
+
+	// The instrument's command tree
+	bool Dispatch(const char *lMessage, size_t lLength, ClientSession *lSession, Progress *lProgress = nullptr);
+	bool IsCommand(const char *lMessage, size_t lLength);
+	bool AnswerStatusQueries(const char *lMessage, size_t lLength, string &lResponse);
+	extern MacroTable gMacros;
+
+	// Handler helpers; each one pushes the matching SCPI error when it fails
+	void PushError(int32_t lNumber, const char *lMessage);
+	bool ExpectParameters(Context &lContext, size_t lMinimum, size_t lMaximum);
+	bool GetUnsigned(Context &lContext, size_t lIndex, uint32_t lMaximum, uint32_t &lValue);
+	bool GetBoolean(Context &lContext, size_t lIndex, bool &lValue);
+	bool GetString(Context &lContext, size_t lIndex, string &lValue);
+	bool GetBlock(Context &lContext, size_t lIndex, string_view &lPayload);
+	void Respond(Context &lContext, int64_t lValue);
+	void Respond(Context &lContext, string_view lValue);
+	void RespondString(Context &lContext, string_view lValue);
+	void RespondBlock(Context &lContext, string_view lPayload);
+	void Cacheable(Context &lContext, const char *lKey = nullptr);	// see ResponseCache
+
+	/*
+	 * Compile-time construction
+	 */
+	struct Element
+	{
+		char mMnemonic[MAX_MNEMONIC_LENGTH + 1] = {};
+		uint8_t mShortLength = 0;
+		uint8_t mLongLength = 0;
+		bool mSuffix = false;
+		bool mOptional = false;
+	};
+
+	struct Pattern
+	{
+		Element mElements[MAX_DEPTH] = {};
+		size_t mCount = 0;
+		size_t mOptionalCount = 0;
+		bool mQuery = false;
+	};
+
+	// Deliberately not constexpr: reaching it while building a tree is a compile error
+	void PatternError(const char *lReason);
+
+	constexpr bool IsUpper(char lChar) { return lChar >= 'A' && lChar <= 'Z'; }
+	constexpr bool IsLower(char lChar) { return lChar >= 'a' && lChar <= 'z'; }
+	constexpr bool IsDigit(char lChar) { return lChar >= '0' && lChar <= '9'; }
+	constexpr char ToUpper(char lChar) { return IsLower(lChar) ? lChar - 'a' + 'A' : lChar; }
+
+	constexpr Pattern ParsePattern(const char *lText)
+	{
+		Pattern lPattern;
+		bool lOptional = false;
+
+		while (*lText)
+		{
+			char lChar = *lText;
+			if (lChar == '[')
+			{
+				if (lOptional)
+				{
+					PatternError("nested optional node");
+				}
+				lOptional = true;
+				lText++;
+			}
+			else if (lChar == ']')
+			{
+				if (!lOptional)
+				{
+					PatternError("unbalanced ]");
+				}
+				lOptional = false;
+				lText++;
+			}
+			else if (lChar == ':')
+			{
+				lText++;
+			}
+			else if (lChar == '?')
+			{
+				if (lText[1])
+				{
+					PatternError("? must end the pattern");
+				}
+				lPattern.mQuery = true;
+				lText++;
+			}
+			else
+			{
+				if (lPattern.mCount == MAX_DEPTH)
+				{
+					PatternError("too many nodes");
+				}
+
+				Element &lElement = lPattern.mElements[lPattern.mCount++];
+				bool lShort = true;
+				lElement.mOptional = lOptional;
+
+				while (IsUpper(*lText) || IsLower(*lText) || IsDigit(*lText) || *lText == '*' || *lText == '_')
+				{
+					if (lElement.mLongLength == MAX_MNEMONIC_LENGTH)
+					{
+						PatternError("mnemonic too long");
+					}
+
+					if (IsLower(*lText))
+					{
+						lShort = false;
+					}
+					else if (lShort)
+					{
+						lElement.mShortLength++;
+					}
+					else if (IsUpper(*lText))
+					{
+						PatternError("upper case after the short form");
+					}
+
+					lElement.mMnemonic[lElement.mLongLength++] = ToUpper(*lText++);
+				}
+
+				if (*lText == '#')
+				{
+					lElement.mSuffix = true;
+					lText++;
+				}
+
+				if (!lElement.mLongLength)
+				{
+					PatternError("unexpected character");
+				}
+
+				if (lOptional)
+				{
+					lPattern.mOptionalCount++;
+				}
+			}
+		}
+
+		if (lOptional)
+		{
+			PatternError("unterminated [");
+		}
+
+		return lPattern;
+	}
+
+	constexpr bool SameText(const char *lFirst, const char *lSecond, size_t lLength)
+	{
+		for (size_t lIndex = 0; lIndex < lLength; lIndex++)
+		{
+			if (lFirst[lIndex] != lSecond[lIndex])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <size_t NODES>
+	constexpr uint16_t FindOrAddChild(Tree<NODES> &lTree, uint16_t lParent, const Element &lElement)
+	{
+		uint16_t &lHead = (lParent == NO_NODE) ? lTree.mRoot : lTree.mNodes[lParent].mFirstChild;
+		uint16_t lLast = NO_NODE;
+
+		for (uint16_t lIndex = lHead; lIndex != NO_NODE; lIndex = lTree.mNodes[lIndex].mNextSibling)
+		{
+			const Node &lNode = lTree.mNodes[lIndex];
+			bool lSameLong = lNode.mLongLength == lElement.mLongLength &&
+							 SameText(lNode.mMnemonic, lElement.mMnemonic, lElement.mLongLength);
+			bool lSameShort = lNode.mShortLength == lElement.mShortLength &&
+							  SameText(lNode.mMnemonic, lElement.mMnemonic, lElement.mShortLength);
+
+			if (lSameLong)
+			{
+				if (!lSameShort || lNode.mSuffix != lElement.mSuffix)
+				{
+					PatternError("node declared with different forms");
+				}
+				return lIndex;
+			}
+			else if (lSameShort)
+			{
+				PatternError("ambiguous short form");
+			}
+			lLast = lIndex;
+		}
+
+		if (lTree.mCount == NODES)
+		{
+			PatternError("tree is full");
+		}
+
+		uint16_t lNew = lTree.mCount++;
+		Node &lNode = lTree.mNodes[lNew];
+		for (size_t lIndex = 0; lIndex < lElement.mLongLength; lIndex++)
+		{
+			lNode.mMnemonic[lIndex] = lElement.mMnemonic[lIndex];
+		}
+		lNode.mShortLength = lElement.mShortLength;
+		lNode.mLongLength = lElement.mLongLength;
+		lNode.mSuffix = lElement.mSuffix;
+		lNode.mParent = lParent;
+
+		// Append, so siblings are tried in declaration order
+		if (lLast == NO_NODE)
+		{
+			lHead = lNew;
+		}
+		else
+		{
+			lTree.mNodes[lLast].mNextSibling = lNew;
+		}
+
+		return lNew;
+	}
+
+	template <size_t N>
+	consteval size_t CountNodes(const Command (&lCommands)[N])
+	{
+		size_t lCount = 0;
+		for (const Command &lCommand : lCommands)
+		{
+			Pattern lPattern = ParsePattern(lCommand.mPattern);
+			lCount += lPattern.mCount << lPattern.mOptionalCount;
+		}
+		return lCount;
+	}
+
+	template <size_t NODES, size_t N>
+	consteval Tree<NODES> BuildTree(const Command (&lCommands)[N])
+	{
+		Tree<NODES> lTree;
+
+		for (const Command &lCommand : lCommands)
+		{
+			Pattern lPattern = ParsePattern(lCommand.mPattern);
+
+			// One path through the trie for every combination of optional nodes
+			for (size_t lMask = 0; lMask < (static_cast<size_t>(1) << lPattern.mOptionalCount); lMask++)
+			{
+				uint16_t lNode = NO_NODE;
+				size_t lOptionalIndex = 0;
+
+				for (size_t lIndex = 0; lIndex < lPattern.mCount; lIndex++)
+				{
+					const Element &lElement = lPattern.mElements[lIndex];
+					if (lElement.mOptional && !(lMask & (static_cast<size_t>(1) << lOptionalIndex++)))
+					{
+						continue;
+					}
+					lNode = FindOrAddChild(lTree, lNode, lElement);
+				}
+
+				if (lNode == NO_NODE)
+				{
+					PatternError("pattern has no mandatory node");
+				}
+
+				Handler &lSlot = lPattern.mQuery ? lTree.mNodes[lNode].mQuery : lTree.mNodes[lNode].mSet;
+				if (lSlot && lSlot != lCommand.mHandler)
+				{
+					PatternError("header declared twice");
+				}
+				lSlot = lCommand.mHandler;
+			}
+		}
+
+		return lTree;
+	}
+}
+
+
+#endif /* AARDVARK_PLATFORM_INC_SCPI_HPP_ */
@@ -8,95 +8,143 @@
 #ifndef AARDVARK_PLATFORM_SRC_SCRIPTPROCESSOR_HPP_
 #define AARDVARK_PLATFORM_SRC_SCRIPTPROCESSOR_HPP_
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <pthread.h>
 
+#include "chunkcache.hpp"
 #include "endpoint.hpp"
+#include "gcpolicy.hpp"
 #include "lua.hpp"
+#include "luaallocator.hpp"
+#include "scpi.hpp"
+#include "scriptstore.hpp"
+#include "session.hpp"
 
 using namespace std;
 
-constexpr unsigned int ASCII_DEFAULT_PRECISION = 6;
+// Longest a suspended script waiting on an event goes without being polled
+constexpr chrono::milliseconds SCRIPT_MAX_WAIT{100};
 
-typedef ssize_t (*TokenHandler)(const char *, size_t);
+// Instructions between two looks at a running script's budget
+constexpr int SCRIPT_HOOK_INTERVAL = 1000;
+constexpr uint64_t SCRIPT_DEFAULT_SLICE_INSTRUCTIONS = 100000;
+constexpr chrono::microseconds SCRIPT_DEFAULT_SLICE_TIME{10000};
 
-enum
+/*
+ * How long a session's script may run before other sessions get a turn, and
+ * how long it may run at all. A script over its slice is preempted: yielded
+ * back to the scheduler and resumed like a delay() that has already expired.
+ * One over mScriptInstructions gets an error it can catch with pcall(), and
+ * again every SCRIPT_HOOK_INTERVAL instructions after that. 0 disables a
+ * limit. Counted in steps of SCRIPT_HOOK_INTERVAL instructions.
+ */
+struct ScriptBudget
+{
+	uint64_t mSliceInstructions = SCRIPT_DEFAULT_SLICE_INSTRUCTIONS;
+	chrono::microseconds mSliceTime = SCRIPT_DEFAULT_SLICE_TIME;
+	uint64_t mScriptInstructions = 0;
+};
+
+/*
+ * A session's own Lua state: a thread of the template state, created when the
+ * session first runs Lua, with an environment table of its own. Globals a
+ * session assigns land in its environment; reads fall through to the template
+ * globals, where the libraries and the read-only device tables were installed
+ * once by StartLua(). An error raised by one session's code only unwinds that
+ * session's thread.
+ *
+ * Scripts run as coroutines on that thread. One that has to wait (delay(), or
+ * any other wait primitive) yields through Suspend() with a wake time and an
+ * optional readiness check, and the rest of its transfer is parked here while
+ * other sessions' messages run. ResumeSuspended() picks it up again once it
+ * is due. A SCPI line held by *WAI or *OPC? parks the transfer the same way,
+ * with no script to resume, until no operations are pending.
+ */
+struct LuaSession
 {
-	IDN_Q_IDX = 0,
-	CLS_IDX,
-	RST_IDX,
-	TST_Q_IDX,
-	OPC_IDX,
-	OPC_Q_IDX,
-	WAI_IDX,
-	ESE_IDX,
-	ESE_Q_IDX,
-	ESR_Q_IDX,
-	SRE_IDX,
-	SRE_Q_IDX,
-	STB_Q_IDX,
-	MAX_TOKEN_IDX
+	ClientSession *mSession;
+	lua_State *mThread;
+	int mThreadReference;			// keeps mThread from being collected
+	int mEnvironmentReference;
+
+	ScriptBudget mBudget;
+	uint64_t mSliceUsed;			// instructions since the script was last resumed
+	uint64_t mScriptUsed;			// instructions since the script started
+	chrono::steady_clock::time_point mSliceStart;
+	uint64_t mPreemptions;
+	MemoryAccount mMemory;
+
+	// Script being sent between loadscript and endscript
+	bool mCapturing;
+	bool mRunCaptured;				// loadandrunscript
+	string mCaptureName;
+	string mCapture;
+
+	// Only meaningful while suspended
+	CommandMessage *mMessage;		// transfer being handled, nullptr when not suspended
+	size_t mResume;					// offset of its first line not handled yet
+	size_t mMark;					// response mark of the suspended script
+	chrono::steady_clock::time_point mWakeTime;
+	function<bool(void)> mReady;	// wakes the script before mWakeTime when true
+	Scpi::Progress mProgress;		// held SCPI line (*WAI, *OPC?) at mResume rather than a script
 };
-static constexpr char IDN_Q_TOKEN[] = "*IDN? ";
-static constexpr char CLS_TOKEN[] = "*CLS ";
-static constexpr char RST_TOKEN[] = "*RST ";
-static constexpr char TST_Q_TOKEN[] = "*TST? ";
-static constexpr char OPC_TOKEN[] = "*OPC ";
-static constexpr char OPC_Q_TOKEN[] = "*OPC? ";
-static constexpr char WAI_TOKEN[] = "*WAI ";
-static constexpr char ESE_TOKEN[] = "*ESE ";
-static constexpr char ESE_Q_TOKEN[] = "*ESE? ";
-static constexpr char ESR_Q_TOKEN[] = "*ESR? ";
-static constexpr char SRE_TOKEN[] = "*SRE ";
-static constexpr char SRE_Q_TOKEN[] = "*SRE? ";
-static constexpr char STB_Q_TOKEN[] = "*STB? ";
-
-static ssize_t IDNQHandler(const char *lBuffer, size_t lLength);
-static ssize_t CLSHandler(const char *lBuffer, size_t lLength);
-static ssize_t RSTHandler(const char *lBuffer, size_t lLength);
-static ssize_t TSTQHandler(const char *lBuffer, size_t lLength);
-static ssize_t OPCHandler(const char *lBuffer, size_t lLength);
-static ssize_t OPCQHandler(const char *lBuffer, size_t lLength);
-static ssize_t WAIHandler(const char *lBuffer, size_t lLength);
-static ssize_t ESEHandler(const char *lBuffer, size_t lLength);
-static ssize_t ESEQHandler(const char *lBuffer, size_t lLength);
-static ssize_t ESRQHandler(const char *lBuffer, size_t lLength);
-static ssize_t SREHandler(const char *lBuffer, size_t lLength);
-static ssize_t SREQHandler(const char *lBuffer, size_t lLength);
-static ssize_t STBQHandler(const char *lBuffer, size_t lLength);
-
-enum DebugFunctions {
-	FUNC_GET_MANUFACTURER = 0,
-	FUNC_GET_MODEL,
-	FUNC_GET_SERIAL,
+
+/*
+ * Where start-up went, measured once. mReady runs from the process start
+ * main() hands to Ready() to the point the first command can be taken.
+ */
+struct StartupTimes
+{
+	chrono::microseconds mLibraries{0};		// standard libraries
+	chrono::microseconds mTables{0};		// eager globals and device tables
+	chrono::microseconds mScripts{0};		// stored scripts restored
+	chrono::microseconds mAutorun{0};
+	chrono::microseconds mReady{0};
+	unsigned int mLazyInstalls = 0;			// subsystem tables installed on first use so far
 };
 
 class ScriptProcessor : public Endpoint, public Lua
 {
 protected:
-	enum {
-		OUTPUT_BUFFER_SIZE = 10000,
-	};
-	static string mOutputString;
-
-	int mAsciiPrecision = ASCII_DEFAULT_PRECISION;
+	ClientSession *mSession;		// session whose message is being handled
+	ChunkCache mChunkCache;
+	GcPolicy mGcPolicy;
+	ScriptStore mScriptStore;
+	StartupTimes mStartupTimes;
 	bool mTriggered;
+	bool mCacheable;				// the transfer being handled is one cacheable SCPI query
+	const char *mCacheKey;
 
 private:
-
-	static constexpr size_t mNumTokens = MAX_TOKEN_IDX;
-	static constexpr const char *mTokens[] = {
-			IDN_Q_TOKEN, CLS_TOKEN, RST_TOKEN, TST_Q_TOKEN, OPC_TOKEN, OPC_Q_TOKEN, WAI_TOKEN,
-			ESE_TOKEN, ESE_Q_TOKEN, ESR_Q_TOKEN, SRE_TOKEN, SRE_Q_TOKEN, STB_Q_TOKEN
-	};
-
 	pthread_mutex_t mLock;
+	unordered_map<uint64_t, LuaSession> mLuaSessions;	// by ClientSession id
+	vector<uint64_t> mRetired;
+	vector<uint64_t> mCleared;
+	vector<uint64_t> mWaking;
+
+	int HandleLines(const char *lBuffer, size_t lLength, size_t lStart);
+	int RunBatch(const char *lBuffer, size_t lScriptStart, size_t lScriptEnd, size_t lResume);
+	int StartThread(LuaSession &lLuaSession);
+	int ResumeThread(LuaSession &lLuaSession);
+	void BeginCapture(LuaSession &lLuaSession, const char *lLine, size_t lLength);
+	int EndCapture(LuaSession &lLuaSession, size_t lResume);
+	void Park(size_t lResume, size_t lMark);
+	bool GetWakeTime(chrono::steady_clock::time_point &lWakeTime);
+	struct Subsystem
+	{
+		const char *mName;
+		void (*mInstall)(ScriptProcessor *lScriptProcessor, lua_State *lState);
+	};
 
-	/* IEEE-488 Standard Commands/Queries */
-	void RegisterHandler(TokenHandler, size_t);
-
-	TokenHandler mTokenHandlers[mNumTokens] = { static_cast<TokenHandler>(nullptr) };
+	static const Subsystem *FindSubsystem(const char *lName);
+	bool InstallSubsystem(lua_State *lState, const char *lName);
+	void DropSuspended(LuaSession &lLuaSession);
 
 	inline int Lock(void) { return pthread_mutex_lock(&mLock); }
 	inline int TryLock(void) { return pthread_mutex_trylock(&mLock); }
@@ -108,16 +156,48 @@ public:
 	ScriptProcessor(const ScriptProcessor& lOther) = delete;
 	ScriptProcessor& operator=(const ScriptProcessor& lOther) = delete;
 
-	static int InfoHandler(lua_State *lState);
+	static int LoadSubsystem(lua_State *lState);
+	static inline bool IsSubsystem(const char *lName) { return FindSubsystem(lName) != nullptr; }
 
 	inline Lua & GetLuaInstance(void) { return static_cast<Lua &>(*this); }
 
-	inline int GetAsciiPrecision(void) const { return mAsciiPrecision; }
+	inline ClientSession *GetSession(void) const { return mSession; }
+	inline unsigned int GetAsciiPrecision(void) const { return mSession->GetResponse().GetAsciiPrecision(); }
+
+	/*
+	 * Program messages sent to the script processor are queued on the sender's
+	 * session; Receive() takes the next one in scheduling order, or returns
+	 * nullptr when a suspended script is due first. Process() handles it and,
+	 * unless a script in it was suspended, sends the response and releases the
+	 * session through Finish() and Complete(). Status queries, and queries
+	 * whose response is in gResponseCache, are answered by Deliver() on the
+	 * sender's thread when its session is idle.
+	 */
+	int Deliver(CommandMessage *lMessage) override;
+	CommandMessage *Receive(void);
+	void Process(CommandMessage *lMessage);
+	void Finish(CommandMessage *lMessage);
+	inline void Complete(void) { gSessionManager.Complete(mSession); mSession = gSessionManager.GetDefaultSession(); }
+
+	int Suspend(lua_State *lState, chrono::steady_clock::time_point lWakeTime, function<bool(void)> lReady = nullptr);
+	bool CanSuspend(lua_State *lState);
+	void ResumeSuspended(void);
+	void Charge(lua_State *lState);
 
-	void InstallTokenHandlers(void);
 	void StartLua(void);
-	int HandleCommand(const char *lBuffer, size_t lLength, bool lCheckTokens = true);
+	void Autorun(void);
+	void Ready(chrono::steady_clock::time_point lProcessStart);
+	inline const StartupTimes &GetStartupTimes(void) const { return mStartupTimes; }
+	int HandleCommand(const char *lBuffer, size_t lLength, bool lCheckScpi = true);
 	int RunScript(const char *lScript, size_t lLength);
+	int PrepareScript(const char *lScript, size_t lLength);
+	int RunStoredScript(const string &lName);
+
+	LuaSession &GetLuaSession(ClientSession *lSession);
+	void ReleaseLuaSessions(void);
+	inline size_t GetLuaSessionCount(void) const { return mLuaSessions.size(); }
+	inline int GetEnvironmentReference(void) { return GetLuaSession(mSession).mEnvironmentReference; }
+	inline ScriptStore &GetScriptStore(void) { return mScriptStore; }
 
 	void PushGlobalClosure(const char *lName, lua_CFunction lFunc, int lNumUpValues);
 	void PushStatelessGlobalClosure(const char *lName, lua_CFunction lFunc);
@@ -126,9 +206,9 @@ public:
 	void InfoInstall(lua_State *lState);
 
 	// Public getters/setters/misc.
-	inline char *GetData(void) { return const_cast<char*>(mOutputString.c_str()); }
-	inline void ClearData(void) { Lock(); mOutputString.clear(); Unlock(); }
-	inline unsigned int GetCount(void) { return mOutputString.length(); }
+	inline char *GetData(void) { return const_cast<char*>(mSession->GetOutput().c_str()); }
+	inline void ClearData(void) { Lock(); mSession->ClearOutput(); Unlock(); }
+	inline unsigned int GetCount(void) { return mSession->GetOutput().length(); }
 };
 
 class StatelessScriptProcessor : ScriptProcessor
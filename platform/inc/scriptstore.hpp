@@ -0,0 +1,138 @@
+/*
+ * scriptstore.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_SCRIPTSTORE_HPP_
+#define AARDVARK_PLATFORM_INC_SCRIPTSTORE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "lua.hpp"
+
+using namespace std;
+
+class ScriptProcessor;
+class ScriptStore;
+
+constexpr char SCRIPT_STORE_DIRECTORY[] = "/var/lib/aardvark/scripts";
+constexpr char SCRIPT_SOURCE_SUFFIX[] = ".lua";
+constexpr char SCRIPT_BYTECODE_SUFFIX[] = ".luac";
+constexpr char SCRIPT_AUTORUN_SUFFIX[] = ".autorun";
+constexpr char SCRIPT_ANONYMOUS_NAME[] = "anonymous";
+constexpr uint32_t SCRIPT_BYTECODE_MAGIC = 0x41564b43;		// "AVKC"
+
+struct StoredScript
+{
+	string mSource;
+	uint64_t mHash;					// of mSource
+	string mBytecode;				// lua_dump() of the compiled chunk
+	bool mAutorun;
+};
+
+/*
+ * What a script's global object is bound to. It carries the script's name
+ * rather than a pointer to the script, so it fails cleanly once the script
+ * has been deleted, and the store keeps it as long as Lua may hold it.
+ */
+class ScriptObject
+{
+public:
+	ScriptObject(ScriptStore *lStore, const string &lName);
+
+	inline const string &GetName(void) const { return mName; }
+	const string &GetSource(Lua &lLua) const;
+	bool IsAutorun(Lua &lLua) const;
+	void SetAutorun(Lua &lLua, bool lAutorun);
+	void Save(Lua &lLua);
+
+	static int FuncRun(lua_State *lState);
+
+private:
+	ScriptStore *mStore;
+	string mName;
+
+	StoredScript &GetScript(Lua &lLua) const;
+};
+
+/*
+ * Named script store
+ *
+ * Scripts are defined by sending their source between 'loadscript <name>' and
+ * 'endscript' lines (or 'loadandrunscript', which also runs it), or with
+ * script.new(). Each becomes a global object of that name:
+ *
+ *		name()			runs it, as does name.run() or script.run("name")
+ *		name.save()		writes it to flash
+ *		name.autorun	true to run it at startup (kept by save())
+ *		name.source		its source
+ *
+ * A script is compiled once, when it is defined, and kept as bytecode. Running
+ * it loads that bytecode against the caller's environment; nothing is parsed
+ * again. Saved scripts keep their bytecode next to the source with a header
+ * holding the Lua version, a hash of the source and one of the bytecode, so
+ * Restore() at startup only compiles a script whose cache is missing, stale
+ * or damaged. Autorun() then runs the ones marked autorun.
+ */
+class ScriptStore
+{
+public:
+	explicit ScriptStore(ScriptProcessor *lScriptProcessor, const char *lDirectory = SCRIPT_STORE_DIRECTORY);
+	ScriptStore(ScriptStore &) = delete;
+	ScriptStore &operator=(ScriptStore &) = delete;
+
+	/*
+	 * Define() compiles the source and creates the script's global object; it
+	 * returns LUA_OK, or the error code with the message pushed. Load() pushes
+	 * the script's function with the table at lEnvironment as its _ENV.
+	 */
+	int Define(Lua &lLua, const string &lName, string lSource);
+	int Load(Lua &lLua, const string &lName, int lEnvironment);
+	int Run(lua_State *lState, const string &lName, int lFirstArgument);
+	void Save(Lua &lLua, const string &lName);
+	void Delete(Lua &lLua, const string &lName);
+	void Restore(Lua &lLua);
+	void Autorun(Lua &lLua);
+
+	StoredScript *Find(const string &lName);
+	inline const map<string, StoredScript> &GetScripts(void) const { return mScripts; }
+	static bool IsValidName(string_view lName);
+	bool IsFreeName(Lua &lLua, const string &lName);
+
+	static int FuncNew(lua_State *lState);
+	static int FuncRun(lua_State *lState);
+	static int FuncList(lua_State *lState);
+
+private:
+	ScriptProcessor *mScriptProcessor;
+	string mDirectory;
+	map<string, StoredScript> mScripts;
+	map<string, ScriptObject> mObjects;		// for every name defined, deleted or not
+
+	static uint64_t Hash(const string &lSource);
+	static int Compile(Lua &lLua, const string &lName, StoredScript &lScript);
+	void MakeObject(Lua &lLua, const string &lName);
+	int Write(const string &lName);
+	string GetPath(const string &lName, const char *lSuffix) const;
+	bool ReadBytecode(const string &lName, StoredScript &lScript) const;
+	int WriteBytecode(const string &lName, const StoredScript &lScript) const;
+};
+
+/*
+ * The 'script' table
+ *
+ *		script.new(source, name)	defines a script and returns its object
+ *		script.run(name, ...)		runs a script
+ *		script.save(name)			writes a script to flash
+ *		script.delete(name)			deletes a script, from flash too
+ *		script.list()				the names of the scripts, in order
+ */
+void ScriptStoreInstall(lua_State *lState, ScriptProcessor *lScriptProcessor);
+
+#endif /* AARDVARK_PLATFORM_INC_SCRIPTSTORE_HPP_ */
@@ -0,0 +1,180 @@
+/*
+ * session.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#ifndef AARDVARK_PLATFORM_INC_SESSION_HPP_
+#define AARDVARK_PLATFORM_INC_SESSION_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "commandmessage.hpp"
+#include "responsewriter.hpp"
+
+using namespace std;
+
+class Endpoint;
+
+constexpr unsigned int SESSION_DEFAULT_WEIGHT = 1;
+constexpr size_t SESSION_DEFAULT_CAPACITY = 64;
+constexpr size_t SESSION_DEFAULT_MAX_BYTES = 1024 * 1024;
+constexpr double SESSION_DEFAULT_BURST = 16.0;
+constexpr size_t SESSION_MANAGER_DEFAULT_CAPACITY = 512;
+constexpr size_t SESSION_MANAGER_DEFAULT_RESERVE = 64;
+
+/*
+ * Per-client admission limits
+ *
+ * A program message is admitted only while the session is under its queued
+ * command and byte limits, its token bucket (mRate commands per second, up to
+ * mBurst at once; 0 disables it) has a token, and the shared pool has room.
+ * The last SESSION_MANAGER_DEFAULT_RESERVE slots of the pool are kept for
+ * high-priority sessions.
+ *
+ * What happens to a message over the limits depends on the transport. Flow
+ * controlled ones (byte streams that can stop reading) get it back and retry
+ * later. For the others it is discarded and "Queue overflow" (-350) is pushed
+ * on the error queue.
+ *
+ * A session's limits and counters are read and set through the session
+ * manager, under its lock; scripts do it through the 'admission' table.
+ */
+struct AdmissionLimits
+{
+	size_t mMaxQueuedCommands = SESSION_DEFAULT_CAPACITY;
+	size_t mMaxQueuedBytes = SESSION_DEFAULT_MAX_BYTES;
+	double mRate = 0.0;
+	double mBurst = SESSION_DEFAULT_BURST;
+	bool mHighPriority = false;
+	bool mFlowControlled = false;
+};
+
+struct AdmissionCounters
+{
+	uint64_t mAccepted = 0;
+	uint64_t mDeferred = 0;			// handed back to a flow controlled transport
+	uint64_t mRejected = 0;			// discarded with -350
+	uint64_t mQueueFull = 0;		// by reason, deferred or rejected
+	uint64_t mBytesFull = 0;
+	uint64_t mRateLimited = 0;
+	uint64_t mReserveFull = 0;
+};
+
+/*
+ * Per-client state of the script processor
+ *
+ * Every connected client (the USBTMC function, each socket, each HiSLIP
+ * session, ...) gets one. It holds the program messages that client has queued
+ * for the script processor, the response being built for it, and its
+ * formatting settings, so clients cannot interleave output or read each
+ * other's responses.
+ */
+class ClientSession
+{
+	friend class SessionManager;
+
+public:
+	ClientSession(Endpoint *lOrigin, const char *lName,
+				  size_t lCapacity = SESSION_DEFAULT_CAPACITY, unsigned int lWeight = SESSION_DEFAULT_WEIGHT);
+	~ClientSession();
+	ClientSession(ClientSession &) = delete;
+	ClientSession &operator=(ClientSession &) = delete;
+
+	inline uint64_t GetId(void) const { return mId; }
+	inline Endpoint *GetOrigin(void) const { return mOrigin; }
+	inline const string &GetName(void) const { return mName; }
+	inline unsigned int GetWeight(void) const { return mWeight; }
+
+	inline ResponseWriter &GetResponse(void) { return mResponse; }
+	inline string &GetOutput(void) { return mResponse.GetBuffer(); }
+	inline void ClearOutput(void) { mResponse.Clear(); }
+
+private:
+	uint64_t mId;						// never reused, unlike the address
+	Endpoint *mOrigin;
+	string mName;
+	AdmissionLimits mLimits;
+	AdmissionCounters mCounters;
+	size_t mQueuedBytes;
+	double mTokens;
+	chrono::steady_clock::time_point mLastRefill;
+	unsigned int mWeight;
+	unsigned int mCredit;				// messages left in the current round-robin turn
+	bool mActive;						// the script processor is running one of our messages
+	bool mParked;						// ... but it is suspended, and nothing of ours is being touched
+
+	deque<CommandMessage *> mInput;
+	ResponseWriter mResponse;			// response being built and its format settings
+};
+
+/*
+ * Routes program messages into the session of the client that sent them and
+ * hands them to the script processor in weighted round-robin order: a session
+ * with weight N may run up to N messages before the next session with pending
+ * input gets a turn.
+ */
+class SessionManager
+{
+public:
+	SessionManager(void);
+	~SessionManager();
+	SessionManager(SessionManager &) = delete;
+	SessionManager &operator=(SessionManager &) = delete;
+
+	void Register(ClientSession *lSession);
+	void Unregister(ClientSession *lSession);
+	void Clear(ClientSession *lSession);
+	void SetWeight(ClientSession *lSession, unsigned int lWeight);
+	AdmissionLimits GetLimits(ClientSession *lSession);
+	void SetLimits(ClientSession *lSession, const AdmissionLimits &lLimits);
+	AdmissionCounters GetCounters(ClientSession *lSession);
+	void SetCapacity(size_t lCapacity, size_t lReserve);
+
+	int Submit(CommandMessage *lMessage);
+	CommandMessage *Next(ClientSession **lSession, const chrono::steady_clock::time_point *lDeadline = nullptr);
+	void Complete(ClientSession *lSession);
+	void Park(ClientSession *lSession);
+	bool Unpark(uint64_t lId);
+	void Wake(void);
+	void TakeRetired(vector<uint64_t> &lIds);
+	void TakeCleared(vector<uint64_t> &lIds);
+	bool HasPendingInput(void);
+	bool IsIdle(Endpoint *lOrigin);
+
+	inline ClientSession *GetDefaultSession(void) { return &mDefaultSession; }
+
+private:
+	pthread_mutex_t mLock;
+	pthread_cond_t mInputAvailable;
+	pthread_cond_t mSessionIdle;
+
+	vector<ClientSession *> mSessions;
+	size_t mCursor;
+	size_t mQueuedCommands;				// across every session
+	size_t mCapacity;
+	size_t mReserve;
+	ClientSession mDefaultSession;		// origins without a registered session
+	vector<uint64_t> mRetired;			// sessions unregistered since the last TakeRetired()
+	vector<uint64_t> mCleared;			// parked sessions cleared since the last TakeCleared()
+	bool mWakeRequested;
+
+	ClientSession *Find(Endpoint *lOrigin);
+	bool Admit(ClientSession *lSession, size_t lLength);
+	bool HasInput(void) const;
+
+	inline int Lock(void) { return pthread_mutex_lock(&mLock); }
+	inline int Unlock(void) { return pthread_mutex_unlock(&mLock); }
+};
+
+extern SessionManager gSessionManager;
+
+#endif /* AARDVARK_PLATFORM_INC_SESSION_HPP_ */
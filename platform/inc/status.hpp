@@ -9,6 +9,7 @@
 #define PLATFORM_INC_STATUS_HPP_
 
 
+#include <atomic>
 #include <cstdint>
 #include <mutex>
 
@@ -33,20 +34,6 @@ constexpr uint16_t MAV_BIT = 4;
 void StatusInstall(lua_State *lState);
 
 
-enum StatusFunctions {
-	FUNC_GET_CONDITION_REGISTER = 0,
-	FUNC_GET_EVENT_REGISTER,
-	FUNC_SET_EVENT_REGISTER,
-	FUNC_GET_EVENT_ENABLE_REGISTER,
-	FUNC_SET_EVENT_ENABLE_REGISTER,
-	FUNC_GET_POSITIVE_TRANS_REGISTER,
-	FUNC_SET_POSITIVE_TRANS_REGISTER,
-	FUNC_GET_NEGATIVE_TRANS_REGISTER,
-	FUNC_SET_NEGATIVE_TRANS_REGISTER,
-	FUNC_GET_SERVICE_REQUEST_ENABLE_REGISTER,
-	FUNC_SET_SERVICE_REQUEST_ENABLE_REGISTER,
-};
-
 /*
  * Status Data Structure - Register Model
  * IEEE488.2 - 11.4
@@ -63,7 +50,7 @@ public:
 	inline bool TryLock(void) { return mLock.try_lock(); }
 	inline void Unlock(void) { mLock.unlock(); }
 
-	inline uint16_t Get(void) const { return mValue; }
+	inline uint16_t Get(void) const { return mValue.load(std::memory_order_relaxed); }
 	inline void Set(uint16_t lValue) { Lock(); mValue = lValue; Unlock(); }
 	inline void Clear(void) { Lock(); mValue = 0; Unlock(); }
 	inline void ClearBits(uint16_t lBitMask) { Lock(); mValue &= (~lBitMask); Unlock(); }
@@ -71,13 +58,13 @@ public:
 	inline void SetBits(uint16_t lBitMask) { Lock(); mValue |= lBitMask; Unlock(); }
 	inline void SetBits(const StatusRegister& lOther) { SetBits(lOther.Get()); }
 
-	inline StatusRegister operator&(const StatusRegister& lOther) const { return StatusRegister(lOther.mValue & this->mValue); }
-	inline StatusRegister operator|(const StatusRegister& lOther) const { return StatusRegister(lOther.mValue | this->mValue); }
+	inline StatusRegister operator&(const StatusRegister& lOther) const { return StatusRegister(lOther.Get() & this->Get()); }
+	inline StatusRegister operator|(const StatusRegister& lOther) const { return StatusRegister(lOther.Get() | this->Get()); }
 	inline StatusRegister& operator&=(const StatusRegister& lOther) { this->Set(this->Get() & lOther.Get()); return *this; }
 	inline StatusRegister& operator|=(const StatusRegister& lOther) { this->Set(this->Get() | lOther.Get()); return *this; }
 
 private:
-	uint16_t mValue = 0;
+	std::atomic<uint16_t> mValue = 0;		// read without the lock by StatusDataStructure::Snapshot()
 	std::mutex mLock;
 };
 
@@ -118,6 +105,17 @@ public:
 };
 
 
+/*
+ * The registers the common status queries report, all taken at one instant
+ */
+struct StatusSnapshot {
+	uint16_t mEventRegister;
+	uint16_t mEventEnableRegister;
+	uint16_t mServiceRequestEnableRegister;
+	uint16_t mStatusByteRegister;
+};
+
+
 /*
  * StatusDataStructure - IEEE 488.2 Section 11.5
  * Based on the Standard Event Status Register Model (11.5.1)
@@ -132,51 +130,62 @@ private:
 	ServiceRequestEnableRegister mServiceRequestEnableRegister;
 
 	StatusByteRegister mStatusByteRegister;
+
+	/*
+	 * Sequence lock over the whole structure: odd while a write is under way,
+	 * so Snapshot() can take every register at once without blocking writers.
+	 */
+	std::atomic<uint32_t> mSequence;
+	std::mutex mWriteLock;
+
+	void BeginWrite(void);
+	void EndWrite(void);
 public:
 	StatusDataStructure(void);
 
-	static int HandleMsg(lua_State *lState);
+	StatusSnapshot Snapshot(void) const;
+	uint16_t TakeEventRegister(void);
 
-	inline void ClearConditionRegister(void) { mConditionRegister.Clear(); }
-	inline void SetConditionRegister(uint16_t lConditionRegister) {  mConditionRegister.Set(lConditionRegister); }
-	inline void ClearConditionRegisterBits(uint16_t lBitMask) { mConditionRegister.ClearBits(lBitMask); }
-	inline void SetConditionRegisterBits(uint16_t lBitMask) { mConditionRegister.SetBits(lBitMask); }
+	inline void ClearConditionRegister(void) { BeginWrite(); mConditionRegister.Clear(); EndWrite(); }
+	inline void SetConditionRegister(uint16_t lConditionRegister) { BeginWrite(); mConditionRegister.Set(lConditionRegister); EndWrite(); }
+	inline void ClearConditionRegisterBits(uint16_t lBitMask) { BeginWrite(); mConditionRegister.ClearBits(lBitMask); EndWrite(); }
+	inline void SetConditionRegisterBits(uint16_t lBitMask) { BeginWrite(); mConditionRegister.SetBits(lBitMask); EndWrite(); }
 	inline uint16_t GetConditionRegister(void) { return mConditionRegister.Get(); }
 
-	inline void ClearEventRegister(void) { mEventRegister.Clear(); }
-	inline void SetEventRegister(uint16_t lEventRegister) { mEventRegister.Set(lEventRegister); }
-	inline void ClearEventRegisterBits(uint16_t lBitMask) { mEventRegister.ClearBits(lBitMask); }
-	inline void SetEventRegisterBits(uint16_t lBitMask) { mEventRegister.SetBits(lBitMask); }
+	inline void ClearEventRegister(void) { BeginWrite(); mEventRegister.Clear(); EndWrite(); }
+	inline void SetEventRegister(uint16_t lEventRegister) { BeginWrite(); mEventRegister.Set(lEventRegister); EndWrite(); }
+	inline void ClearEventRegisterBits(uint16_t lBitMask) { BeginWrite(); mEventRegister.ClearBits(lBitMask); EndWrite(); }
+	inline void SetEventRegisterBits(uint16_t lBitMask) { BeginWrite(); mEventRegister.SetBits(lBitMask); EndWrite(); }
 	inline uint16_t GetEventRegister(void) { return mEventRegister.Get(); }
 
-	inline void ClearEventEnableRegister(void) { mEventEnableRegister.Clear(); }
-	inline void SetEventEnableRegister(uint16_t lEventEnableRegister) { mEventEnableRegister.Set(lEventEnableRegister); }
-	inline void ClearEventEnableRegisterBits(uint16_t lBitMask) { mEventEnableRegister.ClearBits(lBitMask); }
-	inline void SetEventEnableRegisterBits(uint16_t lBitMask) { mEventEnableRegister.SetBits(lBitMask); }
+	inline void ClearEventEnableRegister(void) { BeginWrite(); mEventEnableRegister.Clear(); EndWrite(); }
+	inline void SetEventEnableRegister(uint16_t lEventEnableRegister) { BeginWrite(); mEventEnableRegister.Set(lEventEnableRegister); EndWrite(); }
+	inline void ClearEventEnableRegisterBits(uint16_t lBitMask) { BeginWrite(); mEventEnableRegister.ClearBits(lBitMask); EndWrite(); }
+	inline void SetEventEnableRegisterBits(uint16_t lBitMask) { BeginWrite(); mEventEnableRegister.SetBits(lBitMask); EndWrite(); }
 	inline uint16_t GetEventEnableRegister(void) { return mEventEnableRegister.Get(); }
 
-	inline void ClearPositiveTransitionRegister(void) { mPositiveTransitionRegister.Clear(); }
-	inline void SetPositiveTransitionRegister(uint16_t lPositiveTransitionRegister) { mPositiveTransitionRegister.Set(lPositiveTransitionRegister); }
-	inline void ClearPositiveTransitionRegisterBits(uint16_t lBitMask) { mPositiveTransitionRegister.ClearBits(lBitMask); }
-	inline void SetPositiveTransitionRegisterBits(uint16_t lBitMask) { mPositiveTransitionRegister.SetBits(lBitMask); }
+	inline void ClearPositiveTransitionRegister(void) { BeginWrite(); mPositiveTransitionRegister.Clear(); EndWrite(); }
+	inline void SetPositiveTransitionRegister(uint16_t lPositiveTransitionRegister) { BeginWrite(); mPositiveTransitionRegister.Set(lPositiveTransitionRegister); EndWrite(); }
+	inline void ClearPositiveTransitionRegisterBits(uint16_t lBitMask) { BeginWrite(); mPositiveTransitionRegister.ClearBits(lBitMask); EndWrite(); }
+	inline void SetPositiveTransitionRegisterBits(uint16_t lBitMask) { BeginWrite(); mPositiveTransitionRegister.SetBits(lBitMask); EndWrite(); }
 	inline uint16_t GetPositiveTransitionRegister(void) { return mPositiveTransitionRegister.Get(); }
 
-	inline void ClearNegativeTransitionRegister(void) { mNegativeTransitionRegister.Clear(); }
-	inline void SetNegativeTransitionRegister(uint16_t lNegativeTransitionRegister) { mNegativeTransitionRegister.Set(lNegativeTransitionRegister); }
-	inline void ClearNegativeTransitionRegisterBits(uint16_t lBitMask) { mNegativeTransitionRegister.ClearBits(lBitMask); }
-	inline void SetNegativeTransitionRegisterBits(uint16_t lBitMask) { mNegativeTransitionRegister.SetBits(lBitMask); }
+	inline void ClearNegativeTransitionRegister(void) { BeginWrite(); mNegativeTransitionRegister.Clear(); EndWrite(); }
+	inline void SetNegativeTransitionRegister(uint16_t lNegativeTransitionRegister) { BeginWrite(); mNegativeTransitionRegister.Set(lNegativeTransitionRegister); EndWrite(); }
+	inline void ClearNegativeTransitionRegisterBits(uint16_t lBitMask) { BeginWrite(); mNegativeTransitionRegister.ClearBits(lBitMask); EndWrite(); }
+	inline void SetNegativeTransitionRegisterBits(uint16_t lBitMask) { BeginWrite(); mNegativeTransitionRegister.SetBits(lBitMask); EndWrite(); }
 	inline uint16_t GetNegativeTransitionRegister(void) { return mNegativeTransitionRegister.Get(); }
 
-	inline void ClearServiceRequestEnableRegister(void) { mServiceRequestEnableRegister.Clear(); }
-	inline void SetServiceRequestEnableRegister(uint16_t lServiceRequestEnableRegister) { mServiceRequestEnableRegister.Set(lServiceRequestEnableRegister); }
-	inline void ClearServiceRequestEnableRegisterBits(uint16_t lBitMask) { mServiceRequestEnableRegister.ClearBits(lBitMask); }
-	inline void SetServiceRequestEnableRegisterBits(uint16_t lBitMask) { mServiceRequestEnableRegister.SetBits(lBitMask); }
+	inline void ClearServiceRequestEnableRegister(void) { BeginWrite(); mServiceRequestEnableRegister.Clear(); EndWrite(); }
+	inline void SetServiceRequestEnableRegister(uint16_t lServiceRequestEnableRegister) { BeginWrite(); mServiceRequestEnableRegister.Set(lServiceRequestEnableRegister); EndWrite(); }
+	inline void ClearServiceRequestEnableRegisterBits(uint16_t lBitMask) { BeginWrite(); mServiceRequestEnableRegister.ClearBits(lBitMask); EndWrite(); }
+	inline void SetServiceRequestEnableRegisterBits(uint16_t lBitMask) { BeginWrite(); mServiceRequestEnableRegister.SetBits(lBitMask); EndWrite(); }
 	inline uint16_t GetServiceRequestEnableRegister(void) { return mServiceRequestEnableRegister.Get(); }
 
-	inline void ClearStatusByteRegister(void) { mStatusByteRegister.Clear(); }
-	inline void SetStatusByteRegister(uint16_t lStatusByteRegister) { mStatusByteRegister.Set(lStatusByteRegister); }
-	inline void ClearStatusByteRegisterBits(uint16_t lBitMask) { mStatusByteRegister.ClearBits(lBitMask); }
-	inline void SetStatusByteRegisterBits(uint16_t lBitMask) { mStatusByteRegister.SetBits(lBitMask); }
+	inline void ClearStatusByteRegister(void) { BeginWrite(); mStatusByteRegister.Clear(); EndWrite(); }
+	inline void SetStatusByteRegister(uint16_t lStatusByteRegister) { BeginWrite(); mStatusByteRegister.Set(lStatusByteRegister); EndWrite(); }
+	inline void ClearStatusByteRegisterBits(uint16_t lBitMask) { BeginWrite(); mStatusByteRegister.ClearBits(lBitMask); EndWrite(); }
+	inline void SetStatusByteRegisterBits(uint16_t lBitMask) { BeginWrite(); mStatusByteRegister.SetBits(lBitMask); EndWrite(); }
 	inline uint16_t GetStatusByteRegister(void) { return mStatusByteRegister.Get(); }
 };
 
@@ -197,7 +206,11 @@ namespace StatusModelApi
 	void ClearEventEnableRegister(StatusDataStructure& lStatus);
 	uint16_t GetEventEnableRegister(StatusDataStructure& lStatus);
 
+	uint16_t TakeEventRegister(StatusDataStructure& lStatus);
+
 	uint16_t Summarize(StatusDataStructure& lStatus);
+	uint8_t GetStatusByte(StatusDataStructure& lStatus);
+	uint8_t GetStatusByte(const StatusSnapshot& lSnapshot);
 }
 
 #endif /* PLATFORM_INC_STATUS_HPP_ */
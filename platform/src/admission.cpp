@@ -0,0 +1,177 @@
+/*
+ * admission.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include "admission.hpp"
+#include "binding.hpp"
+#include "scriptprocessor.hpp"
+
+static constexpr auto sAdmissionBinding = Bind<AdmissionTable>()
+	.Property<&AdmissionTable::GetMaxCommands, &AdmissionTable::SetMaxCommands>("maxcommands")
+	.Property<&AdmissionTable::GetMaxBytes, &AdmissionTable::SetMaxBytes>("maxbytes")
+	.Property<&AdmissionTable::GetRate, &AdmissionTable::SetRate>("rate")
+	.Property<&AdmissionTable::GetBurst, &AdmissionTable::SetBurst>("burst")
+	.Property<&AdmissionTable::IsHighPriority, &AdmissionTable::SetHighPriority>("priority")
+	.Property<&AdmissionTable::GetAccepted>("accepted")
+	.Property<&AdmissionTable::GetDeferred>("deferred")
+	.Property<&AdmissionTable::GetRejected>("rejected")
+	.Property<&AdmissionTable::GetQueueFull>("queuefull")
+	.Property<&AdmissionTable::GetBytesFull>("bytesfull")
+	.Property<&AdmissionTable::GetRateLimited>("ratelimited")
+	.Property<&AdmissionTable::GetReserveFull>("reservefull");
+
+void AdmissionInstall(lua_State *lState, ScriptProcessor *lScriptProcessor) {
+	static AdmissionTable sAdmissionTable(lScriptProcessor);
+
+	Lua lLua(lState);
+
+	PushBound<sAdmissionBinding>(lLua, &sAdmissionTable);
+	lLua.SetGlobal("admission");
+}
+
+AdmissionTable::AdmissionTable(ScriptProcessor *lScriptProcessor)
+: mScriptProcessor{lScriptProcessor}
+{
+}
+
+/*
+ * Only the script processor changes a session's limits once its interface is
+ * set up, so reading them, changing one and setting them back loses nothing.
+ */
+AdmissionLimits AdmissionTable::GetLimits(void) const
+{
+	return gSessionManager.GetLimits(mScriptProcessor->GetSession());
+}
+
+void AdmissionTable::SetLimits(const AdmissionLimits &lLimits)
+{
+	gSessionManager.SetLimits(mScriptProcessor->GetSession(), lLimits);
+}
+
+AdmissionCounters AdmissionTable::GetCounters(void) const
+{
+	return gSessionManager.GetCounters(mScriptProcessor->GetSession());
+}
+
+size_t AdmissionTable::GetMaxCommands(void) const
+{
+	return GetLimits().mMaxQueuedCommands;
+}
+
+const char *AdmissionTable::SetMaxCommands(size_t lCommands)
+{
+	if (!lCommands)
+	{
+		return "must be at least 1";
+	}
+
+	AdmissionLimits lLimits = GetLimits();
+	lLimits.mMaxQueuedCommands = lCommands;
+	SetLimits(lLimits);
+	return nullptr;
+}
+
+size_t AdmissionTable::GetMaxBytes(void) const
+{
+	return GetLimits().mMaxQueuedBytes;
+}
+
+const char *AdmissionTable::SetMaxBytes(size_t lBytes)
+{
+	if (!lBytes)
+	{
+		return "must be at least 1";
+	}
+
+	AdmissionLimits lLimits = GetLimits();
+	lLimits.mMaxQueuedBytes = lBytes;
+	SetLimits(lLimits);
+	return nullptr;
+}
+
+double AdmissionTable::GetRate(void) const
+{
+	return GetLimits().mRate;
+}
+
+const char *AdmissionTable::SetRate(double lRate)
+{
+	if (!(lRate >= 0.0))
+	{
+		return "must not be negative";
+	}
+
+	AdmissionLimits lLimits = GetLimits();
+	lLimits.mRate = lRate;
+	SetLimits(lLimits);
+	return nullptr;
+}
+
+double AdmissionTable::GetBurst(void) const
+{
+	return GetLimits().mBurst;
+}
+
+const char *AdmissionTable::SetBurst(double lBurst)
+{
+	if (!(lBurst >= 1.0))
+	{
+		return "must be at least 1";
+	}
+
+	AdmissionLimits lLimits = GetLimits();
+	lLimits.mBurst = lBurst;
+	SetLimits(lLimits);
+	return nullptr;
+}
+
+bool AdmissionTable::IsHighPriority(void) const
+{
+	return GetLimits().mHighPriority;
+}
+
+void AdmissionTable::SetHighPriority(bool lHighPriority)
+{
+	AdmissionLimits lLimits = GetLimits();
+	lLimits.mHighPriority = lHighPriority;
+	SetLimits(lLimits);
+}
+
+uint64_t AdmissionTable::GetAccepted(void) const
+{
+	return GetCounters().mAccepted;
+}
+
+uint64_t AdmissionTable::GetDeferred(void) const
+{
+	return GetCounters().mDeferred;
+}
+
+uint64_t AdmissionTable::GetRejected(void) const
+{
+	return GetCounters().mRejected;
+}
+
+uint64_t AdmissionTable::GetQueueFull(void) const
+{
+	return GetCounters().mQueueFull;
+}
+
+uint64_t AdmissionTable::GetBytesFull(void) const
+{
+	return GetCounters().mBytesFull;
+}
+
+uint64_t AdmissionTable::GetRateLimited(void) const
+{
+	return GetCounters().mRateLimited;
+}
+
+uint64_t AdmissionTable::GetReserveFull(void) const
+{
+	return GetCounters().mReserveFull;
+}
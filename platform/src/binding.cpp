@@ -0,0 +1,110 @@
+/*
+ * binding.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include "binding.hpp"
+
+#ifdef RUN_BINDING_BENCHMARK
+
+/*
+ * Property reads and writes through a MakeTableReadOnly() table with
+ * AddGetter/AddSetter and a switch on the function id, against the same
+ * property through a Binding.
+ */
+
+#include <chrono>
+#include <cstdio>
+
+constexpr int BENCHMARK_ITERATIONS = 1000000;
+
+class BenchmarkDevice
+{
+public:
+	int GetValue(void) const { return mValue; }
+	void SetValue(int lValue) { mValue = lValue; }
+
+private:
+	int mValue = 0;
+};
+
+enum BenchmarkFunctions {
+	FUNC_GET_VALUE = 0,
+	FUNC_SET_VALUE,
+};
+
+static int BenchmarkHandleMsg(lua_State *lState) {
+
+	int lRet = 0;
+
+	Lua lLua(lState);
+
+	BenchmarkDevice *lDevice = static_cast<BenchmarkDevice *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+	BenchmarkFunctions lFunc = static_cast<BenchmarkFunctions>(lLua.ToInteger(lLua.UpValueIndex(2)));
+
+	switch(lFunc) {
+	case FUNC_GET_VALUE:
+		lLua.PushInteger(lDevice->GetValue());
+		lRet = 1;
+		break;
+	case FUNC_SET_VALUE:
+		if(lLua.IsInteger(1)) {
+			lDevice->SetValue(lLua.ToInteger(1));
+		}
+		break;
+	}
+
+	return lRet;
+}
+
+static constexpr auto sBenchmarkBinding = Bind<BenchmarkDevice>()
+	.Property<&BenchmarkDevice::GetValue, &BenchmarkDevice::SetValue>("value");
+
+static const char sLoop[] =
+		"local d, n = ...\n"
+		"for i = 1, n do\n"
+		"	d.value = d.value + 1\n"
+		"end\n";
+
+// Nanoseconds per property access (two per iteration)
+static double Measure(Lua &lLua, const char *lGlobal) {
+	lLua.LoadString(sLoop);
+	lLua.GetGlobal(lGlobal);
+	lLua.PushInteger(BENCHMARK_ITERATIONS);
+
+	chrono::steady_clock::time_point lStart = chrono::steady_clock::now();
+	if(lLua.PCall(2, 0, 0) != LUA_OK) {
+		printf("Error: %s\n", lLua.ToString(-1));
+		lLua.Pop(1);
+		return 0.0;
+	}
+	chrono::duration<double, nano> lElapsed = chrono::steady_clock::now() - lStart;
+
+	return lElapsed.count() / (2.0 * BENCHMARK_ITERATIONS);
+}
+
+int main(void) {
+	Lua lLua;
+	BenchmarkDevice lSwitched;
+	BenchmarkDevice lBound;
+
+	lLua.NewTable();
+	lLua.MakeTableReadOnly();
+	LuaUtils::AddGetter(lLua, "value", &lSwitched, FUNC_GET_VALUE, BenchmarkHandleMsg);
+	LuaUtils::AddSetter(lLua, "value", &lSwitched, FUNC_SET_VALUE, BenchmarkHandleMsg);
+	lLua.SetGlobal("switched");
+
+	PushBound<sBenchmarkBinding>(lLua, &lBound);
+	lLua.SetGlobal("bound");
+
+	printf("AddGetter/AddSetter: %.1f ns per access\n", Measure(lLua, "switched"));
+	printf("Binding:             %.1f ns per access\n", Measure(lLua, "bound"));
+	printf("values: %d %d\n", lSwitched.GetValue(), lBound.GetValue());
+
+	return 0;
+}
+
+#endif // RUN_BINDING_BENCHMARK
@@ -0,0 +1,198 @@
+/*
+ * chunkcache.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include <cstring>
+
+#include "binding.hpp"
+#include "chunkcache.hpp"
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+static constexpr auto sChunkCacheBinding = Bind<ChunkCache>()
+	.Property<&ChunkCache::GetHits>("hits")
+	.Property<&ChunkCache::GetMisses>("misses")
+	.Property<&ChunkCache::GetEvictions>("evictions")
+	.Property<&ChunkCache::GetSize>("size")
+	.Property<&ChunkCache::GetCapacity, &ChunkCache::SetCapacity>("capacity")
+	.Method<static_cast<void (ChunkCache::*)(Lua &)>(&ChunkCache::Invalidate)>("clear");
+
+void ChunkCacheInstall(lua_State *lState, ChunkCache *lCache) {
+	Lua lLua(lState);
+
+	PushBound<sChunkCacheBinding>(lLua, lCache);
+	lLua.SetGlobal("chunkcache");
+}
+
+ChunkCache::ChunkCache(size_t lCapacity)
+: mCapacity{lCapacity}
+, mGlobals{nullptr}
+, mHits{0}
+, mMisses{0}
+, mEvictions{0}
+{
+}
+
+/*
+ * FNV-1a over the environment's address and then the text; only used to find
+ * the entry, both are compared on a hit.
+ */
+uint64_t ChunkCache::Hash(const char *lText, size_t lLength, const void *lEnvironment)
+{
+	uint64_t lHash = FNV_OFFSET_BASIS;
+	uintptr_t lAddress = reinterpret_cast<uintptr_t>(lEnvironment);
+
+	for (size_t lIndex = 0; lIndex < sizeof(lAddress); lIndex++)
+	{
+		lHash ^= (lAddress >> (lIndex * 8)) & 0xff;
+		lHash *= FNV_PRIME;
+	}
+
+	for (size_t lIndex = 0; lIndex < lLength; lIndex++)
+	{
+		lHash ^= static_cast<unsigned char>(lText[lIndex]);
+		lHash *= FNV_PRIME;
+	}
+
+	return lHash;
+}
+
+int ChunkCache::Load(Lua &lLua, const char *lText, size_t lLength, const char *lName, int lEnvironment)
+{
+	if (lEnvironment)
+	{
+		lEnvironment = lLua.AbsIndex(lEnvironment);
+	}
+
+	if (!mCapacity || lLength > CHUNK_CACHE_MAX_TEXT_LENGTH)
+	{
+		return Compile(lLua, lText, lLength, lName, lEnvironment);
+	}
+
+	CheckGlobals(lLua);
+
+	const void *lEnvironmentPointer = lEnvironment ? lLua.ToPointer(lEnvironment) : nullptr;
+	uint64_t lHash = Hash(lText, lLength, lEnvironmentPointer);
+	auto lFound = mIndex.find(lHash);
+
+	if (lFound != mIndex.end())
+	{
+		list<Entry>::iterator lEntry = lFound->second;
+
+		if (lEntry->mEnvironment == lEnvironmentPointer && lEntry->mText.length() == lLength
+				&& !memcmp(lEntry->mText.data(), lText, lLength))
+		{
+			mHits++;
+			mEntries.splice(mEntries.begin(), mEntries, lEntry);
+			lLua.RawGetI(LUA_REGISTRYINDEX, lEntry->mReference);
+			return LUA_OK;
+		}
+
+		// Hash collision; the newer text takes the slot
+		Remove(lLua, lEntry);
+	}
+
+	mMisses++;
+
+	int lResult = Compile(lLua, lText, lLength, lName, lEnvironment);
+	if (lResult != LUA_OK)
+	{
+		return lResult;
+	}
+
+	if (mEntries.size() >= mCapacity)
+	{
+		Evict(lLua);
+	}
+
+	// Stack: (top down) * chunk
+	lLua.PushValue(-1);
+	int lReference = lLua.Ref(LUA_REGISTRYINDEX);
+
+	mEntries.push_front(Entry{lHash, lEnvironmentPointer, string(lText, lLength), lReference});
+	mIndex[lHash] = mEntries.begin();
+
+	return LUA_OK;
+}
+
+void ChunkCache::Invalidate(Lua &lLua)
+{
+	while (!mEntries.empty())
+	{
+		Remove(lLua, mEntries.begin());
+	}
+}
+
+void ChunkCache::Invalidate(Lua &lLua, const void *lEnvironment)
+{
+	list<Entry>::iterator lEntry = mEntries.begin();
+
+	while (lEntry != mEntries.end())
+	{
+		list<Entry>::iterator lNext = next(lEntry);
+		if (lEntry->mEnvironment == lEnvironment)
+		{
+			Remove(lLua, lEntry);
+		}
+		lEntry = lNext;
+	}
+}
+
+void ChunkCache::SetCapacity(Lua &lLua, size_t lCapacity)
+{
+	mCapacity = lCapacity;
+
+	while (mEntries.size() > mCapacity)
+	{
+		Evict(lLua);
+	}
+}
+
+int ChunkCache::Compile(Lua &lLua, const char *lText, size_t lLength, const char *lName, int lEnvironment)
+{
+	int lResult = lLua.LoadBuffer(lText, lLength, lName);
+
+	if (lResult == LUA_OK && lEnvironment)
+	{
+		// The main chunk's only upvalue is _ENV
+		lLua.PushValue(lEnvironment);
+		lLua.SetUpValue(-2, 1);
+	}
+
+	return lResult;
+}
+
+void ChunkCache::Evict(Lua &lLua)
+{
+	Remove(lLua, prev(mEntries.end()));
+	mEvictions++;
+}
+
+void ChunkCache::Remove(Lua &lLua, list<Entry>::iterator lEntry)
+{
+	lLua.Unref(LUA_REGISTRYINDEX, lEntry->mReference);
+	mIndex.erase(lEntry->mHash);
+	mEntries.erase(lEntry);
+}
+
+/*
+ * Every chunk's _ENV is the global table it was loaded against. When the
+ * global environment has been replaced since, none of them can be reused.
+ */
+void ChunkCache::CheckGlobals(Lua &lLua)
+{
+	lLua.RawGetI(LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+	const void *lGlobals = lLua.ToPointer(-1);
+	lLua.Pop(1);
+
+	if (lGlobals != mGlobals)
+	{
+		Invalidate(lLua);
+		mGlobals = lGlobals;
+	}
+}
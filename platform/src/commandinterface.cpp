@@ -7,11 +7,34 @@
 
 #include "commandinterface.hpp"
 
-CommandInterface::CommandInterface(size_t lQueueCapacity)
-: mQueue(lQueueCapacity)
+CommandInterface::CommandInterface(size_t lQueueCapacity, const char *lName, unsigned int lWeight)
+: mSession(this, lName, lQueueCapacity, lWeight)
+, mRegistered{true}
 {
+	gSessionManager.Register(&mSession);
 }
 
 CommandInterface::~CommandInterface(void)
 {
+	Shutdown();
+}
+
+/*
+ * Unregister() waits while the script processor is executing one of the
+ * session's messages, and it sends the response before it lets go of the
+ * session, so nothing is delivered here afterwards.
+ */
+void CommandInterface::Shutdown(void)
+{
+	if (mRegistered)
+	{
+		gSessionManager.Unregister(&mSession);
+		mRegistered = false;
+	}
+
+	CommandMessage *lMessage;
+	while ((lMessage = TryReceive()))
+	{
+		delete lMessage;
+	}
 }
@@ -18,6 +18,7 @@ CommandMessage::CommandMessage(const char *lMessage, unsigned long lLength, void
 : mLength{lLength}
 , mOrigin{lOrigin}
 , mDestination{lDestination}
+, mTag{0}
 {
 	mMessage = new char [mLength + 1];
 	if (!mMessage)
@@ -45,6 +46,7 @@ CommandMessage::CommandMessage(CommandMessage& lOther)
 : mLength{lOther.GetLength()}
 , mOrigin{lOther.GetOrigin()}
 , mDestination{lOther.GetDestination()}
+, mTag{lOther.GetTag()}
 {
 	mMessage = new char [mLength + 1];
 	memcpy(mMessage, lOther.mMessage, mLength);
@@ -56,7 +58,8 @@ CommandMessage& CommandMessage::operator=(CommandMessage& lOther)
 	mLength = lOther.GetLength();
 	mOrigin = lOther.GetOrigin();
 	mDestination = lOther.GetDestination();
-	
+	mTag = lOther.GetTag();
+
 	mMessage = new char[mLength + 1];
 	if (!mMessage)
 	{
@@ -74,4 +77,5 @@ void CommandMessage::Swap(CommandMessage& lOther)
 	mLength = lOther.mLength;
 	mMessage = lOther.mMessage;
 	mOrigin = lOther.mOrigin;
+	mTag = lOther.mTag;
 }
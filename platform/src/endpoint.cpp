@@ -1,10 +1,15 @@
 
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 
+#include <unistd.h>
+
 #include "endpoint.hpp"
 
 Endpoint::Endpoint(void)
 : mMessageQueue(64)
+, mNotifyDescriptor{-1}
 {
     pthread_mutex_init(&mLock, nullptr);
     pthread_cond_init(&mCondition, nullptr);
@@ -27,12 +32,51 @@ CommandMessage *Endpoint::Receive(void)
     return lMessage;
 }
 
+CommandMessage *Endpoint::TryReceive(void)
+{
+    CommandMessage *lMessage = static_cast<CommandMessage *>(nullptr);
+    Lock();
+    if (!mMessageQueue.IsEmpty())
+    {
+        lMessage = mMessageQueue.Get();
+    }
+    Unlock();
+    return lMessage;
+}
+
 int Endpoint::Send(CommandMessage *lMessage)
 {
     Endpoint *lDestination = reinterpret_cast<Endpoint *>(lMessage->GetDestination());
-    lDestination->Lock();
-    lDestination->mMessageQueue.Put(lMessage);
-    lDestination->Post();
-    lDestination->Unlock();
+    return lDestination->Deliver(lMessage);
+}
+
+int Endpoint::Deliver(CommandMessage *lMessage)
+{
+    Lock();
+    if (mMessageQueue.IsFull())
+    {
+        // The caller keeps ownership of the message and may retry later
+        Unlock();
+        return -1;
+    }
+    mMessageQueue.Put(lMessage);
+    Post();
+    Unlock();
+    Notify();
     return 0;
 }
+
+void Endpoint::Notify(void)
+{
+    int lFileDescriptor = mNotifyDescriptor;
+    if (lFileDescriptor < 0)
+    {
+        return;
+    }
+
+    uint64_t lCount = 1;
+    if (write(lFileDescriptor, &lCount, sizeof(lCount)) < 0)
+    {
+        perror("could not notify endpoint");
+    }
+}
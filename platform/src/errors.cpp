@@ -10,6 +10,7 @@
 #include <cstring>
 
 #include "errors.hpp"
+#include "rot.hpp"
 
 
 ErrorController SystemErrors::gErrorController;
@@ -29,11 +30,8 @@ const Error cSystemErrors[SystemErrors::END_SYSTEM_ERRORS - 1] = {
 void ErrorsInstall(lua_State *lState) {
 	Lua lLua(lState);
 
-	// MakeTable
-	lLua.NewTable();
-	lLua.MakeTableReadOnly();
-
-	LuaUtils::AddClosure(lLua, "next", &SystemErrors::gErrorController, ErrorController::FuncNext);
+	PushReadOnlyObject(lLua, cRotNoProperties, nullptr);
+	AddReadOnlyMethod(lLua, "next", &SystemErrors::gErrorController, ErrorController::FuncNext);
 
 	lLua.SetGlobal("errors");
 }
@@ -49,6 +47,50 @@ void Error::ClearMessage(void) {
 	memset(mMessageBuffer, 0, cMaxErrorMessageLength);
 }
 
+/*
+ * A full queue keeps its oldest errors and replaces the newest one with
+ * "Queue overflow" (IEEE 488.2 21.8.2), until the queue has been drained.
+ */
+void ErrorController::Push(Error lError) {
+	std::lock_guard<std::mutex> lGuard(mLock);
+
+	if(mQueue.size() < cMaxQueueLength) {
+		mQueue.push(lError);
+		mOverflowed = false;
+		return;
+	}
+
+	if(!mOverflowed) {
+		mQueue.back() = Error(ScpiErrors::QUEUE_OVERFLOW, ScpiErrors::cQueueOverflowMessage,
+				strlen(ScpiErrors::cQueueOverflowMessage));
+		mOverflowed = true;
+	}
+}
+
+/*
+ * Remove and return the oldest error in one step, so two readers cannot both
+ * get the same one.
+ */
+bool ErrorController::Take(Error &lError) {
+	std::lock_guard<std::mutex> lGuard(mLock);
+
+	if(mQueue.empty()) {
+		return false;
+	}
+
+	lError = mQueue.front();
+	mQueue.pop();
+	mOverflowed = false;
+	return true;
+}
+
+void ErrorController::Clear(void) {
+	std::lock_guard<std::mutex> lGuard(mLock);
+
+	mQueue = std::queue<Error>();
+	mOverflowed = false;
+}
+
 int ErrorController::HandleMsg(lua_State *lState) {
 	Lua lLua(lState);
 
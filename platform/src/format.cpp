@@ -0,0 +1,83 @@
+/*
+ * format.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include "binding.hpp"
+#include "format.hpp"
+#include "scriptprocessor.hpp"
+
+static constexpr auto sFormatBinding = Bind<FormatTable>()
+	.Property<&FormatTable::GetAsciiPrecision, &FormatTable::SetAsciiPrecision>("asciiprecision")
+	.Property<&FormatTable::GetDataFormat, &FormatTable::SetDataFormat>("data")
+	.Property<&FormatTable::GetByteOrder, &FormatTable::SetByteOrder>("byteorder");
+
+void FormatInstall(lua_State *lState, ScriptProcessor *lScriptProcessor) {
+	static FormatTable sFormatTable(lScriptProcessor);
+
+	Lua lLua(lState);
+
+	PushBound<sFormatBinding>(lLua, &sFormatTable);
+	AddReadOnlyConstant(lLua, "ASCII", DATA_ASCII);
+	AddReadOnlyConstant(lLua, "REAL32", DATA_REAL32);
+	AddReadOnlyConstant(lLua, "REAL64", DATA_REAL64);
+	AddReadOnlyConstant(lLua, "NORMAL", BYTE_ORDER_NORMAL);
+	AddReadOnlyConstant(lLua, "SWAPPED", BYTE_ORDER_SWAPPED);
+
+	lLua.SetGlobal("format");
+}
+
+FormatTable::FormatTable(ScriptProcessor *lScriptProcessor)
+: mScriptProcessor{lScriptProcessor}
+{
+}
+
+ResponseWriter &FormatTable::GetResponse(void) const
+{
+	return mScriptProcessor->GetSession()->GetResponse();
+}
+
+unsigned int FormatTable::GetAsciiPrecision(void) const
+{
+	return GetResponse().GetAsciiPrecision();
+}
+
+const char *FormatTable::SetAsciiPrecision(unsigned int lPrecision)
+{
+	return GetResponse().SetAsciiPrecision(lPrecision) ? nullptr : "precision must be 0 to 17";
+}
+
+DataFormat FormatTable::GetDataFormat(void) const
+{
+	return GetResponse().GetDataFormat();
+}
+
+const char *FormatTable::SetDataFormat(DataFormat lFormat)
+{
+	if (lFormat != DATA_ASCII && lFormat != DATA_REAL32 && lFormat != DATA_REAL64)
+	{
+		return "expected format.ASCII, format.REAL32 or format.REAL64";
+	}
+
+	GetResponse().SetDataFormat(lFormat);
+	return nullptr;
+}
+
+ByteOrder FormatTable::GetByteOrder(void) const
+{
+	return GetResponse().GetByteOrder();
+}
+
+const char *FormatTable::SetByteOrder(ByteOrder lOrder)
+{
+	if (lOrder != BYTE_ORDER_NORMAL && lOrder != BYTE_ORDER_SWAPPED)
+	{
+		return "expected format.NORMAL or format.SWAPPED";
+	}
+
+	GetResponse().SetByteOrder(lOrder);
+	return nullptr;
+}
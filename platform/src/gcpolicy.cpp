@@ -0,0 +1,263 @@
+/*
+ * gcpolicy.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include <cmath>
+
+#include "binding.hpp"
+#include "gcpolicy.hpp"
+#include "session.hpp"
+
+static constexpr auto sGcPolicyBinding = Bind<GcPolicy>()
+	.Property<&GcPolicy::GetMode, &GcPolicy::SetMode>("mode")
+	.Property<&GcPolicy::GetPause, &GcPolicy::SetPause>("pause")
+	.Property<&GcPolicy::GetStepMultiplier, &GcPolicy::SetStepMultiplier>("stepmul")
+	.Property<&GcPolicy::GetStepSize, &GcPolicy::SetStepSize>("stepsize")
+	.Property<&GcPolicy::GetMinorMultiplier, &GcPolicy::SetMinorMultiplier>("minormul")
+	.Property<&GcPolicy::GetMajorMultiplier, &GcPolicy::SetMajorMultiplier>("majormul")
+	.Property<&GcPolicy::GetIdleStep, &GcPolicy::SetIdleStep>("idlestep")
+	.Property<&GcPolicy::GetBetweenCommands, &GcPolicy::SetBetweenCommands>("betweencommands")
+	.Property<&GcPolicy::GetSteps>("steps")
+	.Property<&GcPolicy::GetCycles>("cycles");
+
+void GcPolicyInstall(lua_State *lState, GcPolicy *lPolicy) {
+	Lua lLua(lState);
+
+	PushBound<sGcPolicyBinding>(lLua, lPolicy);
+	AddReadOnlyMethod(lLua, "histogram", lPolicy, GcPolicy::FuncHistogram);
+	AddReadOnlyMethod(lLua, "critical", lPolicy, GcPolicy::FuncCritical);
+	AddReadOnlyConstant(lLua, "INCREMENTAL", GC_MODE_INCREMENTAL);
+	AddReadOnlyConstant(lLua, "GENERATIONAL", GC_MODE_GENERATIONAL);
+
+	lLua.SetGlobal("collector");
+}
+
+GcPolicy::GcPolicy(void)
+: mMode{GC_MODE_INCREMENTAL}
+, mPause{GC_DEFAULT_PAUSE}
+, mStepMultiplier{GC_DEFAULT_STEP_MULTIPLIER}
+, mStepSize{GC_DEFAULT_STEP_SIZE}
+, mMinorMultiplier{GC_DEFAULT_MINOR_MULTIPLIER}
+, mMajorMultiplier{GC_DEFAULT_MAJOR_MULTIPLIER}
+, mIdleStep{GC_DEFAULT_IDLE_STEP}
+, mBetweenCommands{false}
+, mHoldDepth{0}
+, mIdleCount{0}
+, mSteps{0}
+, mCycles{0}
+, mPauses{}
+{
+}
+
+void GcPolicy::Apply(Lua &lLua)
+{
+	if (mMode == GC_MODE_GENERATIONAL)
+	{
+		lLua.Gc(LUA_GCGEN, mMinorMultiplier, mMajorMultiplier);
+	}
+	else
+	{
+		lLua.Gc(LUA_GCINC, mPause, mStepMultiplier, mStepSize);
+	}
+}
+
+/*
+ * Called by the script processor before it waits for input. Takes steps
+ * until a cycle is done or input turns up, skipping the whole thing when the
+ * heap has not grown since the last idle cycle finished.
+ */
+void GcPolicy::Idle(Lua &lLua)
+{
+	if (!mIdleStep || lLua.Gc(LUA_GCCOUNT) <= mIdleCount)
+	{
+		return;
+	}
+
+	for (unsigned int lStep = 0; lStep < GC_IDLE_MAX_STEPS && !gSessionManager.HasPendingInput(); lStep++)
+	{
+		if (Step(lLua))
+		{
+			mIdleCount = lLua.Gc(LUA_GCCOUNT);
+			break;
+		}
+	}
+}
+
+bool GcPolicy::Step(Lua &lLua)
+{
+	chrono::steady_clock::time_point lStart = chrono::steady_clock::now();
+	bool lFinished = lLua.Gc(LUA_GCSTEP, mIdleStep) != 0;
+	chrono::steady_clock::duration lPause = chrono::steady_clock::now() - lStart;
+
+	size_t lBucket = 0;
+	while (lBucket < GC_PAUSE_LIMITS.size() && lPause > GC_PAUSE_LIMITS[lBucket])
+	{
+		lBucket++;
+	}
+
+	mPauses[lBucket]++;
+	mSteps++;
+	mCycles += lFinished;
+
+	return lFinished;
+}
+
+void GcPolicy::Hold(Lua &lLua)
+{
+	if (!mHoldDepth++)
+	{
+		lLua.Gc(LUA_GCSTOP);
+	}
+}
+
+void GcPolicy::Release(Lua &lLua)
+{
+	if (!--mHoldDepth)
+	{
+		lLua.Gc(LUA_GCRESTART);
+	}
+}
+
+static bool IsParameter(int lValue) {
+	return lValue >= 0 && lValue <= 1000;
+}
+
+const char *GcPolicy::SetMode(Lua &lLua, GcMode lMode)
+{
+	if (lMode != GC_MODE_INCREMENTAL && lMode != GC_MODE_GENERATIONAL)
+	{
+		return "expected collector.INCREMENTAL or collector.GENERATIONAL";
+	}
+
+	mMode = lMode;
+	Apply(lLua);
+	return nullptr;
+}
+
+const char *GcPolicy::SetPause(Lua &lLua, int lPause)
+{
+	if (!IsParameter(lPause))
+	{
+		return "parameter must be 0 to 1000";
+	}
+
+	mPause = lPause;
+	Apply(lLua);
+	return nullptr;
+}
+
+const char *GcPolicy::SetStepMultiplier(Lua &lLua, int lMultiplier)
+{
+	if (!IsParameter(lMultiplier))
+	{
+		return "parameter must be 0 to 1000";
+	}
+
+	mStepMultiplier = lMultiplier;
+	Apply(lLua);
+	return nullptr;
+}
+
+const char *GcPolicy::SetStepSize(Lua &lLua, int lSize)
+{
+	if (lSize < 0 || lSize > 40)
+	{
+		return "step size must be 0 to 40";
+	}
+
+	mStepSize = lSize;
+	Apply(lLua);
+	return nullptr;
+}
+
+const char *GcPolicy::SetMinorMultiplier(Lua &lLua, int lMultiplier)
+{
+	if (!IsParameter(lMultiplier))
+	{
+		return "parameter must be 0 to 1000";
+	}
+
+	mMinorMultiplier = lMultiplier;
+	Apply(lLua);
+	return nullptr;
+}
+
+const char *GcPolicy::SetMajorMultiplier(Lua &lLua, int lMultiplier)
+{
+	if (!IsParameter(lMultiplier))
+	{
+		return "parameter must be 0 to 1000";
+	}
+
+	mMajorMultiplier = lMultiplier;
+	Apply(lLua);
+	return nullptr;
+}
+
+const char *GcPolicy::SetIdleStep(int lStep)
+{
+	if (lStep < 0 || lStep > 1024 * 1024)
+	{
+		return "idle step must be 0 to 1048576 KiB";
+	}
+
+	mIdleStep = lStep;
+	return nullptr;
+}
+
+int GcPolicy::FuncHistogram(lua_State *lState) {
+	Lua lLua(lState);
+
+	GcPolicy *lPolicy = static_cast<GcPolicy *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+	const array<uint64_t, GC_PAUSE_BUCKETS> &lPauses = lPolicy->GetPauses();
+
+	lLua.CreateTable(lPauses.size(), 0);
+	for (size_t lBucket = 0; lBucket < lPauses.size(); lBucket++)
+	{
+		lLua.CreateTable(2, 0);
+		if (lBucket < GC_PAUSE_LIMITS.size())
+		{
+			lLua.PushInteger(GC_PAUSE_LIMITS[lBucket].count());
+		}
+		else
+		{
+			lLua.PushNumber(HUGE_VAL);
+		}
+		lLua.RawSetI(-2, 1);
+		lLua.PushInteger(lPauses[lBucket]);
+		lLua.RawSetI(-2, 2);
+		lLua.RawSetI(-2, lBucket + 1);
+	}
+
+	return 1;
+}
+
+/*
+ * collector.critical(f, ...): runs in C, so f cannot yield; delay() sleeps
+ * and the script is not preempted until it returns. Errors are passed on
+ * once collection is released again.
+ */
+int GcPolicy::FuncCritical(lua_State *lState) {
+	Lua lLua(lState);
+
+	GcPolicy *lPolicy = static_cast<GcPolicy *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+	lLua.CheckType(1, LUA_TFUNCTION);
+
+	int lResult;
+	{
+		GcCriticalSection lCritical(*lPolicy, lLua);
+		lResult = lLua.PCall(lLua.GetTop() - 1, LUA_MULTRET, 0);
+	}
+
+	if (lResult != LUA_OK)
+	{
+		return lLua.Error();
+	}
+
+	return lLua.GetTop();
+}
@@ -11,30 +11,42 @@
 #include "lua.hpp"
 #include "scriptprocessor.hpp"
 
-// static const char sMakeReadOnlyTableKey[] = "MakeReadOnlyTable";
-static const char sMakeReadOnlyTable[] =
-		"	return function(t)"
-		"		local mt = { Objects = {}, Setters = {}, Getters = {} }"
-		"		mt.__metatable = mt"
-		"		mt.__index = 	function(t, k)"
-		"							local g = mt.Getters[k]"
-		"							if(g) then"
-		"								return g()"
-		"							else"
-		"								return mt.Objects[k]"
-		"							end"
-		"						end"
-		"		mt.__newindex = function(t, k, v)"
-		"							local s = mt.Setters[k]"
-		"							if(s) then"
-		"								return s(v)"
-		"							else"
-		"								error([[cannot modify read-only table]], 2)"
-		"							end"
-		"						end"
-		"		setmetatable(t, mt)"
-		"		return t"
-		"	end";
+/*
+ * Read-only tables made by MakeTableReadOnly() keep what scripts may reach in
+ * the Getters, Setters and Objects tables of their metatable. The metamethods
+ * hold those tables as upvalues.
+ *
+ * __index(t, k): Getters[k]() or else Objects[k]
+ */
+static int RotTableIndex(lua_State *lState) {
+	Lua lLua(lState);
+
+	lLua.PushValue(2);
+	if(lLua.RawGet(lLua.UpValueIndex(1)) != LUA_TNIL) {
+		lLua.Call(0, 1);
+		return 1;
+	}
+	lLua.Pop(1);
+
+	lLua.PushValue(2);
+	lLua.RawGet(lLua.UpValueIndex(2));
+	return 1;
+}
+
+/*
+ * __newindex(t, k, v): Setters[k](v)
+ */
+static int RotTableNewIndex(lua_State *lState) {
+	Lua lLua(lState);
+
+	lLua.PushValue(2);
+	if(lLua.RawGet(lLua.UpValueIndex(1)) == LUA_TNIL) {
+		return luaL_error(lState, "cannot modify read-only table");
+	}
+	lLua.PushValue(3);
+	lLua.Call(1, 0);
+	return 0;
+}
 
 static const char sInstance[] = "Instance";
 static const char sBackdoor[] = "Backdoor";
@@ -45,8 +57,54 @@ Lua::Lua(void) : BasicLua() {
 #else
 Lua::Lua(void) {
 #endif
-	InstallRotConstructor();
+	Init();
+}
+
+/*
+ * A state on a custom allocator. luaL_newstate() would also have installed
+ * lauxlib's panic and warning functions, so those are set up here.
+ */
+Lua::Lua(lua_Alloc lAlloc, void *lUd) : BasicLua(lAlloc, lUd) {
+	AtPanic(Panic);
+	SetWarnF(Warn, mState);
+
+	Init();
+}
+
+int Lua::Panic(lua_State *lState) {
+	const char *lMessage = lua_tostring(lState, -1);
+
+	fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lMessage ? lMessage : "error object is not a string");
+	return 0;	// abort()s
+}
+
+/*
+ * Warnings are off until "@on"; pieces of a message arrive with lToCont set
+ * until the last one.
+ */
+void Lua::Warn(void *lUd, const char *lMessage, int lToCont) {
+	static bool sOn = false;
+	static bool sContinued = false;
+
+	(void)lUd;
+
+	if (!sContinued && *lMessage == '@') {
+		if (!strcmp(lMessage, "@on")) {
+			sOn = true;
+		}
+		else if (!strcmp(lMessage, "@off")) {
+			sOn = false;
+		}
+		return;
+	}
+
+	if (sOn) {
+		fprintf(stderr, "%s%s%s", sContinued ? "" : "Lua warning: ", lMessage, lToCont ? "" : "\n");
+	}
+	sContinued = lToCont;
+}
 
+void Lua::Init(void) {
 	PushLightUserData(static_cast<void *>(const_cast<char *>(sInstance)));
 	PushLightUserData(reinterpret_cast<void *>(this));
 	SetTable(LUA_REGISTRYINDEX);
@@ -57,16 +115,47 @@ Lua::Lua(void) {
 }
 
 void Lua::MakeTableReadOnly(void) {
-	// Fetch the converter function
-	PushLightUserData(static_cast<void *>(const_cast<char *>(sMakeReadOnlyTable)));
 
-	GetTable(LUA_REGISTRYINDEX);
+	/*
+	 * Stack: (top down)
+	 * 		: * t
+	 */
+	NewTable();
+	PushValue(-1);
+	SetField(-2, "__metatable");
+	NewTable();
+	PushValue(-1);
+	SetField(-3, "Objects");
+	NewTable();
+	PushValue(-1);
+	SetField(-4, "Setters");
+	NewTable();
+	PushValue(-1);
+	SetField(-5, "Getters");
 
-	Insert(-2);
+	/*
+	 * Stack: (top down)
+	 * 		: * Getters Setters Objects mt t
+	 */
+	PushValue(-1);
+	PushValue(-4);
+	PushCClosure(RotTableIndex, 2);
+	SetField(-5, "__index");
+	Pop(1);
 
-	// Run the converter function
-	PCall(1, 1, 0);
+	/*
+	 * Stack: (top down)
+	 * 		: * Setters Objects mt t
+	 */
+	PushCClosure(RotTableNewIndex, 1);
+	SetField(-3, "__newindex");
+	Pop(1);
 
+	/*
+	 * Stack: (top down)
+	 * 		: * mt t
+	 */
+	SetMetaTable(-2);
 }
 
 void Lua::AddRotMetaObject(int lTableIndex, const char *lSubtableName) {
@@ -91,29 +180,6 @@ void Lua::AddRotMetaObject(int lTableIndex, const char *lSubtableName) {
 	Pop(1);
 }
 
-void Lua::InstallRotConstructor(void) {
-
-	PushLightUserData(static_cast<void *>(const_cast<char *>(sMakeReadOnlyTable)));
-
-	LoadBuffer(sMakeReadOnlyTable, sizeof(sMakeReadOnlyTable) - 1, "");	// * func() userdata
-
-	PCall(0, 1, 0);	// * func() userdata
-
-	/*
-	 * t[k] = v
-	 * t is the value at LUA_REGISTRYINDEX (the registry table)
-	 * k is the value just below the top of the stack
-	 * v is the value at the top of the stack
-	 *
-	 * t = the registry table
-	 * k = key for the converter function
-	 * v = converter function
-	 *
-	 * REGISTRYTABLE[sMakeReadOnlyTableKey] = converter_function
-	 */
-	SetTable(LUA_REGISTRYINDEX);
-}
-
 void Lua::GetBackdoor(void) {
 	PushLightUserData(static_cast<void *>(const_cast<char *>(sBackdoor)));
 
@@ -141,7 +207,7 @@ void Lua::DumpStack(void) {
 		printf("%d\t%s\t", i, TypeName(Type(i)));
 		switch (Type(i)) {
 		case LUA_TNUMBER:
-			printf("%d\n",ToNumber(i));
+			printf("%g\n",ToNumber(i));
 			break;
 		case LUA_TSTRING:
 			printf("%s\n",ToString(i));
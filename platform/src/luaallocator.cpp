@@ -0,0 +1,238 @@
+/*
+ * luaallocator.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include <cstdlib>
+#include <cstring>
+
+#include "binding.hpp"
+#include "luaallocator.hpp"
+#include "scriptprocessor.hpp"
+
+LuaAllocator gLuaAllocator;
+
+LuaAllocator::LuaAllocator(size_t lLimit)
+: mFree{}
+, mLimit{lLimit}
+, mInUse{0}
+, mPeak{0}
+, mFailures{0}
+, mAccount{nullptr}
+{
+}
+
+LuaAllocator::~LuaAllocator()
+{
+	for (void *lChunk : mChunks)
+	{
+		free(lChunk);
+	}
+}
+
+void *LuaAllocator::Allocate(void *lUserData, void *lBlock, size_t lOldSize, size_t lNewSize)
+{
+	return static_cast<LuaAllocator *>(lUserData)->Reallocate(lBlock, lOldSize, lNewSize);
+}
+
+/*
+ * lua_Alloc semantics: lOldSize is the block's size when lBlock is set (and an
+ * object type tag otherwise), lNewSize 0 frees it. Which pool a block belongs
+ * to follows from the size Lua reports for it, so nothing is stored with it.
+ */
+void *LuaAllocator::Reallocate(void *lBlock, size_t lOldSize, size_t lNewSize)
+{
+	if (!lBlock)
+	{
+		lOldSize = 0;
+	}
+
+	if (!lNewSize)
+	{
+		if (lBlock)
+		{
+			Delete(lBlock, lOldSize);
+			mInUse -= lOldSize;
+			if (mAccount)
+			{
+				mAccount->mFreed += lOldSize;
+			}
+		}
+		return nullptr;
+	}
+
+	if (lNewSize > lOldSize && mLimit && mInUse + (lNewSize - lOldSize) > mLimit)
+	{
+		mFailures++;
+		return nullptr;
+	}
+
+	void *lNewBlock;
+
+	if (!lBlock)
+	{
+		lNewBlock = New(lNewSize);
+	}
+	else if (IsPooled(lOldSize) && IsPooled(lNewSize) && GetClass(lOldSize) == GetClass(lNewSize))
+	{
+		lNewBlock = lBlock;
+	}
+	else if (!IsPooled(lOldSize) && !IsPooled(lNewSize))
+	{
+		lNewBlock = realloc(lBlock, lNewSize);
+	}
+	else
+	{
+		// Moving between a pool and malloc()
+		lNewBlock = New(lNewSize);
+		if (lNewBlock)
+		{
+			memcpy(lNewBlock, lBlock, min(lOldSize, lNewSize));
+			Delete(lBlock, lOldSize);
+		}
+	}
+
+	/*
+	 * Lua takes a shrink to always succeed, so the block stays where it is. A
+	 * malloc() block kept for a pooled size is big enough for its class and
+	 * simply joins that pool when it is freed.
+	 */
+	if (!lNewBlock && lNewSize <= lOldSize)
+	{
+		lNewBlock = lBlock;
+	}
+
+	if (!lNewBlock)
+	{
+		return nullptr;
+	}
+
+	if (lNewSize > lOldSize && mAccount)
+	{
+		mAccount->mAllocated += lNewSize - lOldSize;
+		mAccount->mAllocations += lBlock ? 0 : 1;
+	}
+	else if (lNewSize < lOldSize && mAccount)
+	{
+		mAccount->mFreed += lOldSize - lNewSize;
+	}
+
+	mInUse = mInUse - lOldSize + lNewSize;
+	if (mInUse > mPeak)
+	{
+		mPeak = mInUse;
+	}
+
+	return lNewBlock;
+}
+
+void *LuaAllocator::New(size_t lSize)
+{
+	if (!IsPooled(lSize))
+	{
+		return malloc(lSize);
+	}
+
+	return Take(GetClass(lSize));
+}
+
+void LuaAllocator::Delete(void *lBlock, size_t lSize)
+{
+	if (!IsPooled(lSize))
+	{
+		free(lBlock);
+	}
+	else
+	{
+		FreeBlock *lFreeBlock = static_cast<FreeBlock *>(lBlock);
+		size_t lClass = GetClass(lSize);
+
+		lFreeBlock->mNext = mFree[lClass];
+		mFree[lClass] = lFreeBlock;
+	}
+}
+
+void *LuaAllocator::Take(size_t lClass)
+{
+	if (!mFree[lClass] && !Refill(lClass))
+	{
+		return nullptr;
+	}
+
+	FreeBlock *lBlock = mFree[lClass];
+	mFree[lClass] = lBlock->mNext;
+
+	return lBlock;
+}
+
+/*
+ * Carves a new chunk into blocks of one size class.
+ */
+bool LuaAllocator::Refill(size_t lClass)
+{
+	size_t lBlockSize = (lClass + 1) * LUA_POOL_GRANULE;
+	char *lChunk = static_cast<char *>(malloc(LUA_POOL_CHUNK_SIZE));
+
+	if (!lChunk)
+	{
+		return false;
+	}
+
+	mChunks.push_back(lChunk);
+
+	for (size_t lOffset = 0; lOffset + lBlockSize <= LUA_POOL_CHUNK_SIZE; lOffset += lBlockSize)
+	{
+		FreeBlock *lFreeBlock = reinterpret_cast<FreeBlock *>(lChunk + lOffset);
+		lFreeBlock->mNext = mFree[lClass];
+		mFree[lClass] = lFreeBlock;
+	}
+
+	return true;
+}
+
+static constexpr auto sMemoryBinding = Bind<MemoryTable>()
+	.Property<&MemoryTable::GetInUse>("inuse")
+	.Property<&MemoryTable::GetPeak>("peak")
+	.Property<&MemoryTable::GetReserved>("reserved")
+	.Property<&MemoryTable::GetFailures>("failures")
+	.Property<&MemoryTable::GetLimit>("limit")
+	.Property<&MemoryTable::GetAllocated>("allocated")
+	.Property<&MemoryTable::GetAllocations>("allocations")
+	.Property<&MemoryTable::GetFreed>("freed");
+
+void MemoryInstall(lua_State *lState, ScriptProcessor *lScriptProcessor) {
+	static MemoryTable sMemoryTable(lScriptProcessor);
+
+	Lua lLua(lState);
+
+	PushBound<sMemoryBinding>(lLua, &sMemoryTable);
+	lLua.SetGlobal("memory");
+}
+
+MemoryTable::MemoryTable(ScriptProcessor *lScriptProcessor)
+: mScriptProcessor{lScriptProcessor}
+{
+}
+
+const MemoryAccount &MemoryTable::GetAccount(void) const
+{
+	return mScriptProcessor->GetLuaSession(mScriptProcessor->GetSession()).mMemory;
+}
+
+uint64_t MemoryTable::GetAllocated(void) const
+{
+	return GetAccount().mAllocated;
+}
+
+uint64_t MemoryTable::GetAllocations(void) const
+{
+	return GetAccount().mAllocations;
+}
+
+uint64_t MemoryTable::GetFreed(void) const
+{
+	return GetAccount().mFreed;
+}
@@ -0,0 +1,193 @@
+/*
+ * operations.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <algorithm>
+
+#include "binding.hpp"
+#include "operations.hpp"
+#include "scriptprocessor.hpp"
+#include "session.hpp"
+#include "status.hpp"
+
+OperationTracker gOperations;
+
+static int OperationsWait(lua_State *lState) {
+	Lua lLua(lState);
+
+	OperationTracker *lTracker = static_cast<OperationTracker *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+	if (lTracker->IsComplete()) {
+		return 0;
+	}
+
+	if (!gScriptProcessor->CanSuspend(lState)) {
+		return luaL_error(lState, "cannot wait for pending operations here");
+	}
+
+	return gScriptProcessor->Suspend(lState, chrono::steady_clock::time_point::max(),
+									 [lTracker] { return lTracker->IsComplete(); });
+}
+
+static constexpr auto sOperationsBinding = Bind<OperationTracker>()
+	.Property<&OperationTracker::GetPendingCount>("pending")
+	.Method<static_cast<uint64_t (OperationTracker::*)(const char *)>(&OperationTracker::Begin)>("begin")
+	.Method<&OperationTracker::BeginFor>("beginfor")
+	.Method<&OperationTracker::End>("finish");
+
+void OperationsInstall(lua_State *lState) {
+	Lua lLua(lState);
+
+	PushBound<sOperationsBinding>(lLua, &gOperations);
+	AddReadOnlyMethod(lLua, "wait", &gOperations, OperationsWait);
+
+	lLua.SetGlobal("operations");
+}
+
+OperationTracker::OperationTracker(void)
+: mNextId{1}
+, mOpcArmed{false}
+{
+}
+
+uint64_t OperationTracker::Begin(const char *lName)
+{
+	return Add(lName, false, chrono::steady_clock::time_point());
+}
+
+uint64_t OperationTracker::Begin(const char *lName, chrono::steady_clock::time_point lEnd)
+{
+	return Add(lName, true, lEnd);
+}
+
+uint64_t OperationTracker::BeginFor(int64_t lMicroseconds)
+{
+	return Begin("timed", chrono::steady_clock::now() + chrono::microseconds(max<int64_t>(lMicroseconds, 0)));
+}
+
+uint64_t OperationTracker::Add(const char *lName, bool lTimed, chrono::steady_clock::time_point lEnd)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	uint64_t lId = mNextId++;
+	mPending.push_back(Operation{ lId, lName ? lName : "", lTimed, lEnd });
+
+	return lId;
+}
+
+void OperationTracker::End(uint64_t lId)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	auto lIterator = find_if(mPending.begin(), mPending.end(),
+							 [lId](const Operation &lOperation) { return lOperation.mId == lId; });
+	if (lIterator == mPending.end())
+	{
+		return;
+	}
+
+	mPending.erase(lIterator);
+	if (mPending.empty())
+	{
+		Completed();
+	}
+}
+
+bool OperationTracker::IsComplete(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	Expire();
+	return mPending.empty();
+}
+
+size_t OperationTracker::GetPendingCount(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	Expire();
+	return mPending.size();
+}
+
+/*
+ * Earliest end of a timed operation, for the script processor to wake up at
+ */
+bool OperationTracker::GetNextEnd(chrono::steady_clock::time_point &lEnd)
+{
+	lock_guard<mutex> lGuard(mLock);
+	bool lFound = false;
+
+	for (const Operation &lOperation : mPending)
+	{
+		if (lOperation.mTimed)
+		{
+			lEnd = lFound ? min(lEnd, lOperation.mEnd) : lOperation.mEnd;
+			lFound = true;
+		}
+	}
+
+	return lFound;
+}
+
+// Ends the timed operations that are over
+void OperationTracker::Poll(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	Expire();
+}
+
+void OperationTracker::ArmOpc(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	Expire();
+	mOpcArmed = true;
+	if (mPending.empty())
+	{
+		Completed();
+	}
+}
+
+// *CLS and *RST (IEEE 488.2 - 12.5.3)
+void OperationTracker::DisarmOpc(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	mOpcArmed = false;
+}
+
+// Called with the lock held
+void OperationTracker::Expire(void)
+{
+	if (mPending.empty())
+	{
+		return;
+	}
+
+	chrono::steady_clock::time_point lNow = chrono::steady_clock::now();
+	erase_if(mPending, [lNow](const Operation &lOperation) { return lOperation.mTimed && lNow >= lOperation.mEnd; });
+
+	if (mPending.empty())
+	{
+		Completed();
+	}
+}
+
+/*
+ * Called with the lock held once nothing is pending. Sessions held up by
+ * *OPC? or *WAI are looked at straight away rather than at their next poll.
+ */
+void OperationTracker::Completed(void)
+{
+	if (mOpcArmed)
+	{
+		gPlatformStatus.SetEventRegisterBits(1 << OPC_BIT);
+		mOpcArmed = false;
+	}
+
+	gSessionManager.Wake();
+}
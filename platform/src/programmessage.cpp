@@ -0,0 +1,154 @@
+/*
+ * programmessage.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include <cstring>
+
+#include "programmessage.hpp"
+
+using namespace ProgramMessage;
+
+static bool IsDigit(char lChar)
+{
+	return lChar >= '0' && lChar <= '9';
+}
+
+// Program data starts after the header separator or a comma, never inside a header or a Lua expression
+static bool CanStartData(char lPrevious)
+{
+	return lPrevious == ' ' || lPrevious == '\t' || lPrevious == ',';
+}
+
+BlockType ProgramMessage::ParseBlockHeader(string_view lText, size_t &lHeaderLength, size_t &lPayloadLength)
+{
+	if (lText.length() < 2)
+	{
+		return INCOMPLETE_BLOCK;
+	}
+
+	if (lText[1] == '0')
+	{
+		lHeaderLength = 2;
+		return INDEFINITE_BLOCK;
+	}
+
+	if (!IsDigit(lText[1]))
+	{
+		// #H, #Q and #B are non-decimal numeric data
+		return NOT_A_BLOCK;
+	}
+
+	size_t lDigits = lText[1] - '0';
+	if (lText.length() < 2 + lDigits)
+	{
+		return INCOMPLETE_BLOCK;
+	}
+
+	size_t lLength = 0;
+	for (size_t lIndex = 2; lIndex < 2 + lDigits; lIndex++)
+	{
+		if (!IsDigit(lText[lIndex]))
+		{
+			return NOT_A_BLOCK;
+		}
+		lLength = lLength * 10 + (lText[lIndex] - '0');
+	}
+
+	lHeaderLength = 2 + lDigits;
+	lPayloadLength = lLength;
+	return DEFINITE_BLOCK;
+}
+
+Scanner::Scanner(void)
+: mPosition{0}
+, mQuote{0}
+, mPrevious{0}
+, mIndefinite{false}
+{
+}
+
+void Scanner::Reset(void)
+{
+	mPosition = 0;
+	mQuote = 0;
+	mPrevious = 0;
+	mIndefinite = false;
+}
+
+size_t Scanner::FindEnd(const char *lBuffer, size_t lLength, const string &lTerminators)
+{
+	while (mPosition < lLength)
+	{
+		char lChar = lBuffer[mPosition];
+
+		// Only a newline ends indefinite block data
+		if (mIndefinite)
+		{
+			const void *lNewline = memchr(lBuffer + mPosition, '\n', lLength - mPosition);
+			if (!lNewline)
+			{
+				mPosition = lLength;
+				return string::npos;
+			}
+			return static_cast<const char *>(lNewline) - lBuffer;
+		}
+
+		/*
+		 * A terminator ends the message even inside quotes: Lua chunks are
+		 * framed the same way and an apostrophe in a comment must not swallow
+		 * the rest of the stream. Quotes only keep '#' in a string from being
+		 * taken for a block.
+		 */
+		if (lTerminators.find(lChar) != string::npos)
+		{
+			return mPosition;
+		}
+
+		if (mQuote)
+		{
+			if (lChar == mQuote)
+			{
+				mQuote = 0;
+			}
+		}
+		else if (lChar == '"' || lChar == '\'')
+		{
+			mQuote = lChar;
+		}
+		else if (lChar == '#' && CanStartData(mPrevious))
+		{
+			size_t lHeaderLength;
+			size_t lPayloadLength;
+
+			switch (ParseBlockHeader(string_view(lBuffer + mPosition, lLength - mPosition), lHeaderLength, lPayloadLength))
+			{
+			case INCOMPLETE_BLOCK:
+				return string::npos;
+			case DEFINITE_BLOCK:
+				if (mPosition + lHeaderLength + lPayloadLength > lLength)
+				{
+					// Come back to the header once the whole block is here
+					return string::npos;
+				}
+				mPosition += lHeaderLength + lPayloadLength;
+				mPrevious = 0;
+				continue;
+			case INDEFINITE_BLOCK:
+				mIndefinite = true;
+				mPosition += lHeaderLength;
+				continue;
+			case NOT_A_BLOCK:
+				break;
+			}
+		}
+
+		mPrevious = lChar;
+		mPosition++;
+	}
+
+	return string::npos;
+}
@@ -0,0 +1,148 @@
+/*
+ * responsecache.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include "binding.hpp"
+#include "responsecache.hpp"
+
+ResponseCache gResponseCache;
+
+static constexpr auto sResponseCacheBinding = Bind<ResponseCache>()
+	.Property<&ResponseCache::GetHits>("hits")
+	.Property<&ResponseCache::GetSize>("size")
+	.Method<&ResponseCache::Declare>("declare")
+	.Method<&ResponseCache::Invalidate>("invalidate")
+	.Method<&ResponseCache::Clear>("clear");
+
+void ResponseCacheInstall(lua_State *lState) {
+	Lua lLua(lState);
+
+	PushBound<sResponseCacheBinding>(lLua, &gResponseCache);
+	lLua.SetGlobal("responsecache");
+}
+
+ResponseCache::ResponseCache(void)
+: mHits{0}
+{
+}
+
+// Program messages arrive with or without their terminator
+string_view ResponseCache::Normalize(const char *lText, size_t lLength)
+{
+	string_view lNormal(lText, lLength);
+	size_t lStart = lNormal.find_first_not_of(" \t\r\n");
+	if (lStart == string_view::npos)
+	{
+		return string_view();
+	}
+
+	return lNormal.substr(lStart, lNormal.find_last_not_of(" \t\r\n") - lStart + 1);
+}
+
+/*
+ * Called from the interface threads
+ */
+bool ResponseCache::Find(const char *lText, size_t lLength, string &lResponse)
+{
+	string_view lKey = Normalize(lText, lLength);
+	if (lKey.empty())
+	{
+		return false;
+	}
+
+	lock_guard<mutex> lGuard(mLock);
+
+	if (mEntries.empty())
+	{
+		return false;
+	}
+
+	auto lIterator = mEntries.find(string(lKey));
+	if (lIterator == mEntries.end())
+	{
+		return false;
+	}
+
+	lResponse = lIterator->second.mResponse;
+	mHits++;
+	return true;
+}
+
+void ResponseCache::Store(const char *lText, size_t lLength, const string &lResponse, const char *lKey)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	Add(Normalize(lText, lLength), lResponse, lKey ? lKey : "");
+}
+
+bool ResponseCache::Offer(const char *lText, size_t lLength, const string &lResponse)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	if (mDeclared.empty())
+	{
+		return false;
+	}
+
+	string lNormal(Normalize(lText, lLength));
+	auto lIterator = mDeclared.find(lNormal);
+	if (lIterator == mDeclared.end())
+	{
+		return false;
+	}
+
+	Add(lNormal, lResponse, lIterator->second);
+	return true;
+}
+
+// Called with the lock held. Once full, further responses are just not kept.
+void ResponseCache::Add(string_view lText, const string &lResponse, string_view lKey)
+{
+	if (lText.empty() || lResponse.empty() || mEntries.size() >= RESPONSE_CACHE_CAPACITY)
+	{
+		return;
+	}
+
+	mEntries.insert_or_assign(string(lText), Entry{ lResponse, string(lKey) });
+}
+
+void ResponseCache::Declare(const string &lText, const string &lKey)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	string lNormal(Normalize(lText.data(), lText.length()));
+	mDeclared[lNormal] = lKey;
+	mEntries.erase(lNormal);
+}
+
+void ResponseCache::Invalidate(const string &lKey)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	erase_if(mEntries, [&lKey](const auto &lEntry) { return lEntry.second.mKey == lKey; });
+}
+
+void ResponseCache::Clear(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	mEntries.clear();
+	mDeclared.clear();
+}
+
+uint64_t ResponseCache::GetHits(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	return mHits;
+}
+
+size_t ResponseCache::GetSize(void)
+{
+	lock_guard<mutex> lGuard(mLock);
+
+	return mEntries.size();
+}
@@ -0,0 +1,152 @@
+/*
+ * responsewriter.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "responsewriter.hpp"
+
+// Sign, 17 digits, point, exponent and then some
+constexpr size_t NUMBER_BUFFER_SIZE = 32;
+
+ResponseWriter::ResponseWriter(void)
+: mAsciiPrecision{ASCII_DEFAULT_PRECISION}
+, mDataFormat{DATA_ASCII}
+, mByteOrder{BYTE_ORDER_NORMAL}
+{
+	mBuffer.reserve(RESPONSE_INITIAL_CAPACITY);
+}
+
+void ResponseWriter::Clear(void)
+{
+	if (mBuffer.capacity() > RESPONSE_MAX_RETAINED_CAPACITY)
+	{
+		string().swap(mBuffer);
+		mBuffer.reserve(RESPONSE_INITIAL_CAPACITY);
+		return;
+	}
+
+	mBuffer.clear();
+}
+
+void ResponseWriter::Reset(void)
+{
+	mAsciiPrecision = ASCII_DEFAULT_PRECISION;
+	mDataFormat = DATA_ASCII;
+	mByteOrder = BYTE_ORDER_NORMAL;
+}
+
+bool ResponseWriter::SetAsciiPrecision(unsigned int lPrecision)
+{
+	if (lPrecision > ASCII_MAX_PRECISION)
+	{
+		return false;
+	}
+
+	mAsciiPrecision = lPrecision;
+	return true;
+}
+
+void ResponseWriter::Write(int64_t lValue)
+{
+	char lBuffer[NUMBER_BUFFER_SIZE];
+	to_chars_result lResult = to_chars(lBuffer, lBuffer + sizeof(lBuffer), lValue);
+	mBuffer.append(lBuffer, lResult.ptr - lBuffer);
+}
+
+void ResponseWriter::Write(double lValue)
+{
+	// IEEE 488.2 has no representation for these; use the SCPI conventions
+	if (isnan(lValue))
+	{
+		mBuffer.append("9.91e+37");
+		return;
+	}
+	if (isinf(lValue))
+	{
+		mBuffer.append(lValue > 0 ? "9.9e+37" : "-9.9e+37");
+		return;
+	}
+
+	char lBuffer[NUMBER_BUFFER_SIZE];
+	to_chars_result lResult;
+
+	if (mAsciiPrecision)
+	{
+		lResult = to_chars(lBuffer, lBuffer + sizeof(lBuffer), lValue, chars_format::scientific, mAsciiPrecision - 1);
+	}
+	else
+	{
+		lResult = to_chars(lBuffer, lBuffer + sizeof(lBuffer), lValue);
+	}
+
+	mBuffer.append(lBuffer, lResult.ptr - lBuffer);
+}
+
+/*
+ * #<number of length digits><length>, e.g. #3800 for 100 REAL64 values
+ */
+void ResponseWriter::BeginBlock(size_t lCount)
+{
+	char lLength[NUMBER_BUFFER_SIZE];
+	to_chars_result lResult = to_chars(lLength, lLength + sizeof(lLength), lCount * GetValueSize());
+	size_t lDigits = lResult.ptr - lLength;
+
+	mBuffer += '#';
+	mBuffer += static_cast<char>('0' + lDigits);
+	mBuffer.append(lLength, lDigits);
+}
+
+void ResponseWriter::WriteBlock(const double *lValues, size_t lCount)
+{
+	BeginBlock(lCount);
+
+	size_t lOffset = mBuffer.length();
+	mBuffer.resize(lOffset + lCount * GetValueSize());
+	Encode(&mBuffer[lOffset], lValues, lCount);
+}
+
+bool ResponseWriter::NeedsSwap(void) const
+{
+	return (mByteOrder == BYTE_ORDER_NORMAL) != (endian::native == endian::big);
+}
+
+/*
+ * Kept as plain fixed-size loops with memcpy so the compiler turns the
+ * conversion and byte swap into vector shuffles.
+ */
+void ResponseWriter::Encode(char *lDestination, const double *lValues, size_t lCount) const
+{
+	bool lSwap = NeedsSwap();
+
+	if (mDataFormat == DATA_REAL32)
+	{
+		for (size_t lIndex = 0; lIndex < lCount; lIndex++)
+		{
+			uint32_t lBits = bit_cast<uint32_t>(static_cast<float>(lValues[lIndex]));
+			if (lSwap)
+			{
+				lBits = __builtin_bswap32(lBits);
+			}
+			memcpy(lDestination + lIndex * sizeof(lBits), &lBits, sizeof(lBits));
+		}
+		return;
+	}
+
+	for (size_t lIndex = 0; lIndex < lCount; lIndex++)
+	{
+		uint64_t lBits = bit_cast<uint64_t>(lValues[lIndex]);
+		if (lSwap)
+		{
+			lBits = __builtin_bswap64(lBits);
+		}
+		memcpy(lDestination + lIndex * sizeof(lBits), &lBits, sizeof(lBits));
+	}
+}
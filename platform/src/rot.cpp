@@ -0,0 +1,142 @@
+/*
+ * rot.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include "rot.hpp"
+
+struct RotObject
+{
+	const RotLayout *mLayout;
+	void *mObject;
+};
+
+/*
+ * __index(object, key): a property's getter, or else a method
+ */
+static int RotIndex(lua_State *lState)
+{
+	Lua lLua(lState);
+
+	RotObject *lRot = static_cast<RotObject *>(lLua.ToUserData(1));
+
+	if (lLua.Type(2) == LUA_TSTRING)
+	{
+		size_t lLength;
+		const char *lName = lLua.ToLString(2, &lLength);
+		const RotProperty *lProperty = lRot->mLayout->Find(lName, lLength);
+
+		if (lProperty && lProperty->mGet)
+		{
+			return lProperty->mGet(lLua, lRot->mObject);
+		}
+	}
+
+	lLua.GetIUserValue(1, 1);
+	lLua.PushValue(2);
+	lLua.RawGet(-2);
+	return 1;
+}
+
+/*
+ * __newindex(object, key, value): a property's setter, or an error
+ */
+static int RotNewIndex(lua_State *lState)
+{
+	Lua lLua(lState);
+
+	RotObject *lRot = static_cast<RotObject *>(lLua.ToUserData(1));
+
+	if (lLua.Type(2) == LUA_TSTRING)
+	{
+		size_t lLength;
+		const char *lName = lLua.ToLString(2, &lLength);
+		const RotProperty *lProperty = lRot->mLayout->Find(lName, lLength);
+
+		if (lProperty && lProperty->mSet)
+		{
+			lProperty->mSet(lLua, lRot->mObject, 3);
+			return 0;
+		}
+	}
+
+	return luaL_error(lState, "cannot modify read-only table");
+}
+
+static int RotContinueCall(lua_State *lState, int lStatus, lua_KContext lContext)
+{
+	(void)lStatus;
+	(void)lContext;
+
+	return lua_gettop(lState);
+}
+
+/*
+ * __call(object, ...): the object's call function, if it has one. Called with
+ * lua_callk() so the function may still yield.
+ */
+static int RotCall(lua_State *lState)
+{
+	Lua lLua(lState);
+
+	if (lLua.GetIUserValue(1, 2) != LUA_TFUNCTION)
+	{
+		return luaL_error(lState, "attempt to call a read-only object");
+	}
+
+	lLua.Replace(1);
+	lLua.CallK(lLua.GetTop() - 1, LUA_MULTRET, 0, RotContinueCall);
+
+	return RotContinueCall(lState, LUA_OK, 0);
+}
+
+void PushReadOnlyObject(Lua &lLua, const RotLayout &lLayout, void *lObject)
+{
+	// User values: the methods and constants, and the call function
+	RotObject *lRot = static_cast<RotObject *>(lLua.NewUserDataUV(sizeof(RotObject), 2));
+	lRot->mLayout = &lLayout;
+	lRot->mObject = lObject;
+
+	lLua.NewTable();
+	lLua.SetIUserValue(-2, 1);
+
+	// Every read-only object shares one metatable, made the first time
+	if (lLua.NewMetaTable(ROT_METATABLE))
+	{
+		lLua.PushCClosure(RotIndex, 0);
+		lLua.SetField(-2, "__index");
+		lLua.PushCClosure(RotNewIndex, 0);
+		lLua.SetField(-2, "__newindex");
+		lLua.PushCClosure(RotCall, 0);
+		lLua.SetField(-2, "__call");
+		lLua.PushBoolean(false);
+		lLua.SetField(-2, "__metatable");
+	}
+	lLua.SetMetaTable(-2);
+}
+
+void AddReadOnlyMethod(Lua &lLua, const char *lName, void *lUpValue, lua_CFunction lFunc)
+{
+	lLua.GetIUserValue(-1, 1);
+	lLua.PushLightUserData(lUpValue);
+	lLua.PushCClosure(lFunc, 1);
+	lLua.SetField(-2, lName);
+	lLua.Pop(1);
+}
+
+void AddReadOnlyConstant(Lua &lLua, const char *lName, lua_Integer lValue)
+{
+	lLua.GetIUserValue(-1, 1);
+	lLua.PushInteger(lValue);
+	lLua.SetField(-2, lName);
+	lLua.Pop(1);
+}
+
+void SetReadOnlyCall(Lua &lLua, void *lUpValue, lua_CFunction lFunc)
+{
+	lLua.PushLightUserData(lUpValue);
+	lLua.PushCClosure(lFunc, 1);
+	lLua.SetIUserValue(-2, 2);
+}
@@ -0,0 +1,71 @@
+/*
+ * scheduler.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include "binding.hpp"
+#include "scheduler.hpp"
+#include "scriptprocessor.hpp"
+
+static constexpr auto sSchedulerBinding = Bind<SchedulerTable>()
+	.Property<&SchedulerTable::GetSliceInstructions, &SchedulerTable::SetSliceInstructions>("sliceinstructions")
+	.Property<&SchedulerTable::GetSliceTime, &SchedulerTable::SetSliceTime>("slicetime")
+	.Property<&SchedulerTable::GetScriptLimit, &SchedulerTable::SetScriptLimit>("scriptlimit")
+	.Property<&SchedulerTable::GetPreemptions>("preemptions");
+
+void SchedulerInstall(lua_State *lState, ScriptProcessor *lScriptProcessor) {
+	static SchedulerTable sSchedulerTable(lScriptProcessor);
+
+	Lua lLua(lState);
+
+	PushBound<sSchedulerBinding>(lLua, &sSchedulerTable);
+	lLua.SetGlobal("scheduler");
+}
+
+SchedulerTable::SchedulerTable(ScriptProcessor *lScriptProcessor)
+: mScriptProcessor{lScriptProcessor}
+{
+}
+
+ScriptBudget &SchedulerTable::GetBudget(void) const
+{
+	return mScriptProcessor->GetLuaSession(mScriptProcessor->GetSession()).mBudget;
+}
+
+uint64_t SchedulerTable::GetSliceInstructions(void) const
+{
+	return GetBudget().mSliceInstructions;
+}
+
+void SchedulerTable::SetSliceInstructions(uint64_t lInstructions)
+{
+	GetBudget().mSliceInstructions = lInstructions;
+}
+
+uint64_t SchedulerTable::GetSliceTime(void) const
+{
+	return GetBudget().mSliceTime.count();
+}
+
+void SchedulerTable::SetSliceTime(uint64_t lMicroseconds)
+{
+	GetBudget().mSliceTime = chrono::microseconds(lMicroseconds);
+}
+
+uint64_t SchedulerTable::GetScriptLimit(void) const
+{
+	return GetBudget().mScriptInstructions;
+}
+
+void SchedulerTable::SetScriptLimit(uint64_t lInstructions)
+{
+	GetBudget().mScriptInstructions = lInstructions;
+}
+
+uint64_t SchedulerTable::GetPreemptions(void) const
+{
+	return mScriptProcessor->GetLuaSession(mScriptProcessor->GetSession()).mPreemptions;
+}
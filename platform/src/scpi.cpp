@@ -0,0 +1,918 @@
+/*
+ * scpi.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "errors.hpp"
+#include "programmessage.hpp"
+#include "scpi.hpp"
+
+using namespace Scpi;
+
+static bool IsWhitespace(char lChar)
+{
+	return lChar == ' ' || lChar == '\t' || lChar == '\r' || lChar == '\n' || lChar == '\0';
+}
+
+static string_view TrimFront(string_view lText)
+{
+	while (!lText.empty() && IsWhitespace(lText.front()))
+	{
+		lText.remove_prefix(1);
+	}
+	return lText;
+}
+
+static string_view Trim(string_view lText)
+{
+	lText = TrimFront(lText);
+	while (!lText.empty() && IsWhitespace(lText.back()))
+	{
+		lText.remove_suffix(1);
+	}
+	return lText;
+}
+
+static bool IsHeaderCharacter(char lChar)
+{
+	return isalnum(static_cast<unsigned char>(lChar)) || lChar == '*' || lChar == ':' || lChar == '?' || lChar == '_';
+}
+
+/*
+ * Length of the arbitrary block at lIndex, 0 when there is none. An indefinite
+ * block, or a definite one cut short, runs to the end of lText.
+ */
+static size_t BlockLength(string_view lText, size_t lIndex)
+{
+	size_t lHeaderLength;
+	size_t lPayloadLength;
+
+	switch (ProgramMessage::ParseBlockHeader(lText.substr(lIndex), lHeaderLength, lPayloadLength))
+	{
+	case ProgramMessage::DEFINITE_BLOCK:
+		return min(lHeaderLength + lPayloadLength, lText.length() - lIndex);
+	case ProgramMessage::INDEFINITE_BLOCK:
+		return lText.length() - lIndex;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Find the first lSeparator that is not inside a quoted string or block data.
+ * Returns the length of lText when there is none.
+ */
+static size_t FindUnquoted(string_view lText, char lSeparator)
+{
+	char lQuote = 0;
+	for (size_t lIndex = 0; lIndex < lText.length(); lIndex++)
+	{
+		char lChar = lText[lIndex];
+		if (lQuote)
+		{
+			if (lChar == lQuote)
+			{
+				lQuote = 0;
+			}
+		}
+		else if (lChar == '"' || lChar == '\'')
+		{
+			lQuote = lChar;
+		}
+		else if (lChar == lSeparator)
+		{
+			return lIndex;
+		}
+		else if (lChar == '#')
+		{
+			size_t lBlockLength = BlockLength(lText, lIndex);
+			if (lBlockLength)
+			{
+				lIndex += lBlockLength - 1;
+			}
+		}
+	}
+	return lText.length();
+}
+
+/*
+ * Block data is binary: only the whitespace after a definite block is
+ * trimmed, and only the NL that ends an indefinite one.
+ */
+static string_view TrimParameter(string_view lText)
+{
+	lText = TrimFront(lText);
+
+	if (!lText.empty() && lText.front() == '#')
+	{
+		size_t lHeaderLength;
+		size_t lPayloadLength;
+
+		switch (ProgramMessage::ParseBlockHeader(lText, lHeaderLength, lPayloadLength))
+		{
+		case ProgramMessage::DEFINITE_BLOCK:
+			if (lHeaderLength + lPayloadLength <= lText.length() &&
+				Trim(lText.substr(lHeaderLength + lPayloadLength)).empty())
+			{
+				return lText.substr(0, lHeaderLength + lPayloadLength);
+			}
+			return lText;
+		case ProgramMessage::INDEFINITE_BLOCK:
+			if (lText.back() == '\n')
+			{
+				lText.remove_suffix(1);
+			}
+			return lText;
+		default:
+			break;
+		}
+	}
+
+	return Trim(lText);
+}
+
+static bool MatchMnemonic(const Node &lNode, string_view lToken)
+{
+	size_t lLength = lToken.length();
+	return (lLength == lNode.mShortLength || lLength == lNode.mLongLength) &&
+		   !strncasecmp(lToken.data(), lNode.mMnemonic, lLength);
+}
+
+/*
+ * Match one header token against the children starting at lFirst. A node that
+ * takes a numeric suffix also matches the token with its trailing digits
+ * removed.
+ */
+static uint16_t MatchChild(const TreeView &lTree, uint16_t lFirst, string_view lToken, int32_t &lSuffix)
+{
+	for (uint16_t lIndex = lFirst; lIndex != NO_NODE; lIndex = lTree.mNodes[lIndex].mNextSibling)
+	{
+		const Node &lNode = lTree.mNodes[lIndex];
+		lSuffix = DEFAULT_SUFFIX;
+
+		if (MatchMnemonic(lNode, lToken))
+		{
+			return lIndex;
+		}
+
+		if (lNode.mSuffix)
+		{
+			size_t lEnd = lToken.length();
+			while (lEnd && isdigit(static_cast<unsigned char>(lToken[lEnd - 1])))
+			{
+				lEnd--;
+			}
+
+			if (lEnd && lEnd < lToken.length() && MatchMnemonic(lNode, lToken.substr(0, lEnd)))
+			{
+				lSuffix = atoi(string(lToken.substr(lEnd)).c_str());
+				return lIndex;
+			}
+		}
+	}
+
+	return NO_NODE;
+}
+
+/*
+ * Resolve a header to its handler. lPath is the node compound headers are
+ * relative to and is moved to the new command's parent on success.
+ */
+static Handler Resolve(const TreeView &lTree, string_view lHeader, uint16_t &lPath, Context &lContext)
+{
+	bool lCommon = lHeader.front() == '*';
+	bool lAbsolute = lHeader.front() == ':';
+	uint16_t lNode = (lCommon || lAbsolute) ? NO_NODE : lPath;
+
+	if (lAbsolute)
+	{
+		lHeader.remove_prefix(1);
+	}
+
+	lContext.mQuery = !lHeader.empty() && lHeader.back() == '?';
+	if (lContext.mQuery)
+	{
+		lHeader.remove_suffix(1);
+	}
+
+	if (lHeader.empty())
+	{
+		return nullptr;
+	}
+
+	while (true)
+	{
+		size_t lColon = lHeader.find(':');
+		string_view lToken = lHeader.substr(0, lColon);
+
+		if (lToken.empty() || lContext.mDepth == MAX_DEPTH)
+		{
+			return nullptr;
+		}
+
+		uint16_t lFirst = (lNode == NO_NODE) ? lTree.mRoot : lTree.mNodes[lNode].mFirstChild;
+		lNode = MatchChild(lTree, lFirst, lToken, lContext.mSuffixes[lContext.mDepth]);
+		if (lNode == NO_NODE)
+		{
+			return nullptr;
+		}
+		lContext.mDepth++;
+
+		if (lColon == string_view::npos)
+		{
+			break;
+		}
+		lHeader.remove_prefix(lColon + 1);
+	}
+
+	const Node &lLeaf = lTree.mNodes[lNode];
+	Handler lHandler = lContext.mQuery ? lLeaf.mQuery : lLeaf.mSet;
+
+	if (lHandler && !lCommon)
+	{
+		lPath = lLeaf.mParent;
+	}
+
+	return lHandler;
+}
+
+/*
+ * Resolve the header at the start of a program message unit; lHeaderLength is
+ * set to its length.
+ */
+static Handler ResolveUnit(const TreeView &lTree, string_view lUnit, uint16_t &lPath, Context &lContext, size_t &lHeaderLength)
+{
+	lHeaderLength = 0;
+	while (lHeaderLength < lUnit.length() && !IsWhitespace(lUnit[lHeaderLength]))
+	{
+		if (!IsHeaderCharacter(lUnit[lHeaderLength]))
+		{
+			return nullptr;
+		}
+		lHeaderLength++;
+	}
+
+	return Resolve(lTree, lUnit.substr(0, lHeaderLength), lPath, lContext);
+}
+
+static bool SplitParameters(string_view lText, Context &lContext)
+{
+	if (Trim(lText).empty())
+	{
+		return true;
+	}
+
+	// A trailing comma leaves an empty parameter
+	while (true)
+	{
+		if (lContext.mParameterCount == MAX_PARAMETERS)
+		{
+			return false;
+		}
+
+		size_t lComma = FindUnquoted(lText, ',');
+		lContext.mParameters[lContext.mParameterCount++] = TrimParameter(lText.substr(0, lComma));
+
+		if (lComma == lText.length())
+		{
+			break;
+		}
+		lText.remove_prefix(lComma + 1);
+	}
+
+	return true;
+}
+
+// The header of a program message unit, up to the first whitespace
+static string_view UnitHeader(string_view lUnit)
+{
+	size_t lLength = 0;
+	while (lLength < lUnit.length() && !IsWhitespace(lUnit[lLength]))
+	{
+		lLength++;
+	}
+	return lUnit.substr(0, lLength);
+}
+
+/*
+ * Call one handler. Responses to the queries of one program message are
+ * separated by ';'. Returns false when the handler asked to be held, with
+ * anything it wrote taken back.
+ */
+static bool Invoke(Handler lHandler, Context &lContext, size_t &lResponses)
+{
+	string &lOutput = *lContext.mOutput;
+	size_t lMark = lOutput.length();
+	if (lContext.mQuery && lResponses)
+	{
+		lOutput += ';';
+	}
+
+	lHandler(lContext);
+
+	if (lContext.mHold)
+	{
+		lOutput.resize(lMark);
+		return false;
+	}
+
+	if (lContext.mQuery)
+	{
+		if (lOutput.length() > lMark + (lResponses ? 1 : 0))
+		{
+			lResponses++;
+		}
+		else
+		{
+			lOutput.resize(lMark);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * A program message unit that is the label of an enabled macro. Returns false
+ * when it is not one.
+ */
+static bool ExpandMacro(MacroTable *lMacros, string_view lUnit, ClientSession *lSession, size_t &lResponses)
+{
+	string_view lLabel = UnitHeader(lUnit);
+	const Macro *lMacro = lMacros ? lMacros->FindExpandable(lLabel) : nullptr;
+	if (!lMacro)
+	{
+		return false;
+	}
+
+	if (!Trim(lUnit.substr(lLabel.length())).empty())
+	{
+		PushError(ScpiErrors::MACRO_PARAMETER_ERROR, ScpiErrors::cMacroParameterErrorMessage);
+	}
+	else if (!lMacro->mScpi)
+	{
+		// A Lua body only runs as a line of its own
+		PushError(ScpiErrors::MACRO_ERROR, ScpiErrors::cMacroErrorMessage);
+	}
+	else
+	{
+		lMacros->Expand(*lMacro, lSession, lResponses);
+	}
+
+	return true;
+}
+
+/*
+ * Execute a program message. Returns false without doing anything when its
+ * first header is not a SCPI header this tree knows about, so the caller can
+ * treat the message as something else (a Lua chunk).
+ */
+bool Scpi::Execute(const TreeView &lTree, const char *lMessage, size_t lLength, ClientSession *lSession,
+				   Progress *lProgress, MacroTable *lMacros)
+{
+	// Trailing whitespace is left to the parameters; it may be block data
+	string_view lText = TrimFront(string_view(lMessage, lLength));
+	string &lOutput = lSession->GetOutput();
+	uint16_t lPath = NO_NODE;
+	size_t lResponses = 0;
+	size_t lUnits = 0;
+	bool lCacheable = false;
+	const char *lCacheKey = nullptr;
+	bool lFirst = true;
+
+	if (lProgress && lProgress->mHeld)
+	{
+		lText = string_view(lMessage + lProgress->mOffset, lLength - lProgress->mOffset);
+		lPath = lProgress->mPath;
+		lResponses = lProgress->mResponses;
+		lFirst = false;
+		lProgress->mHeld = false;
+	}
+
+	if (Trim(lText).empty())
+	{
+		return false;
+	}
+
+	while (!lText.empty())
+	{
+		size_t lOffset = lText.data() - lMessage;
+		uint16_t lUnitPath = lPath;
+		size_t lSemicolon = FindUnquoted(lText, ';');
+		string_view lUnit = TrimFront(lText.substr(0, lSemicolon));
+		lText.remove_prefix(lSemicolon == lText.length() ? lSemicolon : lSemicolon + 1);
+
+		if (Trim(lUnit).empty())
+		{
+			continue;
+		}
+
+		Context lContext = {};
+		lContext.mSession = lSession;
+		lContext.mOutput = &lOutput;
+		lContext.mCanHold = (lProgress != nullptr);
+
+		size_t lHeaderLength;
+		Handler lHandler = ResolveUnit(lTree, lUnit, lPath, lContext, lHeaderLength);
+		if (!lHandler)
+		{
+			if (ExpandMacro(lMacros, lUnit, lSession, lResponses))
+			{
+				lFirst = false;
+				lUnits++;
+				lCacheable = false;
+				continue;
+			}
+			if (lFirst)
+			{
+				return false;
+			}
+			PushError(ScpiErrors::UNDEFINED_HEADER, ScpiErrors::cUndefinedHeaderMessage);
+			continue;
+		}
+		lFirst = false;
+		lUnits++;
+		lCacheable = false;
+
+		if (!SplitParameters(lUnit.substr(lHeaderLength), lContext))
+		{
+			PushError(ScpiErrors::PARAMETER_NOT_ALLOWED, ScpiErrors::cParameterNotAllowedMessage);
+			continue;
+		}
+
+		if (!Invoke(lHandler, lContext, lResponses))
+		{
+			lProgress->mHeld = true;
+			lProgress->mOffset = lOffset;
+			lProgress->mPath = lUnitPath;
+			lProgress->mResponses = lResponses;
+			return true;
+		}
+		lCacheable = lContext.mCacheable;
+		lCacheKey = lContext.mCacheKey;
+	}
+
+	if (lProgress)
+	{
+		lProgress->mCacheable = (lUnits == 1 && lCacheable);
+		lProgress->mCacheKey = lCacheKey;
+	}
+
+	return true;
+}
+
+/*
+ * Whether Execute() would take the program message, without running anything
+ */
+bool Scpi::Recognize(const TreeView &lTree, const char *lMessage, size_t lLength, const MacroTable *lMacros)
+{
+	string_view lText(lMessage, lLength);
+
+	while (!lText.empty())
+	{
+		size_t lSemicolon = FindUnquoted(lText, ';');
+		string_view lUnit = TrimFront(lText.substr(0, lSemicolon));
+		lText.remove_prefix(lSemicolon == lText.length() ? lSemicolon : lSemicolon + 1);
+
+		if (Trim(lUnit).empty())
+		{
+			continue;
+		}
+
+		Context lContext = {};
+		uint16_t lPath = NO_NODE;
+		size_t lHeaderLength;
+		return ResolveUnit(lTree, lUnit, lPath, lContext, lHeaderLength) != nullptr ||
+			   (lMacros && lMacros->FindExpandable(UnitHeader(lUnit)));
+	}
+
+	return false;
+}
+
+MacroTable::MacroTable(TreeView lTree)
+: mTree{lTree}
+, mEnabled{false}
+, mExpanding{0}
+{
+}
+
+bool MacroTable::LabelLess::operator()(string_view lFirst, string_view lSecond) const
+{
+	int lOrder = strncasecmp(lFirst.data(), lSecond.data(), min(lFirst.length(), lSecond.length()));
+	return lOrder ? lOrder < 0 : lFirst.length() < lSecond.length();
+}
+
+/*
+ * A label is a program mnemonic: a letter, then letters, digits and '_'. It
+ * cannot be a header of the tree, or the macro could never be expanded.
+ */
+bool MacroTable::IsValidLabel(string_view lLabel)
+{
+	if (lLabel.empty() || lLabel.length() > MAX_MACRO_LABEL_LENGTH || !isalpha(static_cast<unsigned char>(lLabel.front())))
+	{
+		return false;
+	}
+
+	return all_of(lLabel.begin(), lLabel.end(),
+				  [](char lChar) { return isalnum(static_cast<unsigned char>(lChar)) || lChar == '_'; });
+}
+
+const Macro *MacroTable::Define(string_view lLabel, string_view lBody)
+{
+	if (!IsValidLabel(lLabel))
+	{
+		PushError(ScpiErrors::ILLEGAL_PARAMETER_VALUE, ScpiErrors::cIllegalParameterValueMessage);
+		return nullptr;
+	}
+
+	string lQuery = string(lLabel) + '?';
+	uint16_t lPath = NO_NODE;
+	Context lSet = {};
+	Context lGet = {};
+	if (Resolve(mTree, lLabel, lPath, lSet) || Resolve(mTree, lQuery, lPath, lGet))
+	{
+		PushError(ScpiErrors::MACRO_ERROR, ScpiErrors::cMacroErrorMessage);
+		return nullptr;
+	}
+
+	// Redefining a label takes a *RMC first (IEEE 488.2 - 10.7.6.3)
+	auto [lIterator, lInserted] = mMacros.try_emplace(string(lLabel), Macro{ string(lBody), true, {} });
+	if (!lInserted)
+	{
+		PushError(ScpiErrors::MACRO_ERROR, ScpiErrors::cMacroErrorMessage);
+		return nullptr;
+	}
+
+	if (!Prepare(lIterator->second))
+	{
+		mMacros.erase(lIterator);
+		PushError(ScpiErrors::MACRO_ERROR, ScpiErrors::cMacroErrorMessage);
+		return nullptr;
+	}
+
+	return &lIterator->second;
+}
+
+/*
+ * Resolve the body of a new macro into its handler calls, the way Execute()
+ * would. A body whose first header is not in the tree is left to Lua; once
+ * the first one is, every unit has to be.
+ */
+bool MacroTable::Prepare(Macro &lMacro)
+{
+	string_view lText = TrimFront(lMacro.mBody);
+	uint16_t lPath = NO_NODE;
+
+	while (!lText.empty())
+	{
+		size_t lSemicolon = FindUnquoted(lText, ';');
+		string_view lUnit = TrimFront(lText.substr(0, lSemicolon));
+		lText.remove_prefix(lSemicolon == lText.length() ? lSemicolon : lSemicolon + 1);
+
+		if (Trim(lUnit).empty())
+		{
+			continue;
+		}
+
+		MacroUnit lMacroUnit = {};
+		size_t lHeaderLength;
+		lMacroUnit.mHandler = ResolveUnit(mTree, lUnit, lPath, lMacroUnit.mContext, lHeaderLength);
+		if (!lMacroUnit.mHandler)
+		{
+			if (lMacro.mUnits.empty())
+			{
+				lMacro.mScpi = false;
+				return true;
+			}
+			return false;
+		}
+
+		if (!SplitParameters(lUnit.substr(lHeaderLength), lMacroUnit.mContext))
+		{
+			return false;
+		}
+
+		lMacro.mUnits.push_back(lMacroUnit);
+	}
+
+	// An empty body is an empty Lua chunk
+	lMacro.mScpi = !lMacro.mUnits.empty();
+	return true;
+}
+
+bool MacroTable::Remove(string_view lLabel)
+{
+	auto lIterator = mMacros.find(lLabel);
+	if (lIterator == mMacros.end())
+	{
+		PushError(ScpiErrors::MACRO_ERROR, ScpiErrors::cMacroErrorMessage);
+		return false;
+	}
+
+	mMacros.erase(lIterator);
+	return true;
+}
+
+void MacroTable::Purge(void)
+{
+	mMacros.clear();
+}
+
+const Macro *MacroTable::Find(string_view lLabel) const
+{
+	auto lIterator = mMacros.find(lLabel);
+	return (lIterator == mMacros.end()) ? nullptr : &lIterator->second;
+}
+
+const Macro *MacroTable::FindExpandable(string_view lLabel) const
+{
+	return (mEnabled && !mMacros.empty()) ? Find(lLabel) : nullptr;
+}
+
+vector<string> MacroTable::GetLabels(void) const
+{
+	vector<string> lLabels;
+	lLabels.reserve(mMacros.size());
+	for (const auto &lEntry : mMacros)
+	{
+		lLabels.push_back(lEntry.first);
+	}
+	return lLabels;
+}
+
+// Runs the prepared units of a SCPI macro as part of the program message
+void MacroTable::Expand(const Macro &lMacro, ClientSession *lSession, size_t &lResponses)
+{
+	mExpanding++;
+
+	for (const MacroUnit &lMacroUnit : lMacro.mUnits)
+	{
+		Context lContext = lMacroUnit.mContext;
+		lContext.mSession = lSession;
+		lContext.mOutput = &lSession->GetOutput();
+		lContext.mCanHold = false;
+
+		Invoke(lMacroUnit.mHandler, lContext, lResponses);
+	}
+
+	mExpanding--;
+}
+
+void Scpi::PushError(int32_t lNumber, const char *lMessage)
+{
+	SystemErrors::gErrorController.Push(Error(lNumber, lMessage, strlen(lMessage)));
+}
+
+bool Scpi::ExpectParameters(Context &lContext, size_t lMinimum, size_t lMaximum)
+{
+	if (lContext.mParameterCount < lMinimum)
+	{
+		PushError(ScpiErrors::MISSING_PARAMETER, ScpiErrors::cMissingParameterMessage);
+		return false;
+	}
+
+	if (lContext.mParameterCount > lMaximum)
+	{
+		PushError(ScpiErrors::PARAMETER_NOT_ALLOWED, ScpiErrors::cParameterNotAllowedMessage);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Decimal numeric program data (IEEE 488.2 7.7.2): an optionally signed
+ * mantissa with at least one digit and an optional decimal point, then an
+ * optional exponent. strtod() alone would also take hex, INF and NAN.
+ */
+static bool IsDecimalNumeric(string_view lText)
+{
+	size_t lIndex = 0;
+	size_t lDigits = 0;
+
+	if (lIndex < lText.length() && (lText[lIndex] == '+' || lText[lIndex] == '-'))
+	{
+		lIndex++;
+	}
+
+	for (bool lPoint = false; lIndex < lText.length(); lIndex++)
+	{
+		if (isdigit(static_cast<unsigned char>(lText[lIndex])))
+		{
+			lDigits++;
+		}
+		else if (lText[lIndex] == '.' && !lPoint)
+		{
+			lPoint = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (!lDigits)
+	{
+		return false;
+	}
+
+	if (lIndex < lText.length() && (lText[lIndex] == 'E' || lText[lIndex] == 'e'))
+	{
+		lIndex++;
+		if (lIndex < lText.length() && (lText[lIndex] == '+' || lText[lIndex] == '-'))
+		{
+			lIndex++;
+		}
+
+		size_t lExponentStart = lIndex;
+		while (lIndex < lText.length() && isdigit(static_cast<unsigned char>(lText[lIndex])))
+		{
+			lIndex++;
+		}
+
+		if (lIndex == lExponentStart)
+		{
+			return false;
+		}
+	}
+
+	return lIndex == lText.length();
+}
+
+bool Scpi::GetUnsigned(Context &lContext, size_t lIndex, uint32_t lMaximum, uint32_t &lValue)
+{
+	string lText(lContext.mParameters[lIndex]);
+
+	if (!IsDecimalNumeric(lText))
+	{
+		PushError(ScpiErrors::DATA_TYPE_ERROR, ScpiErrors::cDataTypeErrorMessage);
+		return false;
+	}
+
+	// Syntax is checked, so only an exponent too large to represent can make it not finite
+	double lNumber = strtod(lText.c_str(), nullptr);
+	if (!isfinite(lNumber))
+	{
+		PushError(ScpiErrors::DATA_OUT_OF_RANGE, ScpiErrors::cDataOutOfRangeMessage);
+		return false;
+	}
+
+	// Decimal numeric program data is rounded to the nearest integer
+	lNumber += 0.5;
+	if (lNumber < 0.0 || lNumber > static_cast<double>(lMaximum) + 0.5)
+	{
+		PushError(ScpiErrors::DATA_OUT_OF_RANGE, ScpiErrors::cDataOutOfRangeMessage);
+		return false;
+	}
+
+	lValue = static_cast<uint32_t>(lNumber);
+	return true;
+}
+
+bool Scpi::GetBoolean(Context &lContext, size_t lIndex, bool &lValue)
+{
+	string_view lText = lContext.mParameters[lIndex];
+
+	if ((lText.length() == 2 && !strncasecmp(lText.data(), "ON", 2)) || lText == "1")
+	{
+		lValue = true;
+		return true;
+	}
+
+	if ((lText.length() == 3 && !strncasecmp(lText.data(), "OFF", 3)) || lText == "0")
+	{
+		lValue = false;
+		return true;
+	}
+
+	PushError(ScpiErrors::ILLEGAL_PARAMETER_VALUE, ScpiErrors::cIllegalParameterValueMessage);
+	return false;
+}
+
+/*
+ * <STRING PROGRAM DATA>: single or double quoted, with the quote doubled
+ * inside
+ */
+bool Scpi::GetString(Context &lContext, size_t lIndex, string &lValue)
+{
+	string_view lText = lContext.mParameters[lIndex];
+
+	if (lText.length() < 2 || (lText.front() != '"' && lText.front() != '\'') || lText.back() != lText.front())
+	{
+		PushError(ScpiErrors::DATA_TYPE_ERROR, ScpiErrors::cDataTypeErrorMessage);
+		return false;
+	}
+
+	char lQuote = lText.front();
+	lText = lText.substr(1, lText.length() - 2);
+	lValue.clear();
+
+	for (size_t lPosition = 0; lPosition < lText.length(); lPosition++)
+	{
+		if (lText[lPosition] == lQuote)
+		{
+			if (lPosition + 1 == lText.length() || lText[lPosition + 1] != lQuote)
+			{
+				PushError(ScpiErrors::INVALID_STRING_DATA, ScpiErrors::cInvalidStringDataMessage);
+				return false;
+			}
+			lPosition++;
+		}
+		lValue += lText[lPosition];
+	}
+
+	return true;
+}
+
+/*
+ * <ARBITRARY BLOCK PROGRAM DATA>: lPayload is set to the data bytes, still in
+ * the received message.
+ */
+bool Scpi::GetBlock(Context &lContext, size_t lIndex, string_view &lPayload)
+{
+	string_view lText = lContext.mParameters[lIndex];
+	size_t lHeaderLength;
+	size_t lPayloadLength;
+
+	if (lText.empty() || lText.front() != '#')
+	{
+		PushError(ScpiErrors::DATA_TYPE_ERROR, ScpiErrors::cDataTypeErrorMessage);
+		return false;
+	}
+
+	switch (ProgramMessage::ParseBlockHeader(lText, lHeaderLength, lPayloadLength))
+	{
+	case ProgramMessage::DEFINITE_BLOCK:
+		if (lHeaderLength + lPayloadLength != lText.length())
+		{
+			break;
+		}
+		lPayload = lText.substr(lHeaderLength);
+		return true;
+	case ProgramMessage::INDEFINITE_BLOCK:
+		lPayload = lText.substr(lHeaderLength);
+		return true;
+	default:
+		break;
+	}
+
+	PushError(ScpiErrors::INVALID_BLOCK_DATA, ScpiErrors::cInvalidBlockDataMessage);
+	return false;
+}
+
+void Scpi::Respond(Context &lContext, int64_t lValue)
+{
+	char lBuffer[24];
+	int lLength = snprintf(lBuffer, sizeof(lBuffer), "%lld", static_cast<long long>(lValue));
+	lContext.mOutput->append(lBuffer, lLength);
+}
+
+void Scpi::Respond(Context &lContext, string_view lValue)
+{
+	lContext.mOutput->append(lValue);
+}
+
+void Scpi::RespondString(Context &lContext, string_view lValue)
+{
+	string &lOutput = *lContext.mOutput;
+
+	lOutput += '"';
+	for (char lChar : lValue)
+	{
+		if (lChar == '"')
+		{
+			lOutput += '"';
+		}
+		lOutput += lChar;
+	}
+	lOutput += '"';
+}
+
+/*
+ * Called by a query handler once it has responded: the response only changes
+ * when lKey is invalidated, or never without one.
+ */
+void Scpi::Cacheable(Context &lContext, const char *lKey)
+{
+	lContext.mCacheable = true;
+	lContext.mCacheKey = lKey;
+}
+
+void Scpi::RespondBlock(Context &lContext, string_view lPayload)
+{
+	string lLength = to_string(lPayload.length());
+
+	*lContext.mOutput += '#';
+	*lContext.mOutput += static_cast<char>('0' + lLength.length());
+	lContext.mOutput->append(lLength);
+	lContext.mOutput->append(lPayload);
+}
@@ -0,0 +1,538 @@
+/*
+ * scpicommands.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+#include "errors.hpp"
+#include "led.hpp"
+#include "model.hpp"
+#include "operations.hpp"
+#include "responsecache.hpp"
+#include "scpi.hpp"
+#include "scriptprocessor.hpp"
+#include "status.hpp"
+
+using namespace Scpi;
+
+constexpr char SCPI_VERSION[] = "1999.0";
+
+// Program message run by *TRG, set with *DDT
+static string sDeviceTrigger;
+static bool sTriggering = false;
+
+/*
+ * IEEE 488.2 common commands
+ */
+static void IdnQuery(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 0, 0))
+	{
+		return;
+	}
+
+	Respond(lContext, MANUFACTURER);
+	Respond(lContext, ",");
+	Respond(lContext, MODEL);
+	Respond(lContext, ",");
+	Respond(lContext, SERIAL);
+	Respond(lContext, ",INSTR");
+	Cacheable(lContext);
+}
+
+static void Cls(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 0, 0))
+	{
+		return;
+	}
+
+	StatusModelApi::ClearEventRegister(gPlatformStatus);
+	SystemErrors::gErrorController.Clear();
+	gOperations.DisarmOpc();
+	gResponseCache.Invalidate(RESPONSE_KEY_STATUS);
+}
+
+static void Rst(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 0, 0))
+	{
+		return;
+	}
+
+	lContext.mSession->GetResponse().Reset();
+	gOperations.DisarmOpc();
+	gMacros.SetEnabled(false);
+	gResponseCache.Invalidate(RESPONSE_KEY_SETTINGS);
+}
+
+static void TstQuery(Context &lContext)
+{
+	Respond(lContext, static_cast<int64_t>(0));
+}
+
+/*
+ * Whether a handler that waits for pending operations has to be held. Where
+ * the caller cannot hold the message (a *TRG device trigger), it goes on.
+ */
+static bool HoldForOperations(Context &lContext)
+{
+	if (gOperations.IsComplete() || !lContext.mCanHold)
+	{
+		return false;
+	}
+
+	lContext.mHold = true;
+	return true;
+}
+
+static void Opc(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 0, 0))
+	{
+		return;
+	}
+
+	gOperations.ArmOpc();
+}
+
+static void OpcQuery(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 0, 0) || HoldForOperations(lContext))
+	{
+		return;
+	}
+
+	Respond(lContext, static_cast<int64_t>(1));
+}
+
+static void Wai(Context &lContext)
+{
+	if (ExpectParameters(lContext, 0, 0))
+	{
+		HoldForOperations(lContext);
+	}
+}
+
+static void Ese(Context &lContext)
+{
+	uint32_t lValue;
+	if (ExpectParameters(lContext, 1, 1) && GetUnsigned(lContext, 0, 255, lValue))
+	{
+		StatusModelApi::SetEventEnableRegister(gPlatformStatus, lValue);
+	}
+}
+
+static void EseQuery(Context &lContext)
+{
+	Respond(lContext, static_cast<int64_t>(StatusModelApi::GetEventEnableRegister(gPlatformStatus)));
+}
+
+static void EsrQuery(Context &lContext)
+{
+	// Reading the standard event status register clears it
+	Respond(lContext, static_cast<int64_t>(StatusModelApi::TakeEventRegister(gPlatformStatus)));
+}
+
+static void Sre(Context &lContext)
+{
+	uint32_t lValue;
+	if (ExpectParameters(lContext, 1, 1) && GetUnsigned(lContext, 0, 255, lValue))
+	{
+		// RQS cannot be enabled
+		gPlatformStatus.SetServiceRequestEnableRegister(lValue & ~(1 << RQS_BIT));
+	}
+}
+
+static void SreQuery(Context &lContext)
+{
+	Respond(lContext, static_cast<int64_t>(gPlatformStatus.GetServiceRequestEnableRegister()));
+}
+
+static void StbQuery(Context &lContext)
+{
+	Respond(lContext, static_cast<int64_t>(StatusModelApi::GetStatusByte(gPlatformStatus)));
+}
+
+static void Ddt(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 1, 1))
+	{
+		return;
+	}
+
+	string_view lText = lContext.mParameters[0];
+	if (!lText.empty() && lText.front() == '#')
+	{
+		string_view lPayload;
+		if (GetBlock(lContext, 0, lPayload))
+		{
+			sDeviceTrigger.assign(lPayload);
+		}
+		return;
+	}
+
+	string lValue;
+	if (GetString(lContext, 0, lValue))
+	{
+		sDeviceTrigger = lValue;
+	}
+}
+
+static void DdtQuery(Context &lContext)
+{
+	RespondBlock(lContext, sDeviceTrigger);
+}
+
+static void Trg(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 0, 0) || sTriggering || sDeviceTrigger.empty())
+	{
+		return;
+	}
+
+	// The trigger message cannot trigger itself
+	sTriggering = true;
+	if (!Dispatch(sDeviceTrigger.data(), sDeviceTrigger.length(), lContext.mSession))
+	{
+		PushError(ScpiErrors::UNDEFINED_HEADER, ScpiErrors::cUndefinedHeaderMessage);
+	}
+	sTriggering = false;
+}
+
+/*
+ * Macros (IEEE 488.2 - 10.7). The table cannot change while one of its
+ * macros is being expanded.
+ */
+static bool CheckNotExpanding(void)
+{
+	if (gMacros.IsExpanding())
+	{
+		PushError(ScpiErrors::INVALID_INSIDE_MACRO_DEFINITION, ScpiErrors::cInvalidInsideMacroDefinitionMessage);
+		return false;
+	}
+	return true;
+}
+
+static void Dmc(Context &lContext)
+{
+	string lLabel;
+	if (!ExpectParameters(lContext, 2, 2) || !CheckNotExpanding() || !GetString(lContext, 0, lLabel))
+	{
+		return;
+	}
+
+	string lText;
+	string_view lBody = lContext.mParameters[1];
+	if (!lBody.empty() && lBody.front() == '#')
+	{
+		if (!GetBlock(lContext, 1, lBody))
+		{
+			return;
+		}
+	}
+	else if (GetString(lContext, 1, lText))
+	{
+		lBody = lText;
+	}
+	else
+	{
+		return;
+	}
+
+	const Macro *lMacro = gMacros.Define(lLabel, lBody);
+	if (!lMacro || lMacro->mScpi)
+	{
+		return;
+	}
+
+	// A Lua body is compiled now, so a syntax error shows up here
+	if (gScriptProcessor->PrepareScript(lMacro->mBody.data(), lMacro->mBody.length()) != LUA_OK)
+	{
+		gMacros.Remove(lLabel);
+		PushError(ScpiErrors::MACRO_ERROR, ScpiErrors::cMacroErrorMessage);
+	}
+}
+
+static void Emc(Context &lContext)
+{
+	uint32_t lValue;
+	if (ExpectParameters(lContext, 1, 1) && GetUnsigned(lContext, 0, 32767, lValue))
+	{
+		gMacros.SetEnabled(lValue != 0);
+	}
+}
+
+static void EmcQuery(Context &lContext)
+{
+	Respond(lContext, static_cast<int64_t>(gMacros.IsEnabled() ? 1 : 0));
+}
+
+static void GmcQuery(Context &lContext)
+{
+	string lLabel;
+	if (!ExpectParameters(lContext, 1, 1) || !GetString(lContext, 0, lLabel))
+	{
+		return;
+	}
+
+	const Macro *lMacro = gMacros.Find(lLabel);
+	if (!lMacro)
+	{
+		PushError(ScpiErrors::MACRO_ERROR, ScpiErrors::cMacroErrorMessage);
+		return;
+	}
+
+	RespondBlock(lContext, lMacro->mBody);
+}
+
+static void LmcQuery(Context &lContext)
+{
+	vector<string> lLabels = gMacros.GetLabels();
+	if (lLabels.empty())
+	{
+		RespondString(lContext, "");
+		return;
+	}
+
+	for (size_t lIndex = 0; lIndex < lLabels.size(); lIndex++)
+	{
+		if (lIndex)
+		{
+			Respond(lContext, ",");
+		}
+		RespondString(lContext, lLabels[lIndex]);
+	}
+}
+
+static void Rmc(Context &lContext)
+{
+	string lLabel;
+	if (ExpectParameters(lContext, 1, 1) && CheckNotExpanding() && GetString(lContext, 0, lLabel))
+	{
+		gMacros.Remove(lLabel);
+	}
+}
+
+static void Pmc(Context &lContext)
+{
+	if (ExpectParameters(lContext, 0, 0) && CheckNotExpanding())
+	{
+		gMacros.Purge();
+	}
+}
+
+/*
+ * SYSTem subsystem
+ */
+static void SystemErrorNextQuery(Context &lContext)
+{
+	Error lError;
+
+	if (!SystemErrors::gErrorController.Take(lError))
+	{
+		Respond(lContext, "0,\"No error\"");
+		return;
+	}
+
+	Respond(lContext, -static_cast<int64_t>(lError.GetNumber()));
+	Respond(lContext, ",");
+	RespondString(lContext, lError.GetMessage());
+}
+
+static void SystemErrorCountQuery(Context &lContext)
+{
+	Respond(lContext, static_cast<int64_t>(SystemErrors::gErrorController.Count()));
+}
+
+static void SystemVersionQuery(Context &lContext)
+{
+	Respond(lContext, SCPI_VERSION);
+	Cacheable(lContext);
+}
+
+/*
+ * STATus subsystem
+ */
+static void StatusPreset(Context &lContext)
+{
+	if (!ExpectParameters(lContext, 0, 0))
+	{
+		return;
+	}
+
+	gPlatformStatus.SetPositiveTransitionRegister(0xffff);
+	gPlatformStatus.ClearNegativeTransitionRegister();
+}
+
+/*
+ * DIAGnostic subsystem
+ */
+static void DiagnosticLedState(Context &lContext)
+{
+	bool lState;
+	if (ExpectParameters(lContext, 1, 1) && GetBoolean(lContext, 0, lState))
+	{
+		if (lState)
+		{
+			gLed.On();
+		}
+		else
+		{
+			gLed.Off();
+		}
+	}
+}
+
+static void DiagnosticLedStateQuery(Context &lContext)
+{
+	Respond(lContext, static_cast<int64_t>(gLed.GetState() == Led::ON));
+}
+
+static constexpr Command sCommands[] = {
+	{ "*IDN?", IdnQuery },
+	{ "*CLS", Cls },
+	{ "*RST", Rst },
+	{ "*TST?", TstQuery },
+	{ "*OPC", Opc },
+	{ "*OPC?", OpcQuery },
+	{ "*WAI", Wai },
+	{ "*ESE", Ese },
+	{ "*ESE?", EseQuery },
+	{ "*ESR?", EsrQuery },
+	{ "*SRE", Sre },
+	{ "*SRE?", SreQuery },
+	{ "*STB?", StbQuery },
+	{ "*DDT", Ddt },
+	{ "*DDT?", DdtQuery },
+	{ "*TRG", Trg },
+	{ "*DMC", Dmc },
+	{ "*EMC", Emc },
+	{ "*EMC?", EmcQuery },
+	{ "*GMC?", GmcQuery },
+	{ "*LMC?", LmcQuery },
+	{ "*RMC", Rmc },
+	{ "*PMC", Pmc },
+
+	{ "SYSTem:ERRor[:NEXT]?", SystemErrorNextQuery },
+	{ "SYSTem:ERRor:COUNt?", SystemErrorCountQuery },
+	{ "SYSTem:VERSion?", SystemVersionQuery },
+
+	{ "STATus:PRESet", StatusPreset },
+
+	{ "DIAGnostic:LED[:STATe]", DiagnosticLedState },
+	{ "DIAGnostic:LED[:STATe]?", DiagnosticLedStateQuery },
+};
+
+static constexpr size_t sNodeCount = CountNodes(sCommands);
+static constexpr Tree<sNodeCount> sTree = BuildTree<sNodeCount>(sCommands);
+
+MacroTable Scpi::gMacros(sTree.View());
+
+/*
+ * Status queries any thread can answer, from one snapshot of the status data
+ * structure, without the script processor
+ */
+enum StatusQuery
+{
+	STATUS_QUERY_STB,
+	STATUS_QUERY_ESR,
+	STATUS_QUERY_ESE,
+	STATUS_QUERY_SRE,
+};
+
+static constexpr struct
+{
+	const char *mHeader;
+	StatusQuery mQuery;
+} sStatusQueries[] = {
+	{ "*STB?", STATUS_QUERY_STB },
+	{ "*ESR?", STATUS_QUERY_ESR },
+	{ "*ESE?", STATUS_QUERY_ESE },
+	{ "*SRE?", STATUS_QUERY_SRE },
+};
+
+static constexpr size_t MAX_STATUS_QUERIES = 8;
+
+/*
+ * Answers a program message made of nothing but those queries (';' separated)
+ * into lResponse. Returns false, having changed nothing, for anything else.
+ */
+bool Scpi::AnswerStatusQueries(const char *lMessage, size_t lLength, string &lResponse)
+{
+	StatusQuery lQueries[MAX_STATUS_QUERIES];
+	size_t lCount = 0;
+	string_view lText(lMessage, lLength);
+
+	while (!lText.empty())
+	{
+		size_t lSemicolon = min(lText.find(';'), lText.length());
+		string_view lUnit = lText.substr(0, lSemicolon);
+		lText.remove_prefix(lSemicolon == lText.length() ? lSemicolon : lSemicolon + 1);
+
+		lUnit.remove_prefix(min(lUnit.find_first_not_of(" \t\r\n"), lUnit.length()));
+		lUnit = lUnit.substr(0, lUnit.find_last_not_of(" \t\r\n") + 1);
+
+		auto lMatch = find_if(begin(sStatusQueries), end(sStatusQueries), [lUnit](const auto &lEntry) {
+			return lUnit.length() == strlen(lEntry.mHeader) && !strncasecmp(lUnit.data(), lEntry.mHeader, lUnit.length());
+		});
+		if (lMatch == end(sStatusQueries) || lCount == MAX_STATUS_QUERIES)
+		{
+			return false;
+		}
+		lQueries[lCount++] = lMatch->mQuery;
+	}
+
+	if (!lCount)
+	{
+		return false;
+	}
+
+	StatusSnapshot lSnapshot = gPlatformStatus.Snapshot();
+	lResponse.clear();
+
+	for (size_t lIndex = 0; lIndex < lCount; lIndex++)
+	{
+		uint16_t lValue = 0;
+		switch (lQueries[lIndex])
+		{
+		case STATUS_QUERY_STB:
+			lValue = StatusModelApi::GetStatusByte(lSnapshot);
+			break;
+		case STATUS_QUERY_ESR:
+			// Clears the register; a later *ESR? in the same message reads what came since
+			lValue = StatusModelApi::TakeEventRegister(gPlatformStatus);
+			lSnapshot = gPlatformStatus.Snapshot();
+			break;
+		case STATUS_QUERY_ESE:
+			lValue = lSnapshot.mEventEnableRegister;
+			break;
+		case STATUS_QUERY_SRE:
+			lValue = lSnapshot.mServiceRequestEnableRegister;
+			break;
+		}
+
+		if (lIndex)
+		{
+			lResponse += ';';
+		}
+		lResponse += to_string(lValue);
+	}
+
+	return true;
+}
+
+bool Scpi::Dispatch(const char *lMessage, size_t lLength, ClientSession *lSession, Progress *lProgress)
+{
+	return Execute(sTree.View(), lMessage, lLength, lSession, lProgress, &gMacros);
+}
+
+bool Scpi::IsCommand(const char *lMessage, size_t lLength)
+{
+	return Recognize(sTree.View(), lMessage, lLength, &gMacros);
+}
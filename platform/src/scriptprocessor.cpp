@@ -6,44 +6,31 @@
  */
 
 
+#include <cctype>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 
 #include <iostream>
 
+#include "admission.hpp"
 #include "errors.hpp"
+#include "format.hpp"
 #include "led.hpp"
 #include "model.hpp"
+#include "operations.hpp"
+#include "programmessage.hpp"
+#include "responsecache.hpp"
+#include "rot.hpp"
+#include "scheduler.hpp"
+#include "scpi.hpp"
 #include "scriptprocessor.hpp"
 #include "status.hpp"
 
-string ScriptProcessor::mOutputString;
-
-constexpr char TST_Q_RESPONSE[] = "0\n";
-constexpr char OPC_Q_RESPONSE[] = "1\n";
-constexpr char ESE_Q_RESPONSE[] = "0\n";
-constexpr char ESR_Q_RESPONSE[] = "128\n";
-constexpr char SRE_Q_RESPONSE[] = "0\n";
-constexpr char STB_Q_RESPONSE[] = "42";
-constexpr char ERROR_RESPONSE[] = "ERROR";
-constexpr size_t TST_Q_RESPONSE_LEN = 2;
-constexpr size_t OPC_Q_RESPONSE_LEN = 2;
-constexpr size_t ESE_Q_RESPONSE_LEN = 2;
-constexpr size_t ESR_Q_RESPONSE_LEN = 4;
-constexpr size_t SRE_Q_RESPONSE_LEN = 2;
-constexpr size_t STB_Q_RESPONSE_LEN = 3;
-constexpr size_t ERROR_RESPONSE_LEN = 5;
-
-constexpr char IDN_Q_CMD[] = "print(information.manufacturer..\",\"..information.model..\",\"..information.serial..\",INSTR\")\0";
-constexpr char TST_Q_CMD[] = "print(0)\0";
-constexpr char OPC_Q_CMD[] = "print(1)\0";
-constexpr char ESE_Q_CMD[] = "print(status.eventenable)\0";
-constexpr char ESR_Q_CMD[] = "print(status.event)\0";
-constexpr char SRE_Q_CMD[] = "print(0)\0";
-constexpr char STB_Q_CMD[] = "print(69)\0";
-
 static const char sDeviceTableIndex[] = "DeviceTableIndex";
+static const char sSessionEnvironmentIndex[] = "SessionEnvironment";
+static const char sChunkName[] = "=command";
+static const string sProgramMessageTerminator = "\n";
 
 ScriptProcessor *gScriptProcessor;
 
@@ -70,253 +57,1004 @@ static void InitDeviceTable(lua_State *lState)
 	lLua.SetGlobal("localnode");
 }
 
-static void GetDeviceTable(Lua *lLua) {
-	lLua->PushLightUserData(const_cast<char *>(sDeviceTableIndex));
-	lLua->GetTable(LUA_REGISTRYINDEX);
-}
-
-ssize_t IDNQHandler(const char *lBuffer, size_t lLength)
+/*
+ * Every session environment shares this metatable, which sends reads of
+ * anything the session has not assigned itself to the template globals.
+ */
+static void InitSessionEnvironment(lua_State *lState)
 {
-	return gScriptProcessor->HandleCommand(IDN_Q_CMD, strlen(IDN_Q_CMD), false);
-}
+	Lua lLua(lState);
 
-ssize_t CLSHandler(const char *lBuffer, size_t lLength)
-{
-#if 0
-	Lock();
-	// TODO: gPlatformStatus.ClearEventRegister();
-	Unlock();
-#else
-#endif
-	return 0;
-}
+	lLua.PushLightUserData(const_cast<char *>(sSessionEnvironmentIndex));
+	lLua.NewTable();
+	lLua.PushGlobalTable();
+	lLua.SetField(-2, "__index");
 
-ssize_t RSTHandler(const char *lBuffer, size_t lLength)
-{
-#if 0
-	Lock();
-	Unlock();
-#else
-#endif
-	return 0;
+	/*
+	 * Stack: (top down)
+	 * 		: {__index = _G} "SessionEnvironment"
+	 */
+	lLua.SetTable(LUA_REGISTRYINDEX);
 }
 
-ssize_t TSTQHandler(const char *lBuffer, size_t lLength)
+ScriptProcessor::ScriptProcessor(void)
+: Endpoint()
+, Lua(LuaAllocator::Allocate, &gLuaAllocator)
+, mSession{gSessionManager.GetDefaultSession()}
+, mScriptStore{this}
+, mCacheable{false}
+, mCacheKey{nullptr}
 {
-	return gScriptProcessor->HandleCommand(TST_Q_CMD, strlen(TST_Q_CMD), false);
+
+	pthread_mutex_init(&mLock, nullptr);
+
+	StartLua();
 }
 
-ssize_t OPCHandler(const char *lBuffer, size_t lLength)
+ScriptProcessor::~ScriptProcessor()
 {
-#if 0
-	Lock();
-	Unlock();
-#else
-#endif
-	return 0;
 }
 
-ssize_t OPCQHandler(const char *lBuffer, size_t lLength)
+/*
+ * Subsystem tables nobody needs to take the first command are installed when
+ * a script first reads their global: the globals table gets a metatable whose
+ * __index comes here. Session environments fall through to the globals, so
+ * this works from any session. An installer leaves its table in the globals
+ * with SetGlobal() like it always has, after which the loader is not reached
+ * for that name again.
+ */
+const ScriptProcessor::Subsystem *ScriptProcessor::FindSubsystem(const char *lName)
 {
-	return gScriptProcessor->HandleCommand(OPC_Q_CMD, strlen(OPC_Q_CMD), false);
+	static const Subsystem sSubsystems[] = {
+		{ "information", [](ScriptProcessor *lSP, lua_State *lS) { lSP->InfoInstall(lS); } },
+		{ "led", [](ScriptProcessor *, lua_State *lS) { LedInstall(lS); } },
+		{ "status", [](ScriptProcessor *, lua_State *lS) { StatusInstall(lS); } },
+		{ "errors", [](ScriptProcessor *, lua_State *lS) { ErrorsInstall(lS); } },
+		{ "chunkcache", [](ScriptProcessor *lSP, lua_State *lS) { ChunkCacheInstall(lS, &lSP->mChunkCache); } },
+		{ "format", [](ScriptProcessor *lSP, lua_State *lS) { FormatInstall(lS, lSP); } },
+		{ "scheduler", [](ScriptProcessor *lSP, lua_State *lS) { SchedulerInstall(lS, lSP); } },
+		{ "memory", [](ScriptProcessor *lSP, lua_State *lS) { MemoryInstall(lS, lSP); } },
+		{ "collector", [](ScriptProcessor *lSP, lua_State *lS) { GcPolicyInstall(lS, &lSP->mGcPolicy); } },
+		{ "script", [](ScriptProcessor *lSP, lua_State *lS) { ScriptStoreInstall(lS, lSP); } },
+		{ "operations", [](ScriptProcessor *, lua_State *lS) { OperationsInstall(lS); } },
+		{ "responsecache", [](ScriptProcessor *, lua_State *lS) { ResponseCacheInstall(lS); } },
+		{ "admission", [](ScriptProcessor *lSP, lua_State *lS) { AdmissionInstall(lS, lSP); } },
+	};
+
+	for (const Subsystem &lSubsystem : sSubsystems)
+	{
+		if (strcmp(lSubsystem.mName, lName) == 0)
+		{
+			return &lSubsystem;
+		}
+	}
+
+	return nullptr;
 }
 
-ssize_t WAIHandler(const char *lBuffer, size_t lLength)
+bool ScriptProcessor::InstallSubsystem(lua_State *lState, const char *lName)
 {
-#if 0
-	Lock();
-	Unlock();
-#else
-#endif
-	return 0;
+	const Subsystem *lSubsystem = FindSubsystem(lName);
+	if (!lSubsystem)
+	{
+		return false;
+	}
+
+	lSubsystem->mInstall(this, lState);
+	mStartupTimes.mLazyInstalls++;
+	return true;
 }
 
-ssize_t ESEHandler(const char *lBuffer, size_t lLength)
+/*
+ * __index(_G, name) of the globals table
+ */
+int ScriptProcessor::LoadSubsystem(lua_State *lState)
 {
-#if 0
-	Lock();
-	uint16_t lValue = 0;
-	int lCount = sscanf(lBuffer, "%*s %hu", &lValue);	// Ignore the command
-	if(lCount == 1) {
-		// TODO: gPlatformStatus.SetEventEnableRegister(lValue);
-	}
-	else {
-		// ERROR
+	Lua lLua(lState);
+
+	ScriptProcessor *lScriptProcessor = static_cast<ScriptProcessor *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+	if (lLua.Type(2) != LUA_TSTRING || !lScriptProcessor->InstallSubsystem(lState, lLua.ToString(2)))
+	{
+		lLua.PushNil();
+		return 1;
 	}
-	Unlock();
-#else
-#endif
-	return 0;
+
+	lLua.PushValue(2);
+	lLua.RawGet(1);
+	return 1;
 }
 
-ssize_t ESEQHandler(const char *lBuffer, size_t lLength)
+void ScriptProcessor::StartLua(void)
 {
-	return gScriptProcessor->HandleCommand(ESE_Q_CMD, strlen(ESE_Q_CMD), false);
+	chrono::steady_clock::time_point lStart = chrono::steady_clock::now();
+
+	OpenLibs();
+
+	chrono::steady_clock::time_point lLibraries = chrono::steady_clock::now();
+
+	BackdoorInstall(mState);
+	// stack: * = top
+	PushStatelessGlobalClosure("delay", StatelessScriptProcessor::Delay);	// *
+	PushStatelessGlobalClosure("print", StatelessScriptProcessor::Print);	// *
+	PushStatelessGlobalClosure("stb", StatelessScriptProcessor::ReadStb);	// *
+
+	InitDeviceTable(mState);
+	InitSessionEnvironment(mState);
+
+	// The rest of the subsystem tables are left to LoadSubsystem()
+	PushGlobalTable();
+	NewTable();
+	PushLightUserData(this);
+	PushCClosure(ScriptProcessor::LoadSubsystem, 1);
+	SetField(-2, "__index");
+	SetMetaTable(-2);
+	Pop(1);
+
+	mGcPolicy.Apply(*this);
+
+	chrono::steady_clock::time_point lTables = chrono::steady_clock::now();
+
+	/*
+	 * Stack: (top down)
+	 * 		: *
+	 */
+
+	// Everything is in place for the saved scripts
+	mScriptStore.Restore(*this);
+
+	SetTop(0);
+
+	chrono::steady_clock::time_point lScripts = chrono::steady_clock::now();
+
+	mStartupTimes.mLibraries = chrono::duration_cast<chrono::microseconds>(lLibraries - lStart);
+	mStartupTimes.mTables = chrono::duration_cast<chrono::microseconds>(lTables - lLibraries);
+	mStartupTimes.mScripts = chrono::duration_cast<chrono::microseconds>(lScripts - lTables);
 }
 
-ssize_t ESRQHandler(const char *lBuffer, size_t lLength)
+/*
+ * Run on the script processor thread before it takes any commands, once
+ * gScriptProcessor is set for print() and friends. Nobody asked for what
+ * the scripts print.
+ */
+void ScriptProcessor::Autorun(void)
 {
-	return gScriptProcessor->HandleCommand(ESR_Q_CMD, strlen(ESR_Q_CMD), false);
+	chrono::steady_clock::time_point lStart = chrono::steady_clock::now();
+
+	mScriptStore.Autorun(*this);
+
+	SetTop(0);
+	mSession->ClearOutput();
+
+	mStartupTimes.mAutorun = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - lStart);
 }
 
-ssize_t SREHandler(const char *lBuffer, size_t lLength)
+/*
+ * Called by the script processor thread right before it takes its first
+ * command. Prints where start-up went; information.startuptime has the total.
+ */
+void ScriptProcessor::Ready(chrono::steady_clock::time_point lProcessStart)
 {
-	return 0;
+	mStartupTimes.mReady = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - lProcessStart);
+
+	printf("Ready in %lld us (libraries %lld us, tables %lld us, scripts %lld us, autorun %lld us)\n",
+		   static_cast<long long>(mStartupTimes.mReady.count()),
+		   static_cast<long long>(mStartupTimes.mLibraries.count()),
+		   static_cast<long long>(mStartupTimes.mTables.count()),
+		   static_cast<long long>(mStartupTimes.mScripts.count()),
+		   static_cast<long long>(mStartupTimes.mAutorun.count()));
 }
 
-ssize_t SREQHandler(const char *lBuffer, size_t lLength)
+static void BudgetHook(lua_State *lState, lua_Debug *lDebug)
 {
-	return gScriptProcessor->HandleCommand(SRE_Q_CMD, strlen(SRE_Q_CMD), false);
+	(void)lDebug;
+
+	gScriptProcessor->Charge(lState);
 }
 
-ssize_t STBQHandler(const char *lBuffer, size_t lLength)
+CommandMessage *ScriptProcessor::Receive(void)
 {
-	return gScriptProcessor->HandleCommand(STB_Q_CMD, strlen(STB_Q_CMD), false);
+	ReleaseLuaSessions();
+
+	/*
+	 * Collection work goes here, between commands. While scripts are
+	 * suspended, only one step: they may be due any moment.
+	 */
+	chrono::steady_clock::time_point lWakeTime;
+	if (GetWakeTime(lWakeTime))
+	{
+		if (mGcPolicy.GetBetweenCommands() && mGcPolicy.GetIdleStep())
+		{
+			mGcPolicy.Step(*this);
+		}
+		return gSessionManager.Next(&mSession, &lWakeTime);
+	}
+
+	mGcPolicy.Idle(*this);
+
+	return gSessionManager.Next(&mSession);
 }
 
-ScriptProcessor::ScriptProcessor(void)
-: Endpoint()
-, Lua()
+/*
+ * Session states are made on first use rather than when the session is
+ * registered: the transports run on their own threads and must not touch Lua.
+ * A thread and a table are all it takes.
+ */
+LuaSession &ScriptProcessor::GetLuaSession(ClientSession *lSession)
 {
-	mOutputString.clear();
+	auto lFound = mLuaSessions.find(lSession->GetId());
+	if (lFound != mLuaSessions.end())
+	{
+		return lFound->second;
+	}
 
-	pthread_mutex_init(&mLock, nullptr);
+	LuaSession lLuaSession;
+
+	lLuaSession.mSession = lSession;
+	lLuaSession.mMessage = nullptr;
+	lLuaSession.mResume = 0;
+	lLuaSession.mMark = 0;
+	lLuaSession.mSliceUsed = 0;
+	lLuaSession.mScriptUsed = 0;
+	lLuaSession.mPreemptions = 0;
+	lLuaSession.mCapturing = false;
+	lLuaSession.mRunCaptured = false;
+	lLuaSession.mThread = NewThread();
+	lLuaSession.mThreadReference = Ref(LUA_REGISTRYINDEX);
+
+	Lua lThread(lLuaSession.mThread);
+	lThread.SetHook(BudgetHook, LUA_MASKCOUNT, SCRIPT_HOOK_INTERVAL);
+
+	NewTable();
+	PushValue(-1);
+	SetField(-2, "_G");
+	PushLightUserData(const_cast<char *>(sSessionEnvironmentIndex));
+	GetTable(LUA_REGISTRYINDEX);
+	SetMetaTable(-2);
+	lLuaSession.mEnvironmentReference = Ref(LUA_REGISTRYINDEX);
 
-	InstallTokenHandlers();
-	StartLua();
+	return mLuaSessions.emplace(lSession->GetId(), lLuaSession).first->second;
 }
 
-ScriptProcessor::~ScriptProcessor()
+/*
+ * Drops the states of sessions that have been unregistered, along with the
+ * chunks compiled against their environments. A transfer the session still
+ * had suspended is dropped with its script; the session manager has already
+ * released the session itself, which may be gone by now.
+ *
+ * Then drops the suspended transfers of sessions that have been cleared, and
+ * releases those sessions, without sending a response.
+ */
+void ScriptProcessor::ReleaseLuaSessions(void)
 {
-}
+	gSessionManager.TakeRetired(mRetired);
+
+	for (uint64_t lId : mRetired)
+	{
+		auto lFound = mLuaSessions.find(lId);
+		if (lFound == mLuaSessions.end())
+		{
+			continue;
+		}
 
-int ScriptProcessor::InfoHandler(lua_State *lState) {
+		if (lFound->second.mMessage)
+		{
+			DropSuspended(lFound->second);
+		}
 
-	int lRet = 0;
+		RawGetI(LUA_REGISTRYINDEX, lFound->second.mEnvironmentReference);
+		mChunkCache.Invalidate(*this, ToPointer(-1));
+		Pop(1);
 
-	Lua lLua(lState);
+		Unref(LUA_REGISTRYINDEX, lFound->second.mEnvironmentReference);
+		Unref(LUA_REGISTRYINDEX, lFound->second.mThreadReference);
+		mLuaSessions.erase(lFound);
+	}
 
-	DebugFunctions lFunc = static_cast<DebugFunctions>(lLua.ToInteger(lLua.UpValueIndex(2)));
+	mRetired.clear();
+
+	gSessionManager.TakeCleared(mCleared);
+
+	for (uint64_t lId : mCleared)
+	{
+		auto lFound = mLuaSessions.find(lId);
 
-	switch(lFunc) {
-	case FUNC_GET_MANUFACTURER:
-		lLua.PushString(MANUFACTURER);
-		lRet = 1;
-		break;
-	case FUNC_GET_MODEL:
-		lLua.PushString(MODEL);
-		lRet = 1;
-		break;
-	case FUNC_GET_SERIAL:
-		lLua.PushString(SERIAL);
-		lRet = 1;
-		break;
+		// Resumed and finished since, or unregistered and left for the next pass
+		if (lFound == mLuaSessions.end() || !lFound->second.mMessage || !gSessionManager.Unpark(lId))
+		{
+			continue;
+		}
+
+		DropSuspended(lFound->second);
+		Lock();
+		lFound->second.mSession->ClearOutput();
+		Unlock();
+		gSessionManager.Complete(lFound->second.mSession);
 	}
 
-	return lRet;
+	mCleared.clear();
 }
 
-void ScriptProcessor::InstallTokenHandlers(void)
+void ScriptProcessor::DropSuspended(LuaSession &lLuaSession)
 {
-	RegisterHandler(IDNQHandler, IDN_Q_IDX);
-	RegisterHandler(CLSHandler, CLS_IDX);
-	RegisterHandler(RSTHandler, RST_IDX);
-	RegisterHandler(TSTQHandler, TST_Q_IDX);
-	RegisterHandler(OPCHandler, OPC_IDX);
-	RegisterHandler(OPCQHandler, OPC_Q_IDX);
-	RegisterHandler(WAIHandler, WAI_IDX);
-	RegisterHandler(ESEHandler, ESE_IDX);
-	RegisterHandler(ESEQHandler, ESE_Q_IDX);
-	RegisterHandler(ESRQHandler, ESR_Q_IDX);
-	RegisterHandler(SREHandler, SRE_IDX);
-	RegisterHandler(SREQHandler, SRE_Q_IDX);
-	RegisterHandler(STBQHandler, STB_Q_IDX);
+	Lua lThread(lLuaSession.mThread);
+	lThread.CloseThread(mState);
+
+	delete lLuaSession.mMessage;
+	lLuaSession.mMessage = nullptr;
+	lLuaSession.mReady = nullptr;
+	lLuaSession.mProgress = Scpi::Progress();
 }
 
-void ScriptProcessor::StartLua(void)
+// First word of a line, letters only
+static string_view GetKeyword(const char *lText, size_t lLength)
 {
-	OpenLibs();
+	size_t lStart = 0;
+	while (lStart < lLength && isspace(static_cast<unsigned char>(lText[lStart])))
+	{
+		lStart++;
+	}
 
-	BackdoorInstall(mState);
-	// stack: * = top
-	PushStatelessGlobalClosure("delay", StatelessScriptProcessor::Delay);	// *
-	PushStatelessGlobalClosure("print", StatelessScriptProcessor::Print);	// *
-	PushStatelessGlobalClosure("stb", StatelessScriptProcessor::ReadStb);	// *
+	size_t lEnd = lStart;
+	while (lEnd < lLength && isalpha(static_cast<unsigned char>(lText[lEnd])))
+	{
+		lEnd++;
+	}
 
-	InitDeviceTable(mState);
+	// "loadscriptx" is not "loadscript"
+	if (lEnd < lLength && (isalnum(static_cast<unsigned char>(lText[lEnd])) || lText[lEnd] == '_'))
+	{
+		return string_view();
+	}
 
-	GetDeviceTable(this);
+	return string_view(lText + lStart, lEnd - lStart);
+}
 
-	/*
-	 * Stack: (top down)
-	 * 		: * DeviceTable
-	 */
-	InfoInstall(mState);
-	LedInstall(mState);
-	StatusInstall(mState);
-	ErrorsInstall(mState);
+static bool IsBlank(const char *lText, size_t lLength)
+{
+	for (size_t lIndex = 0; lIndex < lLength; lIndex++)
+	{
+		if (!isspace(static_cast<unsigned char>(lText[lIndex])))
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
-	/*
-	 * Pop off the DeviceTable
-	 */
-	Pop(1);
+// A line that is just the label of an enabled macro with a Lua body
+static const Scpi::Macro *FindScriptMacro(const char *lText, size_t lLength)
+{
+	string_view lLine(lText, lLength);
+	lLine.remove_prefix(min(lLine.find_first_not_of(" \t"), lLine.length()));
+	lLine = lLine.substr(0, lLine.find_last_not_of(" \t\r") + 1);
 
-	/*
-	 * Stack: (top down)
-	 * 		: *
-	 */
+	const Scpi::Macro *lMacro = Scpi::gMacros.FindExpandable(lLine);
+	return (lMacro && !lMacro->mScpi) ? lMacro : nullptr;
+}
 
-	SetTop(0);
+/*
+ * Responses of the program messages in one transfer are separated by ';'. The
+ * separator is put down before each one runs and taken back if it printed
+ * nothing.
+ */
+static size_t BeginResponse(string &lOutput)
+{
+	size_t lMark = lOutput.length();
+	if (lMark)
+	{
+		lOutput += ';';
+	}
+	return lMark;
 }
 
-int ScriptProcessor::HandleCommand(const char *lBuffer, size_t lLength, bool lCheckTokens)
+static void EndResponse(string &lOutput, size_t lMark)
 {
-	bool lMatched = false;
+	if (lMark && lOutput.length() == lMark + 1)
+	{
+		lOutput.resize(lMark);
+	}
+}
+
+/*
+ * A transfer may hold several newline separated program messages. Each one
+ * made of SCPI headers is executed natively from the compiled command tree
+ * (';' separated units included); consecutive lines of anything else are
+ * collected and run as a single Lua chunk, in order with the SCPI ones. A
+ * line that is the label of a macro with a Lua body runs that body.
+ * Everything is answered in one reply.
+ *
+ * Returns LUA_YIELD when a script suspended; the rest of the transfer is
+ * handled when it is resumed.
+ */
+int ScriptProcessor::HandleCommand(const char *lBuffer, size_t lLength, bool lCheckScpi)
+{
+	if (!lCheckScpi)
+	{
+		return RunBatch(lBuffer, 0, lLength, lLength);
+	}
 
-	if (lCheckTokens)
+	return HandleLines(lBuffer, lLength, 0);
+}
+
+int ScriptProcessor::HandleLines(const char *lBuffer, size_t lLength, size_t lStart)
+{
+	LuaSession &lLuaSession = GetLuaSession(mSession);
+	string &lOutput = mSession->GetOutput();
+	ProgramMessage::Scanner lScanner;
+	size_t lScriptStart = 0;
+	size_t lScriptEnd = 0;			// Lua lines not run yet
+	int lResult = 0;
+
+	while (lStart < lLength)
 	{
-		for (size_t lIndex=0; lIndex<mNumTokens; lIndex++)
+		size_t lEnd = lScanner.FindEnd(lBuffer + lStart, lLength - lStart, sProgramMessageTerminator);
+		lEnd = (lEnd == string::npos) ? lLength : lStart + lEnd;
+		lScanner.Reset();
+
+		const char *lLine = lBuffer + lStart;
+		size_t lLineLength = lEnd - lStart;
+
+		if (lLuaSession.mCapturing)
 		{
-			if(!strncmp(lBuffer, mTokens[lIndex], 5))
+			if (GetKeyword(lLine, lLineLength) == "endscript")
+			{
+				lResult = EndCapture(lLuaSession, lEnd + 1);
+				if (lResult == LUA_YIELD)
+				{
+					return lResult;
+				}
+			}
+			else
 			{
-				lMatched = true;
-				mTokenHandlers[lIndex](lBuffer, lLength);
+				lLuaSession.mCapture.append(lLine, lLineLength);
+				lLuaSession.mCapture += '\n';
+			}
+		}
+		else if (IsBlank(lLine, lLineLength))
+		{
+			// Nothing to run; a Lua run carries on across it
+		}
+		else if (GetKeyword(lLine, lLineLength) == "loadscript" || GetKeyword(lLine, lLineLength) == "loadandrunscript")
+		{
+			if (lScriptEnd > lScriptStart)
+			{
+				lResult = RunBatch(lBuffer, lScriptStart, lScriptEnd, lStart);
+				if (lResult == LUA_YIELD)
+				{
+					return lResult;
+				}
+				lScriptStart = lScriptEnd = 0;
+			}
 
-				break;
+			BeginCapture(lLuaSession, lLine, lLineLength);
+		}
+		else if (const Scpi::Macro *lMacro = FindScriptMacro(lLine, lLineLength))
+		{
+			if (lScriptEnd > lScriptStart)
+			{
+				lResult = RunBatch(lBuffer, lScriptStart, lScriptEnd, lStart);
+				if (lResult == LUA_YIELD)
+				{
+					return lResult;
+				}
+				lScriptStart = lScriptEnd = 0;
+			}
+
+			// Compiled when it was defined; if it suspends, the transfer carries on after this line
+			lResult = RunBatch(lMacro->mBody.data(), 0, lMacro->mBody.length(), lEnd + 1);
+			if (lResult == LUA_YIELD)
+			{
+				return lResult;
+			}
+		}
+		else if (Scpi::IsCommand(lLine, lLineLength))
+		{
+			if (lScriptEnd > lScriptStart)
+			{
+				// Resumes at this line if the script suspends
+				lResult = RunBatch(lBuffer, lScriptStart, lScriptEnd, lStart);
+				if (lResult == LUA_YIELD)
+				{
+					return lResult;
+				}
+				lScriptStart = lScriptEnd = 0;
+			}
+
+			// A held line carries on where it stopped, inside its own response
+			Scpi::Progress lProgress = lLuaSession.mProgress;
+			lLuaSession.mProgress = Scpi::Progress();
+			size_t lMark = lProgress.mHeld ? lLuaSession.mMark : BeginResponse(lOutput);
+
+			Scpi::Dispatch(lLine, lLineLength, mSession, &lProgress);
+			if (lProgress.mHeld)
+			{
+				lLuaSession.mProgress = lProgress;
+				lLuaSession.mWakeTime = chrono::steady_clock::time_point::max();
+				lLuaSession.mReady = [] { return gOperations.IsComplete(); };
+				Park(lStart, lMark);
+				return LUA_YIELD;
+			}
+			EndResponse(lOutput, lMark);
+
+			// Only a transfer that is nothing but this query can be answered from the cache
+			if (lProgress.mCacheable && lStart == 0 && lEnd + 1 >= lLength)
+			{
+				mCacheable = true;
+				mCacheKey = lProgress.mCacheKey;
 			}
 		}
+		else
+		{
+			if (lScriptEnd == lScriptStart)
+			{
+				lScriptStart = lStart;
+			}
+			lScriptEnd = lEnd;
+		}
+
+		lStart = lEnd + 1;
 	}
 
-	if (!lMatched)
+	if (lScriptEnd > lScriptStart)
 	{
+		lResult = RunBatch(lBuffer, lScriptStart, lScriptEnd, lLength);
+	}
+
+	return lResult;
+}
 
-		int lResult = RunScript(lBuffer, strlen(lBuffer));
+/*
+ * Runs lines [lScriptStart, lScriptEnd) of the transfer as one chunk. If it
+ * suspends, the transfer is parked to carry on from lResume.
+ */
+int ScriptProcessor::RunBatch(const char *lBuffer, size_t lScriptStart, size_t lScriptEnd, size_t lResume)
+{
+	string &lOutput = mSession->GetOutput();
+	size_t lMark = BeginResponse(lOutput);
 
+	int lResult = RunScript(lBuffer + lScriptStart, lScriptEnd - lScriptStart);
+	if (lResult == LUA_YIELD)
+	{
+		Park(lResume, lMark);
 		return lResult;
 	}
 
-	return 0;
+	EndResponse(lOutput, lMark);
+	return lResult;
+}
+
+/*
+ * loadscript [name] or loadandrunscript [name]: the lines that follow, up to
+ * endscript, are the script's source rather than commands.
+ */
+void ScriptProcessor::BeginCapture(LuaSession &lLuaSession, const char *lLine, size_t lLength)
+{
+	string_view lKeyword = GetKeyword(lLine, lLength);
+	string_view lName(lKeyword.data() + lKeyword.length(), lLine + lLength - (lKeyword.data() + lKeyword.length()));
+
+	lName.remove_prefix(min(lName.find_first_not_of(" \t"), lName.length()));
+	lName = lName.substr(0, lName.find_last_not_of(" \t\r") + 1);
+
+	lLuaSession.mCapturing = true;
+	lLuaSession.mRunCaptured = (lKeyword == "loadandrunscript");
+	lLuaSession.mCaptureName = lName.empty() ? SCRIPT_ANONYMOUS_NAME : string(lName);
+	lLuaSession.mCapture.clear();
+}
+
+/*
+ * endscript: defines the captured script, and runs it for loadandrunscript.
+ * If that run suspends, the transfer carries on from lResume.
+ */
+int ScriptProcessor::EndCapture(LuaSession &lLuaSession, size_t lResume)
+{
+	lLuaSession.mCapturing = false;
+
+	string lName = move(lLuaSession.mCaptureName);
+	string lSource = move(lLuaSession.mCapture);
+
+	if (!ScriptStore::IsValidName(lName))
+	{
+		printf("Error loading script: '%s' is not a valid name\n", lName.c_str());
+		return LUA_ERRSYNTAX;
+	}
+
+	int lResult = mScriptStore.Define(*this, lName, move(lSource));
+	if (lResult != LUA_OK)
+	{
+		printf("Error loading script %s: %s\n", lName.c_str(), ToString(-1));
+		SetTop(0);
+		return lResult;
+	}
+
+	if (!lLuaSession.mRunCaptured)
+	{
+		return lResult;
+	}
+
+	string &lOutput = mSession->GetOutput();
+	size_t lMark = BeginResponse(lOutput);
+
+	lResult = RunStoredScript(lName);
+	if (lResult == LUA_YIELD)
+	{
+		Park(lResume, lMark);
+		return lResult;
+	}
+
+	EndResponse(lOutput, lMark);
+	return lResult;
 }
 
+/*
+ * The chunk is compiled in the template state against the session's
+ * environment, then moved over to the session's thread and started there as
+ * a coroutine.
+ */
 int ScriptProcessor::RunScript(const char *lScript, size_t lLength)
 {
-	int lResult = LoadString(lScript);
+	LuaSession &lLuaSession = GetLuaSession(mSession);
+
+	// Compiling is charged to the session too
+	gLuaAllocator.SetAccount(&lLuaSession.mMemory);
+
+	RawGetI(LUA_REGISTRYINDEX, lLuaSession.mEnvironmentReference);
+	int lResult = mChunkCache.Load(*this, lScript, lLength, sChunkName, -1);
 
 	if(lResult)
 	{
 		printf("Error load lua buffer: %s\n", ToString(-1));
+		SetTop(0);
+		gLuaAllocator.SetAccount(nullptr);
 		return lResult;
 	}
 
-	lResult = PCall(0, LUA_MULTRET, 0);
+	return StartThread(lLuaSession);
+}
+
+/*
+ * Compiles a chunk for the session into the chunk cache without running it,
+ * so that its first RunScript() is a cache hit (a Lua macro body).
+ */
+int ScriptProcessor::PrepareScript(const char *lScript, size_t lLength)
+{
+	LuaSession &lLuaSession = GetLuaSession(mSession);
+
+	gLuaAllocator.SetAccount(&lLuaSession.mMemory);
+
+	RawGetI(LUA_REGISTRYINDEX, lLuaSession.mEnvironmentReference);
+	int lResult = mChunkCache.Load(*this, lScript, lLength, sChunkName, -1);
+
 	if(lResult)
 	{
-		printf("Error running lua: %s\n", ToString(-1));
+		printf("Error load lua buffer: %s\n", ToString(-1));
 	}
 
+	SetTop(0);
+	gLuaAllocator.SetAccount(nullptr);
 	return lResult;
 }
 
+/*
+ * A stored script runs from its bytecode, loaded against the session's
+ * environment.
+ */
+int ScriptProcessor::RunStoredScript(const string &lName)
+{
+	LuaSession &lLuaSession = GetLuaSession(mSession);
+
+	gLuaAllocator.SetAccount(&lLuaSession.mMemory);
+
+	RawGetI(LUA_REGISTRYINDEX, lLuaSession.mEnvironmentReference);
+	int lResult = mScriptStore.Load(*this, lName, -1);
+
+	if(lResult)
+	{
+		printf("Error loading script %s: %s\n", lName.c_str(), ToString(-1));
+		SetTop(0);
+		gLuaAllocator.SetAccount(nullptr);
+		return lResult;
+	}
+
+	return StartThread(lLuaSession);
+}
+
+// Starts the function on top of the stack on the session's thread
+int ScriptProcessor::StartThread(LuaSession &lLuaSession)
+{
+	XMove(mState, lLuaSession.mThread, 1);
+	SetTop(0);
+
+	lLuaSession.mScriptUsed = 0;
+	return ResumeThread(lLuaSession);
+}
+
+int ScriptProcessor::ResumeThread(LuaSession &lLuaSession)
+{
+	Lua lThread(lLuaSession.mThread);
+	int lResults;
+
+	lLuaSession.mSliceUsed = 0;
+	lLuaSession.mSliceStart = chrono::steady_clock::now();
+	gLuaAllocator.SetAccount(&lLuaSession.mMemory);
+
+	// Taken from the policy now in case the script changes it
+	bool lHold = mGcPolicy.GetBetweenCommands();
+	if (lHold)
+	{
+		mGcPolicy.Hold(*this);
+	}
+
+	int lResult = lThread.Resume(mState, 0, &lResults);
+
+	if (lHold)
+	{
+		mGcPolicy.Release(*this);
+	}
+
+	if (lResult == LUA_YIELD)
+	{
+		lThread.Pop(lResults);
+		gLuaAllocator.SetAccount(nullptr);
+		return lResult;
+	}
+
+	if(lResult)
+	{
+		printf("Error running lua: %s\n", lThread.ToString(-1));
+
+		// A coroutine that raised an error is dead until it is reset
+		lThread.CloseThread(mState);
+	}
+
+	// Nothing is left behind for the next command
+	lThread.SetTop(0);
+	gLuaAllocator.SetAccount(nullptr);
+
+	return lResult;
+}
+
+void ScriptProcessor::Park(size_t lResume, size_t lMark)
+{
+	LuaSession &lLuaSession = GetLuaSession(mSession);
+
+	lLuaSession.mResume = lResume;
+	lLuaSession.mMark = lMark;
+}
+
+/*
+ * Runs on the interface thread that sent lMessage. Status queries and cached
+ * responses are answered right here while the session is idle, so they are
+ * neither held up by another session's script nor ahead of this session's
+ * own responses.
+ */
+int ScriptProcessor::Deliver(CommandMessage *lMessage)
+{
+	Endpoint *lOrigin = reinterpret_cast<Endpoint *>(lMessage->GetOrigin());
+	string lResponse;
+
+	if (gSessionManager.IsIdle(lOrigin) &&
+		(Scpi::AnswerStatusQueries(lMessage->GetData(), lMessage->GetLength(), lResponse) ||
+		 gResponseCache.Find(lMessage->GetData(), lMessage->GetLength(), lResponse)))
+	{
+		CommandMessage *lReplyMessage = BuildMessage(lResponse, lOrigin);
+		lReplyMessage->SetTag(lMessage->GetTag());
+		if (!Send(lReplyMessage))
+		{
+			delete lMessage;
+			return 0;
+		}
+		delete lReplyMessage;
+	}
+
+	return gSessionManager.Submit(lMessage);
+}
+
+void ScriptProcessor::Process(CommandMessage *lMessage)
+{
+	mCacheable = false;
+
+	int lResult = HandleCommand(lMessage->GetData(), lMessage->GetLength());
+	if (lResult == LUA_YIELD)
+	{
+		// The session stays active, so it is given nothing else until this is done
+		GetLuaSession(mSession).mMessage = lMessage;
+		gSessionManager.Park(mSession);
+		mSession = gSessionManager.GetDefaultSession();
+		return;
+	}
+
+	if (lResult == LUA_OK)
+	{
+		const string &lOutput = mSession->GetOutput();
+		if (mCacheable)
+		{
+			gResponseCache.Store(lMessage->GetData(), lMessage->GetLength(), lOutput, mCacheKey);
+		}
+		else
+		{
+			gResponseCache.Offer(lMessage->GetData(), lMessage->GetLength(), lOutput);
+		}
+	}
+
+	Finish(lMessage);
+}
+
+void ScriptProcessor::Finish(CommandMessage *lMessage)
+{
+	if (GetCount() > 0)
+	{
+		CommandMessage *lReplyMessage = BuildMessage(GetData(), GetCount(), reinterpret_cast<Endpoint *>(lMessage->GetOrigin()));
+		lReplyMessage->SetTag(lMessage->GetTag());
+		if (Send(lReplyMessage))
+		{
+			delete lReplyMessage;
+		}
+
+		ClearData();
+	}
+
+	delete lMessage;
+	Complete();
+}
+
+/*
+ * Called from a C function running on a session's thread: yields the script
+ * until lWakeTime, or until lReady returns true if that is sooner.
+ */
+int ScriptProcessor::Suspend(lua_State *lState, chrono::steady_clock::time_point lWakeTime, function<bool(void)> lReady)
+{
+	Lua lLua(lState);
+	LuaSession &lLuaSession = GetLuaSession(mSession);
+
+	lLuaSession.mWakeTime = lWakeTime;
+	lLuaSession.mReady = lReady;
+
+	return lLua.Yield(0);
+}
+
+/*
+ * Whether a C function called on lState can Suspend() the script. Only the
+ * session thread itself can: yielding from inside a coroutine the script made
+ * would just return from the script's own resume().
+ */
+bool ScriptProcessor::CanSuspend(lua_State *lState)
+{
+	Lua lLua(lState);
+
+	return lState == GetLuaSession(mSession).mThread && lLua.IsYieldable();
+}
+
+/*
+ * Count hook of every session thread, called each SCRIPT_HOOK_INTERVAL
+ * instructions of the running script.
+ */
+void ScriptProcessor::Charge(lua_State *lState)
+{
+	LuaSession &lLuaSession = GetLuaSession(mSession);
+	const ScriptBudget &lBudget = lLuaSession.mBudget;
+	Lua lLua(lState);
+
+	lLuaSession.mSliceUsed += SCRIPT_HOOK_INTERVAL;
+	lLuaSession.mScriptUsed += SCRIPT_HOOK_INTERVAL;
+
+	if (lBudget.mScriptInstructions && lLuaSession.mScriptUsed > lBudget.mScriptInstructions)
+	{
+		luaL_error(lState, "script exceeded its limit of %I instructions", static_cast<lua_Integer>(lBudget.mScriptInstructions));
+	}
+
+	/*
+	 * Nowhere to yield to from inside a metamethod or a C call; it runs on.
+	 * Coroutines the script made inherit this hook, but yielding one of those
+	 * would return early from the script's own resume(): the slice runs on
+	 * until control is back on the session thread.
+	 */
+	if (lState != lLuaSession.mThread || !lLua.IsYieldable())
+	{
+		return;
+	}
+
+	chrono::steady_clock::time_point lNow = chrono::steady_clock::now();
+
+	if ((lBudget.mSliceInstructions && lLuaSession.mSliceUsed >= lBudget.mSliceInstructions)
+			|| (lBudget.mSliceTime.count() && lNow - lLuaSession.mSliceStart >= lBudget.mSliceTime))
+	{
+		lLuaSession.mPreemptions++;
+		Suspend(lState, lNow);
+	}
+}
+
+/*
+ * Resumes every suspended script that is due, then carries on with the rest
+ * of its transfer, which may suspend it again.
+ */
+void ScriptProcessor::ResumeSuspended(void)
+{
+	gOperations.Poll();
+
+	chrono::steady_clock::time_point lNow = chrono::steady_clock::now();
+
+	for (auto &[lId, lLuaSession] : mLuaSessions)
+	{
+		if (lLuaSession.mMessage && (lNow >= lLuaSession.mWakeTime || (lLuaSession.mReady && lLuaSession.mReady())))
+		{
+			mWaking.push_back(lId);
+		}
+	}
+
+	for (uint64_t lId : mWaking)
+	{
+		// Left for ReleaseLuaSessions() once its session has gone
+		if (!gSessionManager.Unpark(lId))
+		{
+			continue;
+		}
+
+		LuaSession &lLuaSession = mLuaSessions.at(lId);
+		CommandMessage *lMessage = lLuaSession.mMessage;
+
+		mSession = lLuaSession.mSession;
+		lLuaSession.mMessage = nullptr;
+		lLuaSession.mReady = nullptr;
+
+		int lResult;
+		if (lLuaSession.mProgress.mHeld)
+		{
+			lResult = HandleLines(lMessage->GetData(), lMessage->GetLength(), lLuaSession.mResume);
+		}
+		else
+		{
+			lResult = ResumeThread(lLuaSession);
+			if (lResult != LUA_YIELD)
+			{
+				EndResponse(mSession->GetOutput(), lLuaSession.mMark);
+				lResult = HandleLines(lMessage->GetData(), lMessage->GetLength(), lLuaSession.mResume);
+			}
+		}
+
+		if (lResult == LUA_YIELD)
+		{
+			lLuaSession.mMessage = lMessage;
+			gSessionManager.Park(mSession);
+			mSession = gSessionManager.GetDefaultSession();
+			continue;
+		}
+
+		Finish(lMessage);
+	}
+
+	mWaking.clear();
+}
+
+/*
+ * Earliest time a suspended script has to be looked at again, if there is
+ * one. Scripts waiting on an event are polled at least every SCRIPT_MAX_WAIT.
+ * The end of a timed operation counts too, so *OPC sets its bit on time.
+ */
+bool ScriptProcessor::GetWakeTime(chrono::steady_clock::time_point &lWakeTime)
+{
+	bool lSuspended = gOperations.GetNextEnd(lWakeTime);
+
+	for (auto &[lId, lLuaSession] : mLuaSessions)
+	{
+		if (!lLuaSession.mMessage)
+		{
+			continue;
+		}
+
+		chrono::steady_clock::time_point lTime = lLuaSession.mWakeTime;
+		if (lLuaSession.mReady)
+		{
+			lTime = min(lTime, chrono::steady_clock::now() + SCRIPT_MAX_WAIT);
+		}
+
+		lWakeTime = lSuspended ? min(lWakeTime, lTime) : lTime;
+		lSuspended = true;
+	}
+
+	return lSuspended;
+}
+
 void ScriptProcessor::PushGlobalClosure(const char *lName, lua_CFunction lFunc, int lNumUpValues)
 {
 	/*
@@ -338,14 +1076,6 @@ void ScriptProcessor::PushStatelessGlobalClosure(const char *lName, lua_CFunctio
 	PushGlobalClosure(lName, lFunc, 1);
 }
 
-void ScriptProcessor::RegisterHandler(TokenHandler lHandler, size_t lIndex)
-{
-	if(mTokenHandlers[lIndex] == nullptr)
-	{
-		mTokenHandlers[lIndex] = lHandler;
-	}
-}
-
 void ScriptProcessor::BackdoorInstall(lua_State *lState) {
 
 	GetBackdoor();
@@ -473,30 +1203,70 @@ void ScriptProcessor::BackdoorInstall(lua_State *lState) {
 	 */
 }
 
+static int GetManufacturer(Lua &lLua, void *lObject) {
+	(void)lObject;
+	lLua.PushString(MANUFACTURER);
+	return 1;
+}
+
+static int GetModel(Lua &lLua, void *lObject) {
+	(void)lObject;
+	lLua.PushString(MODEL);
+	return 1;
+}
+
+static int GetSerial(Lua &lLua, void *lObject) {
+	(void)lObject;
+	lLua.PushString(SERIAL);
+	return 1;
+}
+
+static int GetStartupTime(Lua &lLua, void *lObject) {
+	chrono::duration<double> lReady = static_cast<ScriptProcessor *>(lObject)->GetStartupTimes().mReady;
+	lLua.PushNumber(lReady.count());
+	return 1;
+}
+
+static constexpr RotProperty sInfoProperties[] = {
+	{ "manufacturer", GetManufacturer, nullptr },
+	{ "model", GetModel, nullptr },
+	{ "serial", GetSerial, nullptr },
+	{ "startuptime", GetStartupTime, nullptr },
+};
+static constexpr RotTable sInfoTable{sInfoProperties};
+static constexpr RotLayout sInfoLayout = sInfoTable.GetLayout();
+
 void ScriptProcessor::InfoInstall(lua_State *lState)
 {
 	Lua lLua(lState);
 
-	// MakeTable
-	lLua.NewTable();
-	lLua.MakeTableReadOnly();
-
-	LuaUtils::AddGetter(lLua, "manufacturer", this, FUNC_GET_MANUFACTURER, ScriptProcessor::InfoHandler);
-	LuaUtils::AddGetter(lLua, "model", this, FUNC_GET_MODEL, ScriptProcessor::InfoHandler);
-	LuaUtils::AddGetter(lLua, "serial", this, FUNC_GET_SERIAL, ScriptProcessor::InfoHandler);
+	PushReadOnlyObject(lLua, sInfoLayout, this);
 
 	lLua.SetGlobal("information");
 }
 
+/*
+ * delay(microseconds) suspends the calling script and lets other sessions run
+ * meanwhile. Where a yield is not possible (inside a metamethod, say) it
+ * still sleeps.
+ */
 int StatelessScriptProcessor::Delay(lua_State *lState)
 {
-	useconds_t lInterval;
+	::Lua lLua(lState);
 
-	lInterval = lua_tonumber(lState, 1);
+	lua_Number lInterval = lLua.CheckNumber(1);
 
-	usleep(lInterval);
+	if (!gScriptProcessor->CanSuspend(lState))
+	{
+		usleep(static_cast<useconds_t>(lInterval));
+		return 0;
+	}
 
-	return 0;
+	// Pending for *OPC, *OPC? and *WAI until it is over
+	chrono::steady_clock::time_point lWakeTime = chrono::steady_clock::now() + chrono::microseconds(static_cast<int64_t>(lInterval));
+	gOperations.Begin("delay", lWakeTime);
+
+	return gScriptProcessor->Suspend(lState, lWakeTime);
 }
 
 int StatelessScriptProcessor::Print(lua_State *lState)
@@ -508,41 +1278,65 @@ int StatelessScriptProcessor::Print(lua_State *lState)
 	return lScriptProcessor->Print(&lLua);
 }
 
+/*
+ * Arguments are written straight into the session's response arena, separated
+ * by tabs like Lua's own print(). With a binary data format every run of
+ * numeric arguments is gathered and written as one arbitrary block.
+ */
 int StatelessScriptProcessor::Print(::Lua *lLua)
 {
-	size_t lPosition = 0;
-	char lBuffer[OUTPUT_BUFFER_SIZE];
+	static vector<double> sValues;		// only the script processor thread prints
+
+	ResponseWriter &lResponse = gScriptProcessor->GetSession()->GetResponse();
 	int lArgCount = lLua->GetTop();
-	lLua->GetGlobal("tostring");
 
 	for(int lIndex=1; lIndex<=lArgCount; ++lIndex)
 	{
+		size_t lLength;
+		const char *lText;
+
 		if(lIndex > 1) {
-			lBuffer[lPosition++] = '\t';
+			lResponse.Write('\t');
+		}
+
+		if(lResponse.IsBinary() && lLua->Type(lIndex) == LUA_TNUMBER) {
+			int lLast = lIndex;
+			while(lLast < lArgCount && lLua->Type(lLast + 1) == LUA_TNUMBER) {
+				lLast++;
+			}
+
+			sValues.clear();
+			for(int lValue=lIndex; lValue<=lLast; ++lValue) {
+				sValues.push_back(static_cast<double>(lLua->ToNumber(lValue)));
+			}
+			lResponse.WriteBlock(sValues.data(), sValues.size());
+			lIndex = lLast;
+			continue;
 		}
 
 		switch(lLua->Type(lIndex))
 		{
 		case LUA_TNUMBER:
-			lPosition += snprintf(lBuffer + lPosition, 250, "%1.*e", ASCII_DEFAULT_PRECISION-1, static_cast<double>(lLua->ToNumber(lIndex)));
+			if(lLua->IsInteger(lIndex)) {
+				lResponse.Write(static_cast<int64_t>(lLua->ToInteger(lIndex)));
+			}
+			else {
+				lResponse.Write(static_cast<double>(lLua->ToNumber(lIndex)));
+			}
 			break;
 		case LUA_TSTRING:
-			mOutputString += string(lLua->ToString(lIndex));
+			lText = lLua->ToLString(lIndex, &lLength);
+			lResponse.Write(string_view(lText, lLength));
 			break;
 		default:
-			lLua->PushValue(-1);
-			lLua->PushValue(lIndex);
-			static_cast<::BasicLua *>(lLua)->Call(1, 1);
-			lLua->Replace(lIndex);
-			mOutputString += string(lLua->ToString(lIndex));
+			// Honors __tostring and __name like tostring() does
+			lText = lLua->ToLStringAux(lIndex, &lLength);
+			lResponse.Write(string_view(lText, lLength));
+			lLua->Pop(1);
 			break;
 		}
 	}
 
-	if(lPosition) {
-		mOutputString += string(lBuffer);
-	}
-
 	return 0;
 }
 
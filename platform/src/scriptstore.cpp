@@ -0,0 +1,614 @@
+/*
+ * scriptstore.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binding.hpp"
+#include "scriptprocessor.hpp"
+#include "scriptstore.hpp"
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+struct BytecodeHeader
+{
+	uint32_t mMagic;
+	uint32_t mLuaVersion;
+	uint64_t mSourceHash;
+	uint64_t mLength;
+	uint64_t mBytecodeHash;		// of what follows, so a damaged cache is compiled again
+};
+
+static constexpr auto sScriptStoreBinding = Bind<ScriptStore>()
+	.Method<&ScriptStore::Save>("save")
+	.Method<&ScriptStore::Delete>("delete");
+
+static constexpr auto sScriptObjectBinding = Bind<ScriptObject>()
+	.Property<&ScriptObject::GetName>("name")
+	.Property<&ScriptObject::GetSource>("source")
+	.Property<&ScriptObject::IsAutorun, &ScriptObject::SetAutorun>("autorun")
+	.Method<&ScriptObject::Save>("save");
+
+void ScriptStoreInstall(lua_State *lState, ScriptProcessor *lScriptProcessor) {
+	ScriptStore *lStore = &lScriptProcessor->GetScriptStore();
+
+	Lua lLua(lState);
+
+	PushBound<sScriptStoreBinding>(lLua, lStore);
+	AddReadOnlyMethod(lLua, "new", lStore, ScriptStore::FuncNew);
+	AddReadOnlyMethod(lLua, "run", lStore, ScriptStore::FuncRun);
+	AddReadOnlyMethod(lLua, "list", lStore, ScriptStore::FuncList);
+
+	lLua.SetGlobal("script");
+}
+
+static int Writer(lua_State *lState, const void *lData, size_t lSize, void *lUserData) {
+	(void)lState;
+
+	static_cast<string *>(lUserData)->append(static_cast<const char *>(lData), lSize);
+	return 0;
+}
+
+static bool ReadFile(const string &lPath, string &lContents) {
+	FILE *lFile = fopen(lPath.c_str(), "rb");
+	if (!lFile)
+	{
+		return false;
+	}
+
+	char lBuffer[4096];
+	size_t lCount;
+
+	lContents.clear();
+	while ((lCount = fread(lBuffer, 1, sizeof(lBuffer), lFile)) > 0)
+	{
+		lContents.append(lBuffer, lCount);
+	}
+
+	bool lOk = !ferror(lFile);
+	fclose(lFile);
+	return lOk;
+}
+
+/*
+ * Written next to the destination and renamed over it, so a power cut leaves
+ * the old file or the new one, never half of one.
+ */
+static int WriteFile(const string &lPath, const void *lHeader, size_t lHeaderSize, const string &lContents) {
+	string lTemporary = lPath + ".tmp";
+	FILE *lFile = fopen(lTemporary.c_str(), "wb");
+	if (!lFile)
+	{
+		perror(lTemporary.c_str());
+		return -1;
+	}
+
+	bool lOk = (!lHeaderSize || fwrite(lHeader, lHeaderSize, 1, lFile) == 1)
+			&& (lContents.empty() || fwrite(lContents.data(), lContents.length(), 1, lFile) == 1);
+	lOk = (fclose(lFile) == 0) && lOk;
+
+	if (!lOk || rename(lTemporary.c_str(), lPath.c_str()))
+	{
+		perror(lPath.c_str());
+		remove(lTemporary.c_str());
+		return -1;
+	}
+
+	return 0;
+}
+
+static int MakeDirectory(const string &lPath) {
+	for (size_t lSlash = lPath.find('/', 1); ; lSlash = lPath.find('/', lSlash + 1))
+	{
+		string lPart = lPath.substr(0, lSlash);
+		if (mkdir(lPart.c_str(), 0755) && errno != EEXIST)
+		{
+			perror(lPart.c_str());
+			return -1;
+		}
+
+		if (lSlash == string::npos)
+		{
+			return 0;
+		}
+	}
+}
+
+ScriptStore::ScriptStore(ScriptProcessor *lScriptProcessor, const char *lDirectory)
+: mScriptProcessor{lScriptProcessor}
+, mDirectory{lDirectory}
+{
+}
+
+// An identifier that is not a Lua keyword, since the script becomes a global of that name
+bool ScriptStore::IsValidName(string_view lName)
+{
+	static const char *const sKeywords[] = {
+		"and", "break", "do", "else", "elseif", "end", "false", "for", "function", "goto", "if",
+		"in", "local", "nil", "not", "or", "repeat", "return", "then", "true", "until", "while",
+	};
+
+	if (lName.empty() || isdigit(static_cast<unsigned char>(lName[0])))
+	{
+		return false;
+	}
+
+	for (char lChar : lName)
+	{
+		if (!isalnum(static_cast<unsigned char>(lChar)) && lChar != '_')
+		{
+			return false;
+		}
+	}
+
+	for (const char *lKeyword : sKeywords)
+	{
+		if (lName == lKeyword)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * A script may not take the name of a global that is something else: a
+ * library, a device table, or a subsystem table that is installed on first
+ * use and so may not be in the globals yet. The globals are read raw so
+ * checking does not install it.
+ */
+bool ScriptStore::IsFreeName(Lua &lLua, const string &lName)
+{
+	if (Find(lName))
+	{
+		return true;
+	}
+
+	if (ScriptProcessor::IsSubsystem(lName.c_str()))
+	{
+		return false;
+	}
+
+	lLua.PushGlobalTable();
+	lLua.PushString(lName.c_str());
+	bool lFree = lLua.RawGet(-2) == LUA_TNIL;
+	lLua.Pop(2);
+
+	return lFree;
+}
+
+StoredScript *ScriptStore::Find(const string &lName)
+{
+	auto lFound = mScripts.find(lName);
+
+	return lFound == mScripts.end() ? nullptr : &lFound->second;
+}
+
+uint64_t ScriptStore::Hash(const string &lSource)
+{
+	uint64_t lHash = FNV_OFFSET_BASIS;
+
+	for (char lChar : lSource)
+	{
+		lHash ^= static_cast<unsigned char>(lChar);
+		lHash *= FNV_PRIME;
+	}
+
+	return lHash;
+}
+
+int ScriptStore::Compile(Lua &lLua, const string &lName, StoredScript &lScript)
+{
+	string lChunkName = "=" + lName;
+
+	int lResult = lLua.LoadBufferX(lScript.mSource.data(), lScript.mSource.length(), lChunkName.c_str(), "t");
+	if (lResult != LUA_OK)
+	{
+		return lResult;
+	}
+
+	lScript.mBytecode.clear();
+	lLua.Dump(Writer, &lScript.mBytecode, 0);
+	lLua.Pop(1);
+
+	return LUA_OK;
+}
+
+int ScriptStore::Define(Lua &lLua, const string &lName, string lSource)
+{
+	if (!IsValidName(lName) || !IsFreeName(lLua, lName))
+	{
+		lLua.PushString(("'" + lName + "' is not a valid script name").c_str());
+		return LUA_ERRRUN;
+	}
+
+	StoredScript lScript;
+
+	lScript.mSource = move(lSource);
+	lScript.mHash = Hash(lScript.mSource);
+	lScript.mAutorun = false;
+
+	int lResult = Compile(lLua, lName, lScript);
+	if (lResult != LUA_OK)
+	{
+		return lResult;
+	}
+
+	StoredScript *lExisting = Find(lName);
+	if (lExisting)
+	{
+		lScript.mAutorun = lExisting->mAutorun;
+	}
+
+	mScripts[lName] = move(lScript);
+	MakeObject(lLua, lName);
+
+	return LUA_OK;
+}
+
+int ScriptStore::Load(Lua &lLua, const string &lName, int lEnvironment)
+{
+	StoredScript *lScript = Find(lName);
+	if (!lScript)
+	{
+		lLua.PushString(("no script named '" + lName + "'").c_str());
+		return LUA_ERRRUN;
+	}
+
+	lEnvironment = lLua.AbsIndex(lEnvironment);
+
+	string lChunkName = "=" + lName;
+	int lResult = lLua.LoadBufferX(lScript->mBytecode.data(), lScript->mBytecode.length(), lChunkName.c_str(), "b");
+	if (lResult != LUA_OK)
+	{
+		return lResult;
+	}
+
+	lLua.PushValue(lEnvironment);
+	lLua.SetUpValue(-2, 1);
+
+	return LUA_OK;
+}
+
+void ScriptStore::Save(Lua &lLua, const string &lName)
+{
+	if (Write(lName))
+	{
+		lLua.PushString(("could not save script '" + lName + "'").c_str());
+		lLua.Error();
+	}
+}
+
+int ScriptStore::Write(const string &lName)
+{
+	StoredScript *lScript = Find(lName);
+	if (!lScript || MakeDirectory(mDirectory))
+	{
+		return -1;
+	}
+
+	if (WriteFile(GetPath(lName, SCRIPT_SOURCE_SUFFIX), nullptr, 0, lScript->mSource)
+			|| WriteBytecode(lName, *lScript))
+	{
+		return -1;
+	}
+
+	string lAutorun = GetPath(lName, SCRIPT_AUTORUN_SUFFIX);
+	if (lScript->mAutorun)
+	{
+		return WriteFile(lAutorun, nullptr, 0, string());
+	}
+
+	remove(lAutorun.c_str());
+	return 0;
+}
+
+void ScriptStore::Delete(Lua &lLua, const string &lName)
+{
+	if (!mScripts.erase(lName))
+	{
+		lLua.PushString(("no script named '" + lName + "'").c_str());
+		lLua.Error();
+	}
+
+	remove(GetPath(lName, SCRIPT_SOURCE_SUFFIX).c_str());
+	remove(GetPath(lName, SCRIPT_BYTECODE_SUFFIX).c_str());
+	remove(GetPath(lName, SCRIPT_AUTORUN_SUFFIX).c_str());
+
+	lLua.PushNil();
+	lLua.SetGlobal(lName.c_str());
+}
+
+/*
+ * Brings back the saved scripts at startup, compiling only those whose cached
+ * bytecode is missing or stale.
+ */
+void ScriptStore::Restore(Lua &lLua)
+{
+	DIR *lDirectory = opendir(mDirectory.c_str());
+	if (!lDirectory)
+	{
+		return;
+	}
+
+	struct dirent *lEntry;
+	size_t lSuffixLength = strlen(SCRIPT_SOURCE_SUFFIX);
+
+	while ((lEntry = readdir(lDirectory)) != nullptr)
+	{
+		string lFile = lEntry->d_name;
+		if (lFile.length() <= lSuffixLength || lFile.compare(lFile.length() - lSuffixLength, lSuffixLength, SCRIPT_SOURCE_SUFFIX))
+		{
+			continue;
+		}
+
+		string lName = lFile.substr(0, lFile.length() - lSuffixLength);
+		StoredScript lScript;
+
+		if (!IsValidName(lName) || !ReadFile(GetPath(lName, SCRIPT_SOURCE_SUFFIX), lScript.mSource))
+		{
+			continue;
+		}
+
+		if (!IsFreeName(lLua, lName))
+		{
+			printf("Error loading script %s: the name is taken\n", lName.c_str());
+			continue;
+		}
+
+		lScript.mHash = Hash(lScript.mSource);
+		lScript.mAutorun = access(GetPath(lName, SCRIPT_AUTORUN_SUFFIX).c_str(), F_OK) == 0;
+
+		if (!ReadBytecode(lName, lScript))
+		{
+			if (Compile(lLua, lName, lScript) != LUA_OK)
+			{
+				printf("Error loading script %s: %s\n", lName.c_str(), lLua.ToString(-1));
+				lLua.Pop(1);
+				continue;
+			}
+			WriteBytecode(lName, lScript);
+		}
+
+		mScripts[lName] = move(lScript);
+		MakeObject(lLua, lName);
+	}
+
+	closedir(lDirectory);
+}
+
+/*
+ * Autorun scripts run in name order against the globals, so what they define
+ * is there for every session.
+ */
+void ScriptStore::Autorun(Lua &lLua)
+{
+	// A script may define or delete others as it runs
+	vector<string> lNames;
+	for (auto &[lName, lScript] : mScripts)
+	{
+		if (lScript.mAutorun)
+		{
+			lNames.push_back(lName);
+		}
+	}
+
+	for (const string &lName : lNames)
+	{
+		lLua.PushGlobalTable();
+		int lResult = Load(lLua, lName, -1);
+		lLua.Remove(-2);
+
+		if (lResult == LUA_OK)
+		{
+			lResult = lLua.PCall(0, 0, 0);
+		}
+		if (lResult != LUA_OK)
+		{
+			printf("Error running script %s: %s\n", lName.c_str(), lLua.ToString(-1));
+			lLua.Pop(1);
+		}
+	}
+}
+
+string ScriptStore::GetPath(const string &lName, const char *lSuffix) const
+{
+	return mDirectory + "/" + lName + lSuffix;
+}
+
+bool ScriptStore::ReadBytecode(const string &lName, StoredScript &lScript) const
+{
+	string lContents;
+	BytecodeHeader lHeader;
+
+	if (!ReadFile(GetPath(lName, SCRIPT_BYTECODE_SUFFIX), lContents) || lContents.length() < sizeof(lHeader))
+	{
+		return false;
+	}
+
+	memcpy(&lHeader, lContents.data(), sizeof(lHeader));
+	if (lHeader.mMagic != SCRIPT_BYTECODE_MAGIC || lHeader.mLuaVersion != LUA_VERSION_NUM
+			|| lHeader.mSourceHash != lScript.mHash || lHeader.mLength != lContents.length() - sizeof(lHeader))
+	{
+		return false;
+	}
+
+	string lBytecode = lContents.substr(sizeof(lHeader));
+	if (Hash(lBytecode) != lHeader.mBytecodeHash)
+	{
+		return false;
+	}
+
+	lScript.mBytecode = move(lBytecode);
+	return true;
+}
+
+int ScriptStore::WriteBytecode(const string &lName, const StoredScript &lScript) const
+{
+	BytecodeHeader lHeader;
+
+	lHeader.mMagic = SCRIPT_BYTECODE_MAGIC;
+	lHeader.mLuaVersion = LUA_VERSION_NUM;
+	lHeader.mSourceHash = lScript.mHash;
+	lHeader.mLength = lScript.mBytecode.length();
+	lHeader.mBytecodeHash = Hash(lScript.mBytecode);
+
+	return WriteFile(GetPath(lName, SCRIPT_BYTECODE_SUFFIX), &lHeader, sizeof(lHeader), lScript.mBytecode);
+}
+
+/*
+ * The script's global object. name() runs it too. An object for the name is
+ * made once and kept, so a deleted and defined again script reuses it.
+ */
+void ScriptStore::MakeObject(Lua &lLua, const string &lName)
+{
+	ScriptObject *lObject = &mObjects.try_emplace(lName, this, lName).first->second;
+
+	PushBound<sScriptObjectBinding>(lLua, lObject);
+	AddReadOnlyMethod(lLua, "run", lObject, ScriptObject::FuncRun);
+	SetReadOnlyCall(lLua, lObject, ScriptObject::FuncRun);
+
+	lLua.SetGlobal(lName.c_str());
+}
+
+static int ContinueRun(lua_State *lState, int lStatus, lua_KContext lBase) {
+	(void)lStatus;
+
+	return lua_gettop(lState) - static_cast<int>(lBase);
+}
+
+/*
+ * Calls the script with the arguments from lFirstArgument up, against the
+ * calling session's environment, and returns what it returns. Called with
+ * lua_callk() so the script may still yield.
+ */
+int ScriptStore::Run(lua_State *lState, const string &lName, int lFirstArgument)
+{
+	Lua lLua(lState);
+
+	lLua.RawGetI(LUA_REGISTRYINDEX, mScriptProcessor->GetEnvironmentReference());
+	int lResult = Load(lLua, lName, -1);
+	lLua.Remove(-2);
+
+	if (lResult != LUA_OK)
+	{
+		return lLua.Error();
+	}
+
+	int lArguments = lLua.GetTop() - lFirstArgument;
+	lLua.Insert(lFirstArgument);
+
+	lua_KContext lBase = lFirstArgument - 1;
+	lLua.CallK(lArguments, LUA_MULTRET, lBase, ContinueRun);
+
+	return ContinueRun(lState, LUA_OK, lBase);
+}
+
+ScriptObject::ScriptObject(ScriptStore *lStore, const string &lName)
+: mStore{lStore}
+, mName{lName}
+{
+}
+
+StoredScript &ScriptObject::GetScript(Lua &lLua) const
+{
+	StoredScript *lScript = mStore->Find(mName);
+	if (!lScript)
+	{
+		lLua.PushString(("script '" + mName + "' has been deleted").c_str());
+		lLua.Error();
+	}
+
+	return *lScript;
+}
+
+const string &ScriptObject::GetSource(Lua &lLua) const
+{
+	return GetScript(lLua).mSource;
+}
+
+bool ScriptObject::IsAutorun(Lua &lLua) const
+{
+	return GetScript(lLua).mAutorun;
+}
+
+void ScriptObject::SetAutorun(Lua &lLua, bool lAutorun)
+{
+	GetScript(lLua).mAutorun = lAutorun;
+}
+
+void ScriptObject::Save(Lua &lLua)
+{
+	mStore->Save(lLua, mName);
+}
+
+// name.run(...) and name(...)
+int ScriptObject::FuncRun(lua_State *lState) {
+	Lua lLua(lState);
+
+	ScriptObject *lObject = static_cast<ScriptObject *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+	return lObject->mStore->Run(lState, lObject->mName, 1);
+}
+
+// script.new(source, name)
+int ScriptStore::FuncNew(lua_State *lState) {
+	Lua lLua(lState);
+
+	ScriptStore *lStore = static_cast<ScriptStore *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+	size_t lLength;
+	const char *lSource = lLua.CheckLString(1, &lLength);
+	string lName = lLua.IsNoneOrNil(2) ? SCRIPT_ANONYMOUS_NAME : lLua.CheckString(2);
+	lLua.ArgCheck(IsValidName(lName), 2, "not a valid script name");
+
+	if (lStore->Define(lLua, lName, string(lSource, lLength)) != LUA_OK)
+	{
+		return lLua.Error();
+	}
+
+	lLua.GetGlobal(lName.c_str());
+	return 1;
+}
+
+// script.run(name, ...)
+int ScriptStore::FuncRun(lua_State *lState) {
+	Lua lLua(lState);
+
+	ScriptStore *lStore = static_cast<ScriptStore *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+	string lName = lLua.CheckString(1);
+
+	return lStore->Run(lState, lName, 2);
+}
+
+// script.list() returns the names in order
+int ScriptStore::FuncList(lua_State *lState) {
+	Lua lLua(lState);
+
+	ScriptStore *lStore = static_cast<ScriptStore *>(lLua.ToUserData(lLua.UpValueIndex(1)));
+
+	lLua.CreateTable(lStore->mScripts.size(), 0);
+
+	lua_Integer lIndex = 1;
+	for (auto &[lName, lScript] : lStore->mScripts)
+	{
+		lLua.PushString(lName.c_str());
+		lLua.RawSetI(-2, lIndex++);
+	}
+
+	return 1;
+}
@@ -0,0 +1,468 @@
+/*
+ * session.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: matt
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "endpoint.hpp"
+#include "errors.hpp"
+#include "session.hpp"
+
+static atomic<uint64_t> sNextSessionId{0};
+
+SessionManager gSessionManager;
+
+ClientSession::ClientSession(Endpoint *lOrigin, const char *lName, size_t lCapacity, unsigned int lWeight)
+: mId{sNextSessionId++}
+, mOrigin{lOrigin}
+, mName{lName}
+, mQueuedBytes{0}
+, mTokens{SESSION_DEFAULT_BURST}
+, mLastRefill{chrono::steady_clock::now()}
+, mWeight{lWeight ? lWeight : 1}
+, mCredit{mWeight}
+, mActive{false}
+, mParked{false}
+{
+	mLimits.mMaxQueuedCommands = lCapacity;
+}
+
+ClientSession::~ClientSession()
+{
+	for (CommandMessage *lMessage : mInput)
+	{
+		delete lMessage;
+	}
+}
+
+SessionManager::SessionManager(void)
+: mCursor{0}
+, mQueuedCommands{0}
+, mCapacity{SESSION_MANAGER_DEFAULT_CAPACITY}
+, mReserve{SESSION_MANAGER_DEFAULT_RESERVE}
+, mDefaultSession(nullptr, "default")
+, mWakeRequested{false}
+{
+	pthread_condattr_t lAttributes;
+
+	// Next() waits against deadlines taken from the steady clock
+	pthread_condattr_init(&lAttributes);
+	pthread_condattr_setclock(&lAttributes, CLOCK_MONOTONIC);
+
+	pthread_mutex_init(&mLock, nullptr);
+	pthread_cond_init(&mInputAvailable, &lAttributes);
+	pthread_cond_init(&mSessionIdle, nullptr);
+
+	pthread_condattr_destroy(&lAttributes);
+
+	mSessions.push_back(&mDefaultSession);
+}
+
+SessionManager::~SessionManager()
+{
+	pthread_mutex_destroy(&mLock);
+	pthread_cond_destroy(&mInputAvailable);
+	pthread_cond_destroy(&mSessionIdle);
+}
+
+void SessionManager::Register(ClientSession *lSession)
+{
+	Lock();
+	mSessions.push_back(lSession);
+	Unlock();
+}
+
+/*
+ * Drop a session and whatever it still has queued. A message of the session
+ * that is suspended (a script in delay(), a line held by *WAI) is not waited
+ * for: the session is retired as it is, and the script processor drops that
+ * message when it takes the retirement. Only while the script processor is
+ * actually executing one of its messages, which the script time slice keeps
+ * short, does this wait, so nothing is sent to an endpoint that is going away.
+ */
+void SessionManager::Unregister(ClientSession *lSession)
+{
+	Lock();
+	while (lSession->mActive && !lSession->mParked)
+	{
+		pthread_cond_wait(&mSessionIdle, &mLock);
+	}
+	lSession->mActive = false;
+	lSession->mParked = false;
+
+	auto lIterator = find(mSessions.begin(), mSessions.end(), lSession);
+	if (lIterator != mSessions.end())
+	{
+		size_t lIndex = lIterator - mSessions.begin();
+		mSessions.erase(lIterator);
+		if (lIndex < mCursor)
+		{
+			mCursor--;
+		}
+		if (mCursor >= mSessions.size())
+		{
+			mCursor = 0;
+		}
+	}
+
+	for (CommandMessage *lMessage : lSession->mInput)
+	{
+		delete lMessage;
+	}
+	mQueuedCommands -= lSession->mInput.size();
+	lSession->mInput.clear();
+	lSession->mQueuedBytes = 0;
+	mRetired.push_back(lSession->mId);
+	Unlock();
+}
+
+/*
+ * Device clear: drop whatever the session has queued. A transfer of the
+ * session that is suspended is dropped by the script processor when it takes
+ * the clear; one that is actually executing still finishes.
+ */
+void SessionManager::Clear(ClientSession *lSession)
+{
+	Lock();
+	for (CommandMessage *lMessage : lSession->mInput)
+	{
+		delete lMessage;
+	}
+	mQueuedCommands -= lSession->mInput.size();
+	lSession->mInput.clear();
+	lSession->mQueuedBytes = 0;
+
+	if (lSession->mActive && lSession->mParked)
+	{
+		mCleared.push_back(lSession->mId);
+		mWakeRequested = true;
+		pthread_cond_broadcast(&mInputAvailable);
+	}
+	Unlock();
+}
+
+void SessionManager::SetWeight(ClientSession *lSession, unsigned int lWeight)
+{
+	Lock();
+	lSession->mWeight = lWeight ? lWeight : 1;
+	lSession->mCredit = min(lSession->mCredit, lSession->mWeight);
+	Unlock();
+}
+
+AdmissionLimits SessionManager::GetLimits(ClientSession *lSession)
+{
+	Lock();
+	AdmissionLimits lLimits = lSession->mLimits;
+	Unlock();
+
+	return lLimits;
+}
+
+void SessionManager::SetLimits(ClientSession *lSession, const AdmissionLimits &lLimits)
+{
+	Lock();
+	lSession->mLimits = lLimits;
+	lSession->mTokens = min(lSession->mTokens, lLimits.mBurst);
+	Unlock();
+}
+
+AdmissionCounters SessionManager::GetCounters(ClientSession *lSession)
+{
+	Lock();
+	AdmissionCounters lCounters = lSession->mCounters;
+	Unlock();
+
+	return lCounters;
+}
+
+void SessionManager::SetCapacity(size_t lCapacity, size_t lReserve)
+{
+	Lock();
+	mCapacity = lCapacity;
+	mReserve = min(lReserve, lCapacity);
+	Unlock();
+}
+
+/*
+ * Queue a program message on its sender's session.
+ *
+ * A flow controlled session over its limits gets -1 and keeps ownership of
+ * the message. Any other session over its limits has the message discarded and
+ * "Queue overflow" pushed on the error queue; that still returns 0 because the
+ * caller no longer owns the message.
+ */
+int SessionManager::Submit(CommandMessage *lMessage)
+{
+	Lock();
+	ClientSession *lSession = Find(reinterpret_cast<Endpoint *>(lMessage->GetOrigin()));
+
+	if (!Admit(lSession, lMessage->GetLength()))
+	{
+		if (lSession->mLimits.mFlowControlled)
+		{
+			lSession->mCounters.mDeferred++;
+			Unlock();
+			return -1;
+		}
+
+		lSession->mCounters.mRejected++;
+		Unlock();
+
+		delete lMessage;
+		SystemErrors::gErrorController.Push(Error(ScpiErrors::QUEUE_OVERFLOW, ScpiErrors::cQueueOverflowMessage,
+												  strlen(ScpiErrors::cQueueOverflowMessage)));
+		return 0;
+	}
+
+	lSession->mCounters.mAccepted++;
+	lSession->mQueuedBytes += lMessage->GetLength();
+	mQueuedCommands++;
+	lSession->mInput.push_back(lMessage);
+	pthread_cond_signal(&mInputAvailable);
+	Unlock();
+
+	return 0;
+}
+
+/*
+ * Called with the lock held. Takes a token from the session's bucket only when
+ * every other limit passes, so deferred retries are not charged twice.
+ */
+bool SessionManager::Admit(ClientSession *lSession, size_t lLength)
+{
+	const AdmissionLimits &lLimits = lSession->mLimits;
+	AdmissionCounters &lCounters = lSession->mCounters;
+
+	if (lSession->mInput.size() >= lLimits.mMaxQueuedCommands)
+	{
+		lCounters.mQueueFull++;
+		return false;
+	}
+
+	// A single message larger than the byte limit is still let through on an empty queue
+	if (!lSession->mInput.empty() && lSession->mQueuedBytes + lLength > lLimits.mMaxQueuedBytes)
+	{
+		lCounters.mBytesFull++;
+		return false;
+	}
+
+	size_t lAvailable = lLimits.mHighPriority ? mCapacity : mCapacity - mReserve;
+	if (mQueuedCommands >= lAvailable)
+	{
+		lCounters.mReserveFull++;
+		return false;
+	}
+
+	if (lLimits.mRate > 0.0)
+	{
+		chrono::steady_clock::time_point lNow = chrono::steady_clock::now();
+		chrono::duration<double> lElapsed = lNow - lSession->mLastRefill;
+		lSession->mTokens = min(lLimits.mBurst, lSession->mTokens + lElapsed.count() * lLimits.mRate);
+		lSession->mLastRefill = lNow;
+
+		if (lSession->mTokens < 1.0)
+		{
+			lCounters.mRateLimited++;
+			return false;
+		}
+		lSession->mTokens -= 1.0;
+	}
+
+	return true;
+}
+
+/*
+ * Block until some session has input, then return its oldest message. The
+ * session stays active until Complete() is called for it, and an active
+ * session is passed over, so a session whose script is suspended gets nothing
+ * new until that script has finished.
+ *
+ * With a deadline, returns nullptr once it has passed, or when Wake() is
+ * called, without waiting for input.
+ */
+CommandMessage *SessionManager::Next(ClientSession **lSession, const chrono::steady_clock::time_point *lDeadline)
+{
+	Lock();
+	while (!HasInput())
+	{
+		if (!lDeadline)
+		{
+			pthread_cond_wait(&mInputAvailable, &mLock);
+			continue;
+		}
+
+		if (mWakeRequested || chrono::steady_clock::now() >= *lDeadline)
+		{
+			mWakeRequested = false;
+			Unlock();
+			return nullptr;
+		}
+
+		chrono::nanoseconds lTime = lDeadline->time_since_epoch();
+		timespec lTimeout;
+		lTimeout.tv_sec = chrono::duration_cast<chrono::seconds>(lTime).count();
+		lTimeout.tv_nsec = (lTime % chrono::seconds(1)).count();
+		pthread_cond_timedwait(&mInputAvailable, &mLock, &lTimeout);
+	}
+
+	CommandMessage *lMessage = nullptr;
+	while (!lMessage)
+	{
+		ClientSession *lCandidate = mSessions[mCursor];
+
+		if (!lCandidate->mActive && !lCandidate->mInput.empty())
+		{
+			lMessage = lCandidate->mInput.front();
+			lCandidate->mInput.pop_front();
+			lCandidate->mQueuedBytes -= lMessage->GetLength();
+			mQueuedCommands--;
+			lCandidate->mActive = true;
+			*lSession = lCandidate;
+
+			if (--lCandidate->mCredit)
+			{
+				break;
+			}
+		}
+
+		// Turn over (used up its credit or has nothing to run); move on to the next session
+		lCandidate->mCredit = lCandidate->mWeight;
+		mCursor = (mCursor + 1) % mSessions.size();
+	}
+	Unlock();
+
+	return lMessage;
+}
+
+void SessionManager::Complete(ClientSession *lSession)
+{
+	Lock();
+	lSession->mActive = false;
+	pthread_cond_broadcast(&mSessionIdle);
+	Unlock();
+}
+
+/*
+ * The script processor has suspended the session's message and lets go of the
+ * session until Unpark().
+ */
+void SessionManager::Park(ClientSession *lSession)
+{
+	Lock();
+	lSession->mParked = true;
+	pthread_cond_broadcast(&mSessionIdle);
+	Unlock();
+}
+
+/*
+ * Before a suspended message is picked up again. Returns false when its
+ * session has been unregistered in the meantime, in which case the session is
+ * gone and the message must be dropped instead.
+ */
+bool SessionManager::Unpark(uint64_t lId)
+{
+	Lock();
+	auto lIterator = find_if(mSessions.begin(), mSessions.end(),
+							 [lId](const ClientSession *lSession) { return lSession->mId == lId; });
+	bool lRegistered = lIterator != mSessions.end();
+	if (lRegistered)
+	{
+		(*lIterator)->mParked = false;
+	}
+	Unlock();
+
+	return lRegistered;
+}
+
+/*
+ * Makes a Next() waiting with a deadline return early, for events other than
+ * new input that the script processor has to look at.
+ */
+void SessionManager::Wake(void)
+{
+	Lock();
+	mWakeRequested = true;
+	pthread_cond_broadcast(&mInputAvailable);
+	Unlock();
+}
+
+/*
+ * Hands the script processor the ids of sessions that have gone away, so it
+ * can free whatever it keeps for them on its own thread.
+ */
+void SessionManager::TakeRetired(vector<uint64_t> &lIds)
+{
+	Lock();
+	lIds.swap(mRetired);
+	mRetired.clear();
+	Unlock();
+}
+
+/*
+ * Hands the script processor the ids of parked sessions that have been
+ * cleared, so it can drop their suspended transfers.
+ */
+void SessionManager::TakeCleared(vector<uint64_t> &lIds)
+{
+	Lock();
+	lIds.swap(mCleared);
+	mCleared.clear();
+	Unlock();
+}
+
+bool SessionManager::HasPendingInput(void)
+{
+	Lock();
+	bool lPending = HasInput();
+	Unlock();
+
+	return lPending;
+}
+
+/*
+ * Whether the session of lOrigin has nothing queued and nothing running, so a
+ * response sent to it straight away cannot overtake one of its own. Only the
+ * origin's interface thread submits to a registered session, so from that
+ * thread the answer holds until it submits again. The default session is
+ * shared and is never idle in this sense.
+ */
+bool SessionManager::IsIdle(Endpoint *lOrigin)
+{
+	Lock();
+	ClientSession *lSession = Find(lOrigin);
+	bool lIdle = lSession != &mDefaultSession && !lSession->mActive && lSession->mInput.empty();
+	Unlock();
+
+	return lIdle;
+}
+
+ClientSession *SessionManager::Find(Endpoint *lOrigin)
+{
+	for (ClientSession *lSession : mSessions)
+	{
+		if (lSession->mOrigin == lOrigin)
+		{
+			return lSession;
+		}
+	}
+
+	return &mDefaultSession;
+}
+
+bool SessionManager::HasInput(void) const
+{
+	for (const ClientSession *lSession : mSessions)
+	{
+		if (!lSession->mActive && !lSession->mInput.empty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
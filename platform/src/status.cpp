@@ -8,45 +8,58 @@
 
 #include <cstdio>
 
+#include "rot.hpp"
 #include "status.hpp"
 
 
 StatusDataStructure gPlatformStatus;
 
 
+template <uint16_t (StatusDataStructure::*Get)(void)>
+static int GetRegister(Lua &lLua, void *lObject) {
+	lLua.PushNumber(static_cast<float>((static_cast<StatusDataStructure *>(lObject)->*Get)()));
+	return 1;
+}
+
+template <void (StatusDataStructure::*Set)(uint16_t)>
+static void SetRegister(Lua &lLua, void *lObject, int lValue) {
+	if(lLua.IsInteger(lValue)) {
+		int lRegister = lLua.ToNumber(lValue);
+		if(lRegister < 0) {
+			// ERROR
+		}
+		else {
+			(static_cast<StatusDataStructure *>(lObject)->*Set)(lRegister);
+		}
+	}
+}
+
+static constexpr RotProperty sStatusProperties[] = {
+	{ "condition", GetRegister<&StatusDataStructure::GetConditionRegister>, nullptr },
+	{ "event", GetRegister<&StatusDataStructure::GetEventRegister>,
+		SetRegister<&StatusDataStructure::SetEventRegister> },
+	{ "eventenable", GetRegister<&StatusDataStructure::GetEventEnableRegister>,
+		SetRegister<&StatusDataStructure::SetEventEnableRegister> },
+	{ "positivetransition", GetRegister<&StatusDataStructure::GetPositiveTransitionRegister>,
+		SetRegister<&StatusDataStructure::SetPositiveTransitionRegister> },
+	{ "negativetransition", GetRegister<&StatusDataStructure::GetNegativeTransitionRegister>,
+		SetRegister<&StatusDataStructure::SetNegativeTransitionRegister> },
+	{ "servicerequestenable", GetRegister<&StatusDataStructure::GetServiceRequestEnableRegister>,
+		SetRegister<&StatusDataStructure::SetServiceRequestEnableRegister> },
+};
+static constexpr RotTable sStatusTable{sStatusProperties};
+static constexpr RotLayout sStatusLayout = sStatusTable.GetLayout();
+
 void StatusInstall(lua_State *lState) {
 	Lua lLua(lState);
 
-	// MakeTable
-	lLua.NewTable();
-	lLua.MakeTableReadOnly();
+	PushReadOnlyObject(lLua, sStatusLayout, &gPlatformStatus);
 
 	/*
 	 * Stack: (top down)
-	 * 		: * status DeviceTable
-	 */
-	LuaUtils::AddGetter(lLua, "condition", &gPlatformStatus, FUNC_GET_CONDITION_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddGetter(lLua, "event", &gPlatformStatus, FUNC_GET_EVENT_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddSetter(lLua, "event", &gPlatformStatus, FUNC_SET_EVENT_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddGetter(lLua, "eventenable", &gPlatformStatus, FUNC_GET_EVENT_ENABLE_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddSetter(lLua, "eventenable", &gPlatformStatus, FUNC_SET_EVENT_ENABLE_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddGetter(lLua, "positivetransition", &gPlatformStatus, FUNC_GET_POSITIVE_TRANS_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddSetter(lLua, "positivetransition", &gPlatformStatus, FUNC_SET_POSITIVE_TRANS_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddGetter(lLua, "negativetransition", &gPlatformStatus, FUNC_GET_NEGATIVE_TRANS_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddSetter(lLua, "negativetransition", &gPlatformStatus, FUNC_SET_NEGATIVE_TRANS_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddGetter(lLua, "servicerequestenable", &gPlatformStatus, FUNC_GET_SERVICE_REQUEST_ENABLE_REGISTER, StatusDataStructure::HandleMsg);
-	LuaUtils::AddSetter(lLua, "servicerequestenable", &gPlatformStatus, FUNC_SET_SERVICE_REQUEST_ENABLE_REGISTER, StatusDataStructure::HandleMsg);
-
-	/*
-	 * Stack: (top down)
-	 * 		: * status DeviceTable
+	 * 		: * status
 	 */
 	lLua.SetGlobal("status");
-
-	/*
-	 * Stack: (top down)
-	 * 		: * DeviceTable
-	 */
 }
 
 
@@ -57,123 +70,65 @@ StatusDataStructure::StatusDataStructure(void)
 , mPositiveTransitionRegister(0)
 , mNegativeTransitionRegister(0)
 , mStatusByteRegister(0)
+, mSequence{0}
 {
 	;
 }
 
+void StatusDataStructure::BeginWrite(void)
+{
+	mWriteLock.lock();
+	mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
 
-int StatusDataStructure::HandleMsg(lua_State *lState) {
-
-	int lRet = 0;
+void StatusDataStructure::EndWrite(void)
+{
+	mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	mWriteLock.unlock();
+}
 
-	Lua lLua(lState);
+/*
+ * Safe from any thread: retries until no write went on while the registers
+ * were being read.
+ */
+StatusSnapshot StatusDataStructure::Snapshot(void) const
+{
+	StatusSnapshot lSnapshot;
+	uint32_t lSequence;
 
-	StatusDataStructure *lPlatformStatus = static_cast<StatusDataStructure *>(lLua.ToUserData(lLua.UpValueIndex(1)));
-
-	StatusFunctions lFunc = static_cast<StatusFunctions>(lLua.ToInteger(lLua.UpValueIndex(2)));
-
-	switch(lFunc) {
-	case FUNC_GET_CONDITION_REGISTER:
-		lLua.PushNumber(static_cast<float>(lPlatformStatus->GetConditionRegister()));
-		lRet = 1;
-		break;
-	case FUNC_GET_EVENT_REGISTER:
-		lLua.PushNumber(static_cast<float>(lPlatformStatus->GetEventRegister()));
-		lRet = 1;
-		break;
-	case FUNC_SET_EVENT_REGISTER:
-		if(lLua.IsInteger(1)) {
-			int lArgCount = lLua.GetTop();
-			if(lArgCount == 1) {
-				int lEvent = lLua.ToNumber(1);
-				if(lEvent < 0) {
-					// ERROR
-				}
-				else {
-					lPlatformStatus->SetEventRegister(lEvent);
-				}
-			}
-		}
-		break;
-	case FUNC_GET_EVENT_ENABLE_REGISTER:
-		lLua.PushNumber(static_cast<float>(lPlatformStatus->GetEventEnableRegister()));
-		lRet = 1;
-		break;
-	case FUNC_SET_EVENT_ENABLE_REGISTER:
-		if(lLua.IsInteger(1)) {
-			int lArgCount = lLua.GetTop();
-			if(lArgCount == 1) {
-				int lEventEnable = lLua.ToNumber(1);
-				if(lEventEnable < 0) {
-					// ERROR
-				}
-				else {
-					lPlatformStatus->SetEventEnableRegister(lEventEnable);
-				}
-			}
-		}
-		break;
-	case FUNC_GET_POSITIVE_TRANS_REGISTER:
-		lLua.PushNumber(static_cast<float>(lPlatformStatus->GetPositiveTransitionRegister()));
-		lRet = 1;
-		break;
-	case FUNC_SET_POSITIVE_TRANS_REGISTER:
-		if(lLua.IsInteger(1)) {
-			int lArgCount = lLua.GetTop();
-			if(lArgCount == 1) {
-				int lPositiveTransition = lLua.ToNumber(1);
-				if(lPositiveTransition < 0) {
-					// ERROR
-				}
-				else {
-					lPlatformStatus->SetPositiveTransitionRegister(lPositiveTransition);
-				}
-			}
-		}
-		break;
-	case FUNC_GET_NEGATIVE_TRANS_REGISTER:
-		lLua.PushNumber(static_cast<float>(lPlatformStatus->GetNegativeTransitionRegister()));
-		lRet = 1;
-		break;
-	case FUNC_SET_NEGATIVE_TRANS_REGISTER:
-		if(lLua.IsInteger(1)) {
-			int lArgCount = lLua.GetTop();
-			if(lArgCount == 1) {
-				int lNegativeTransition = lLua.ToNumber(1);
-				if(lNegativeTransition < 0) {
-					// ERROR
-				}
-				else {
-					lPlatformStatus->SetNegativeTransitionRegister(lNegativeTransition);
-				}
-			}
+	do {
+		lSequence = mSequence.load(std::memory_order_acquire);
+		if (lSequence & 1) {
+			continue;
 		}
-		break;
-	case FUNC_GET_SERVICE_REQUEST_ENABLE_REGISTER:
-		lLua.PushNumber(static_cast<float>(lPlatformStatus->GetServiceRequestEnableRegister()));
-		lRet = 1;
-		break;
-	case FUNC_SET_SERVICE_REQUEST_ENABLE_REGISTER:
-		if(lLua.IsInteger(1)) {
-			int lArgCount = lLua.GetTop();
-			if(lArgCount == 1) {
-				int lServiceRequestEnable = lLua.ToNumber(1);
-				if(lServiceRequestEnable < 0) {
-					// ERROR
-				}
-				else {
-					lPlatformStatus->SetServiceRequestEnableRegister(lServiceRequestEnable);
-				}
-			}
-		}
-		break;
-	default:
-		break;
-	}
 
-	return lRet;
+		lSnapshot.mEventRegister = mEventRegister.Get();
+		lSnapshot.mEventEnableRegister = mEventEnableRegister.Get();
+		lSnapshot.mServiceRequestEnableRegister = mServiceRequestEnableRegister.Get();
+		lSnapshot.mStatusByteRegister = mStatusByteRegister.Get();
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((lSequence & 1) || mSequence.load(std::memory_order_relaxed) != lSequence);
+
+	return lSnapshot;
+}
+
+/*
+ * Reads and clears the event register as one write, so an event set in
+ * between is neither lost nor reported twice (*ESR?)
+ */
+uint16_t StatusDataStructure::TakeEventRegister(void)
+{
+	BeginWrite();
+	uint16_t lValue = mEventRegister.Get();
+	mEventRegister.Clear();
+	EndWrite();
+
+	return lValue;
 }
 
+
 void StatusModelApi::SetConditionRegister(StatusDataStructure& lStatus, uint16_t lValue)
 {
 	lStatus.SetConditionRegister(lValue);
@@ -227,12 +182,44 @@ uint16_t StatusModelApi::GetEventEnableRegister(StatusDataStructure& lStatus)
 	return lStatus.GetEventEnableRegister();
 }
 
+uint16_t StatusModelApi::TakeEventRegister(StatusDataStructure& lStatus)
+{
+	return lStatus.TakeEventRegister();
+}
+
 uint16_t StatusModelApi::Summarize(StatusDataStructure& lStatus)
 {
 	StatusModelApi::UpdateEventRegister(lStatus);
 	return StatusModelApi::GetEventRegister(lStatus) & StatusModelApi::GetEventEnableRegister(lStatus);
 }
 
+/*
+ * Status byte as reported by a serial poll (IEEE 488.2 - 11.2). The ESB bit
+ * summarizes the enabled standard events and RQS is raised whenever any
+ * other enabled bit is set.
+ */
+uint8_t StatusModelApi::GetStatusByte(StatusDataStructure& lStatus)
+{
+	return GetStatusByte(lStatus.Snapshot());
+}
+
+uint8_t StatusModelApi::GetStatusByte(const StatusSnapshot& lSnapshot)
+{
+	uint8_t lStatusByte = lSnapshot.mStatusByteRegister & ~(1 << RQS_BIT);
+
+	if (lSnapshot.mEventRegister & lSnapshot.mEventEnableRegister)
+	{
+		lStatusByte |= (1 << ESB_BIT);
+	}
+
+	if (lStatusByte & lSnapshot.mServiceRequestEnableRegister & ~(1 << RQS_BIT))
+	{
+		lStatusByte |= (1 << RQS_BIT);
+	}
+
+	return lStatusByte;
+}
+
 #ifdef RUN_STATUS
 
 using namespace StatusModelApi;